@@ -0,0 +1,28 @@
+#include <Arduino.h>
+#include <inttypes.h>
+#include "BleKeyboard.h"
+#include "StreamPump.h"
+
+// Types everything received on Serial2 (GPIO 16 RX, 17 TX) on the connected
+// host, holding the sender back with XON/XOFF: enable software flow control
+// on the sending side. Progress is printed on Serial every second.
+
+BleKeyboard bleKeyboard("ESP32 Text Bridge", "ESP", 100);
+StreamPump pump(bleKeyboard, Serial2);
+
+void setup() {
+  Serial.begin(115200);
+  Serial2.begin(115200);
+  bleKeyboard.begin();
+  if (!pump.begin()) {
+    Serial.println("Could not start the pump");
+  }
+}
+
+void loop() {
+  static const char* const states[] = {"stopped", "running", "paused", "offline"};
+  PumpProgress progress = pump.getProgress();
+  Serial.printf("%s: %" PRIu32 " received, %" PRIu32 " typed, %" PRIu32 " buffered, %" PRIu32 " pauses\n",
+                states[(int)pump.getState()], progress.received, progress.typed, progress.buffered, progress.pauses);
+  delay(1000);
+}
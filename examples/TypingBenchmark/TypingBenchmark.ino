@@ -0,0 +1,145 @@
+#include <Arduino.h>
+#include <algorithm>
+#include <inttypes.h>
+#include "esp_timer.h"
+#include "BleKeyboard.h"
+
+// Types representative corpora and prints, for each typing mode and corpus,
+// the notifications sent, modifier transitions, total time and per-character
+// latency percentiles, broken down by keymap category.
+// Open an empty text editor on the host before connecting.
+// Build with BLE_KEYBOARD_COUNT_ALLOCATIONS defined to also print the heap
+// allocations made while typing, which should be 0 after the first corpus.
+// With a typing delay set, it also prints how far each hold strayed from it.
+
+#define MAX_SAMPLES 512
+
+static const char* const corpora[][2] = {
+  {"ascii",   "the quick brown fox jumps over the lazy dog, then naps in the sun; "
+              "pack my box with five dozen liquor jugs "},
+  {"french",  "Le cœur déçu mais l'âme plutôt naïve, Louÿs rêva de crapaüter en "
+              "canoë au delà des îles, près du mälström où brûlent les novæ. "},
+  {"code",    "if (a[i] > b[j]) { x |= y; } else { s = \"~/src\\\\main\"; }\n"
+              "for (k = 0; k < n; k++) { m[k] = (m[k] ^ 0x5F) | `x`; }\n"},
+  {"deadkey", "âêîôû ÂÊÎÔÛ äëïöü ÄËÏÖÜ ìò ÀÈÌÒÙ ãõñ ÃÕÑ "
+              "Août, forêt, château, côte, flûte, maïs, Noël, piñata "},
+};
+
+static const char* const categoryNames[] = {"direct", "shift", "altgr", "deadkey", "substituted", "unmapped"};
+static const size_t categoryCount = sizeof(categoryNames) / sizeof(categoryNames[0]);
+
+class BenchmarkKeyboard : public BleKeyboard
+{
+public:
+  BenchmarkKeyboard() : BleKeyboard("ESP32 Benchmark", "ESP", 100) {}
+
+  void reset() {
+    reports = 0;
+    modifierTransitions = 0;
+    samples = 0;
+    lastModifiers = 0;
+    lastCharacter = esp_timer_get_time();
+  }
+
+  uint32_t reports;
+  uint32_t modifierTransitions;
+  size_t samples;
+  uint32_t latency[MAX_SAMPLES];
+  uint8_t category[MAX_SAMPLES];
+
+protected:
+  // Every report, whether from print(), press() or the typing paths
+  void reportQueued(uint16_t connHandle, const KeyReport& report) override {
+    reports++;
+    if (report.modifiers != lastModifiers) {
+      modifierTransitions++;
+      lastModifiers = report.modifiers;
+    }
+  }
+
+  void characterTyped(uint32_t unicode_char) override {
+    int64_t now = esp_timer_get_time();
+    if (samples < MAX_SAMPLES) {
+      latency[samples] = now - lastCharacter;
+      category[samples] = static_cast<uint8_t>(classifyCharacter(unicode_char));
+      samples++;
+    }
+    lastCharacter = now;
+  }
+
+private:
+  uint8_t lastModifiers;
+  int64_t lastCharacter;
+};
+
+BenchmarkKeyboard bleKeyboard;
+
+static uint32_t percentile(uint32_t* values, size_t count, int pct) {
+  if (count == 0) {
+    return 0;
+  }
+  std::sort(values, values + count);
+  return values[(count - 1) * pct / 100];
+}
+
+static void runCorpus(const char* mode, const char* name, const char* text) {
+  static uint32_t selected[MAX_SAMPLES];
+
+  bleKeyboard.reset();
+  bleKeyboard.resetMetrics();
+  int64_t start = esp_timer_get_time();
+  bleKeyboard.print(text);
+  int64_t elapsed = esp_timer_get_time() - start;
+  size_t chars = bleKeyboard.samples;
+
+  Serial.printf("%-8s %-8s chars=%zu reports=%" PRIu32 " (%.2f/char) modifier transitions=%" PRIu32
+                " time=%" PRId64 " ms rate=%.1f chars/s\n",
+                mode, name, chars, bleKeyboard.reports, chars ? (float)bleKeyboard.reports / chars : 0.0f,
+                bleKeyboard.modifierTransitions, elapsed / 1000, elapsed ? chars * 1e6f / elapsed : 0.0f);
+#if defined(BLE_KEYBOARD_COUNT_ALLOCATIONS)
+  Serial.printf("    heap allocations=%" PRIu32 "\n", bleKeyboard.getMetrics().heapAllocations);
+#endif
+  KeyboardMetrics metrics = bleKeyboard.getMetrics();
+  if (metrics.holds > 0) {
+    Serial.printf("    hold jitter mean=%" PRIu32 " us max=%" PRIu32 " us over %" PRIu32 " holds\n",
+                  metrics.holdJitterMicros / metrics.holds, metrics.holdJitterMaxMicros, metrics.holds);
+  }
+
+  for (size_t c = 0; c < categoryCount; c++) {
+    size_t count = 0;
+    for (size_t i = 0; i < chars; i++) {
+      if (bleKeyboard.category[i] == c) {
+        selected[count++] = bleKeyboard.latency[i];
+      }
+    }
+    if (count > 0) {
+      Serial.printf("    %-12s n=%-4zu p50=%" PRIu32 " us p99=%" PRIu32 " us\n", categoryNames[c], count,
+                    percentile(selected, count, 50), percentile(selected, count, 99));
+    }
+  }
+}
+
+void setup() {
+  Serial.begin(115200);
+  bleKeyboard.begin();
+  Serial.println("Waiting for a client connection...");
+  while (!bleKeyboard.isConnected()) {
+    delay(100);
+  }
+  delay(5000); // Time to focus an editor on the host
+
+  const TypingMode modes[] = {TypingMode::Classic, TypingMode::Rollover};
+  const char* const modeNames[] = {"classic", "rollover"};
+  for (size_t m = 0; m < 2; m++) {
+    bleKeyboard.setTypingMode(modes[m]);
+    for (size_t i = 0; i < sizeof(corpora) / sizeof(corpora[0]); i++) {
+      runCorpus(modeNames[m], corpora[i][0], corpora[i][1]);
+      bleKeyboard.write('\n');
+    }
+  }
+  Serial.println("Benchmark done");
+}
+
+void loop() {
+  delay(1000);
+}
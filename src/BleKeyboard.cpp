@@ -2,8 +2,17 @@
 
 #include <NimBLEDevice.h>
 #include "HIDTypes.h"
+#include "layouts/FrAzerty.h"
 
 #include "sdkconfig.h"
+#include "esp_timer.h"
+#include <algorithm>
+#include <new>
+#if defined(CONFIG_NIMBLE_CPP_IDF)
+  #include "host/ble_hs.h"
+#else
+  #include "nimble/nimble/host/include/host/ble_hs.h"
+#endif
 
 #if defined(CONFIG_ARDUHAL_ESP_LOG)
   #include "esp32-hal-log.h"
@@ -13,303 +22,43 @@
   static const char* LOG_TAG = "NimBLEDevice";
 #endif
 
-// Standard HID Keyboard USAGE IDs
-#define KEY_A 0x14
-#define KEY_B 0x05
-#define KEY_C 0x06
-#define KEY_D 0x07
-#define KEY_E 0x08
-#define KEY_F 0x09
-#define KEY_G 0x0A
-#define KEY_H 0x0B
-#define KEY_I 0x0C
-#define KEY_J 0x0D
-#define KEY_K 0x0E
-#define KEY_L 0x0F
-#define KEY_M 0x33
-#define KEY_N 0x11
-#define KEY_O 0x12
-#define KEY_P 0x13
-#define KEY_Q 0x04
-#define KEY_R 0x15
-#define KEY_S 0x16
-#define KEY_T 0x17
-#define KEY_U 0x18
-#define KEY_V 0x19
-#define KEY_W 0x1d
-#define KEY_X 0x1b
-#define KEY_Y 0x1C
-#define KEY_Z 0x1a
-
-#define KEY_1 0x1e
-#define KEY_2 0x1F
-#define KEY_3 0x20
-#define KEY_4 0x21
-#define KEY_5 0x22
-#define KEY_6 0x23
-#define KEY_7 0x24
-#define KEY_8 0x25
-#define KEY_9 0x26
-#define KEY_0 0x27
-
-#define KEY_RETURN 0x28
-#define KEY_ESCAPE 0x29
-#define KEY_BACKSPACE 0x2A
-#define KEY_TAB 0x2B
-#define KEY_SPACE 0x2C
-#define KEY_DEGREE 0x2D
-#define KEY_EQUAL 0x2E
-#define KEY_SQUARE 0x35
-#define KEY_USD 0x30
-#define KEY_CIRCUMFLEX 0x2f
-#define KEY_ASTERISK 0x31
-#define KEY_PERCENT 0x34
-
-#define KEY_COMMA 0x10
-#define KEY_SEMICOLON 0x36
-#define KEY_COLON 0x37
-#define KEY_EXCLAMATION 0x38
-
-#define KEY_COMPARE 0x64
-
-typedef struct {
-    uint8_t modifiers1;
-    uint8_t key1;
-    uint8_t modifiers2;
-    uint8_t key2;
-} KeyPressSequence;
-
-typedef struct {
-    uint32_t unicode;
-    KeyPressSequence sequence;
-} KeymapEntry;
-
-#define LSHIFT (1 << (uint8_t)ModifierKey::LeftShift)
-#define ALT_GR  (1 << (uint8_t)ModifierKey::RightAlt)
-
-// FR Keymap
-static const KeymapEntry keymap[] = {
-    {U'a', {0, KEY_A, 0, 0}},
-    {U'b', {0, KEY_B, 0, 0}},
-    {U'c', {0, KEY_C, 0, 0}},
-    {U'd', {0, KEY_D, 0, 0}},
-    {U'e', {0, KEY_E, 0, 0}},
-    {U'f', {0, KEY_F, 0, 0}},
-    {U'g', {0, KEY_G, 0, 0}},
-    {U'h', {0, KEY_H, 0, 0}},
-    {U'i', {0, KEY_I, 0, 0}},
-    {U'j', {0, KEY_J, 0, 0}},
-    {U'k', {0, KEY_K, 0, 0}},
-    {U'l', {0, KEY_L, 0, 0}},
-    {U'm', {0, KEY_M, 0, 0}},
-    {U'n', {0, KEY_N, 0, 0}},
-    {U'o', {0, KEY_O, 0, 0}},
-    {U'p', {0, KEY_P, 0, 0}},
-    {U'q', {0, KEY_Q, 0, 0}},
-    {U'r', {0, KEY_R, 0, 0}},
-    {U's', {0, KEY_S, 0, 0}},
-    {U't', {0, KEY_T, 0, 0}},
-    {U'u', {0, KEY_U, 0, 0}},
-    {U'v', {0, KEY_V, 0, 0}},
-    {U'w', {0, KEY_W, 0, 0}},
-    {U'x', {0, KEY_X, 0, 0}},
-    {U'y', {0, KEY_Y, 0, 0}},
-    {U'z', {0, KEY_Z, 0, 0}},
-    {U'A', {LSHIFT, KEY_A, 0, 0}},
-    {U'B', {LSHIFT, KEY_B, 0, 0}},
-    {U'C', {LSHIFT, KEY_C, 0, 0}},
-    {U'D', {LSHIFT, KEY_D, 0, 0}},
-    {U'E', {LSHIFT, KEY_E, 0, 0}},
-    {U'F', {LSHIFT, KEY_F, 0, 0}},
-    {U'G', {LSHIFT, KEY_G, 0, 0}},
-    {U'H', {LSHIFT, KEY_H, 0, 0}},
-    {U'I', {LSHIFT, KEY_I, 0, 0}},
-    {U'J', {LSHIFT, KEY_J, 0, 0}},
-    {U'K', {LSHIFT, KEY_K, 0, 0}},
-    {U'L', {LSHIFT, KEY_L, 0, 0}},
-    {U'M', {LSHIFT, KEY_M, 0, 0}},
-    {U'N', {LSHIFT, KEY_N, 0, 0}},
-    {U'O', {LSHIFT, KEY_O, 0, 0}},
-    {U'P', {LSHIFT, KEY_P, 0, 0}},
-    {U'Q', {LSHIFT, KEY_Q, 0, 0}},
-    {U'R', {LSHIFT, KEY_R, 0, 0}},
-    {U'S', {LSHIFT, KEY_S, 0, 0}},
-    {U'T', {LSHIFT, KEY_T, 0, 0}},
-    {U'U', {LSHIFT, KEY_U, 0, 0}},
-    {U'V', {LSHIFT, KEY_V, 0, 0}},
-    {U'W', {LSHIFT, KEY_W, 0, 0}},
-    {U'X', {LSHIFT, KEY_X, 0, 0}},
-    {U'Y', {LSHIFT, KEY_Y, 0, 0}},
-    {U'Z', {LSHIFT, KEY_Z, 0, 0}},
-    {U'1', {LSHIFT, KEY_1, 0, 0}},
-    {U'2', {LSHIFT, KEY_2, 0, 0}},
-    {U'3', {LSHIFT, KEY_3, 0, 0}},
-    {U'4', {LSHIFT, KEY_4, 0, 0}},
-    {U'5', {LSHIFT, KEY_5, 0, 0}},
-    {U'6', {LSHIFT, KEY_6, 0, 0}},
-    {U'7', {LSHIFT, KEY_7, 0, 0}},
-    {U'8', {LSHIFT, KEY_8, 0, 0}},
-    {U'9', {LSHIFT, KEY_9, 0, 0}},
-    {U'0', {LSHIFT, KEY_0, 0, 0}},
-    {U' ', {0, KEY_SPACE, 0, 0}},
-    {U'!', {0, KEY_EXCLAMATION, 0, 0}},
-    {U'"', {0, KEY_3, 0, 0}},
-    {U'#', {ALT_GR, KEY_3, 0, 0}},
-    {U'$', {0, KEY_USD, 0, 0}},
-    {U'%', {LSHIFT, KEY_PERCENT, 0, 0}},
-    {U'&', {0, KEY_1, 0, 0}},
-    {U'\'', {0, KEY_4, 0, 0}},
-    {U'(', {0, KEY_5, 0, 0}},
-    {U')', {0, KEY_DEGREE, 0, 0}},
-    {U'*', {0, KEY_ASTERISK, 0, 0}},
-    {U'+', {LSHIFT, KEY_EQUAL, 0, 0}},
-    {U',', {0, KEY_COMMA, 0, 0}},
-    {U'-', {0, KEY_6, 0, 0}},
-    {U'.', {LSHIFT, KEY_SEMICOLON, 0, 0}},
-    {U'/', {LSHIFT, KEY_COLON, 0, 0}},
-    {U':', {0, KEY_COLON, 0, 0}},
-    {U';', {0, KEY_SEMICOLON, 0, 0}},
-    {U'<', {0, KEY_COMPARE, 0, 0}},
-    {U'=', {0, KEY_EQUAL, 0, 0}},
-    {U'>', {LSHIFT, KEY_COMPARE, 0, 0}},
-    {U'?', {LSHIFT, KEY_COMMA, 0, 0}},
-    {U'@', {ALT_GR, KEY_0, 0, 0}},
-    {U'[', {ALT_GR, KEY_5, 0, 0}},
-    {U'\\', {ALT_GR, KEY_8, 0, 0}},
-    {U']', {ALT_GR, KEY_DEGREE, 0, 0}},
-    {U'^', {ALT_GR, KEY_9, 0, 0}},
-    {U'_', {0, KEY_8, 0, 0}},
-    {U'`', {ALT_GR, KEY_7, 0, KEY_SPACE}},
-    {U'{', {ALT_GR, KEY_4, 0, 0}},
-    {U'|', {ALT_GR, KEY_6, 0, 0}},
-    {U'}', {ALT_GR, KEY_EQUAL, 0, 0}},
-    {U'~', {ALT_GR, KEY_2, 0, KEY_SPACE}},
-    {U'\n', {0, KEY_RETURN, 0, 0}},
-    {U'\t', {0, KEY_TAB, 0, 0}},
-    {U'é', {0, KEY_2, 0, 0}},
-    {U'€', {ALT_GR, KEY_E, 0, 0}},
-    {U'£', {LSHIFT, KEY_USD, 0, 0}},
-    {U'è', {0, KEY_7, 0, 0}},
-    {U'à', {0, KEY_0, 0, 0}},
-    {U'ù', {0, KEY_PERCENT, 0, 0}},
-    {U'ç', {0, KEY_9, 0, 0}},
-
-    // Accented characters (dead keys)
-    {U'â', {0, KEY_CIRCUMFLEX, 0, KEY_A}},
-    {U'ê', {0, KEY_CIRCUMFLEX, 0, KEY_E}},
-    {U'î', {0, KEY_CIRCUMFLEX, 0, KEY_I}},
-    {U'ô', {0, KEY_CIRCUMFLEX, 0, KEY_O}},
-    {U'û', {0, KEY_CIRCUMFLEX, 0, KEY_U}},
-    
-    {U'ä', {LSHIFT, KEY_CIRCUMFLEX, 0, KEY_A}},
-    {U'ë', {LSHIFT, KEY_CIRCUMFLEX, 0, KEY_E}},
-    {U'ï', {LSHIFT, KEY_CIRCUMFLEX, 0, KEY_I}},
-    {U'ö', {LSHIFT, KEY_CIRCUMFLEX, 0, KEY_O}},
-    {U'ü', {LSHIFT, KEY_CIRCUMFLEX, 0, KEY_U}},
-	
-	{U'à', {ALT_GR, KEY_7, 0, KEY_A}},
-    {U'è', {ALT_GR, KEY_7, 0, KEY_E}},
-    {U'ì', {ALT_GR, KEY_7, 0, KEY_I}},
-    {U'ò', {ALT_GR, KEY_7, 0, KEY_O}},
-    {U'ù', {ALT_GR, KEY_7, 0, KEY_U}},
-
-	{U'ã', {ALT_GR, KEY_2, 0, KEY_A}},
-    {U'õ', {ALT_GR, KEY_2, 0, KEY_O}},
-	{U'ñ', {ALT_GR, KEY_2, 0, KEY_N}},
-
-    {U'Â', {0, KEY_CIRCUMFLEX, LSHIFT, KEY_A}},
-    {U'Ê', {0, KEY_CIRCUMFLEX, LSHIFT, KEY_E}},
-    {U'Î', {0, KEY_CIRCUMFLEX, LSHIFT, KEY_I}},
-    {U'Ô', {0, KEY_CIRCUMFLEX, LSHIFT, KEY_O}},
-    {U'Û', {0, KEY_CIRCUMFLEX, LSHIFT, KEY_U}},
-
-    {U'Ä', {LSHIFT, KEY_CIRCUMFLEX, LSHIFT, KEY_A}},
-    {U'Ë', {LSHIFT, KEY_CIRCUMFLEX, LSHIFT, KEY_E}},
-    {U'Ï', {LSHIFT, KEY_CIRCUMFLEX, LSHIFT, KEY_I}},
-    {U'Ö', {LSHIFT, KEY_CIRCUMFLEX, LSHIFT, KEY_O}},
-    {U'Ü', {LSHIFT, KEY_CIRCUMFLEX, LSHIFT, KEY_U}},
-
-	{U'À', {ALT_GR, KEY_7, LSHIFT, KEY_A}},
-    {U'È', {ALT_GR, KEY_7, LSHIFT, KEY_E}},
-    {U'Ì', {ALT_GR, KEY_7, LSHIFT, KEY_I}},
-    {U'Ò', {ALT_GR, KEY_7, LSHIFT, KEY_O}},
-    {U'Ù', {ALT_GR, KEY_7, LSHIFT, KEY_U}},
-
-	{U'Ã', {ALT_GR, KEY_2, LSHIFT, KEY_A}},
-    {U'Õ', {ALT_GR, KEY_2, LSHIFT, KEY_O}},
-	{U'Ñ', {ALT_GR, KEY_2, LSHIFT, KEY_N}},
-    
-    // Other special characters
-    {U'¤', {ALT_GR, KEY_USD, 0, 0}},
-    {U'µ', {LSHIFT, KEY_ASTERISK, 0, 0}},
-    {U'²', {0, KEY_SQUARE, 0, 0}},
-    {U'§', {LSHIFT, KEY_EXCLAMATION, 0, 0}},
-    {U'°', {LSHIFT, KEY_DEGREE, 0, 0}},
-	
-	// Substitued characters
-	{U'“', {0, KEY_3, 0, 0}},
-	{U'”', {0, KEY_3, 0, 0}},
-	{U'«', {0, KEY_3, 0, 0}},
-	{U'»', {0, KEY_3, 0, 0}},
-	{U'¨', {0, KEY_3, 0, 0}},
-	
-	{U'’', {0, KEY_4, 0, 0}},
-    {U'‘', {0, KEY_4, 0, 0}},
-    {U'`', {0, KEY_4, 0, 0}},
-	{U'´', {0, KEY_4, 0, 0}},
-	
-	{U'‚', {0, KEY_COMMA, 0, 0}},
-	{U'¸', {0, KEY_COMMA, 0, 0}},
-	{U'„', {0, KEY_COMMA, 0, KEY_COMMA}}, 
-	
-	{U'›', {LSHIFT, KEY_COMPARE, 0, 0}},
-	{U'‹', {0, KEY_COMPARE, 0, 0}}, 
-	
-	{U'•', {0, KEY_ASTERISK, 0, 0}},
-	{U'–', {0, KEY_6, 0, 0}}, 
-	{U'—', {0, KEY_6, 0, 0}}, 
-	
-	{U'œ', {0, KEY_O, 0, KEY_E}}, 
-	{U'Œ', {LSHIFT, KEY_O, LSHIFT, KEY_E}}, 
-	{U'Æ', {LSHIFT, KEY_A, LSHIFT, KEY_E}},
-	{U'æ', {0, KEY_A, 0, KEY_E}},
-	
-	{U'×', {0, KEY_X, 0, 0}},
-	
-	{U'Á', {LSHIFT, KEY_A, 0, 0}},
-	{U'Å', {LSHIFT, KEY_A, 0, 0}},
-	{U'É', {LSHIFT, KEY_E, 0, 0}},
-	{U'Í', {LSHIFT, KEY_I, 0, 0}},
-	{U'Ð', {LSHIFT, KEY_D, 0, 0}},
-	{U'Ó', {LSHIFT, KEY_O, 0, 0}},
-	{U'Ø', {LSHIFT, KEY_0, 0, 0}},
-	{U'Þ', {LSHIFT, KEY_T, LSHIFT, KEY_H}},
-	{U'ß', {0, KEY_S, 0, KEY_S}},
-	{U'á', {0, KEY_A, 0, 0}},
-	{U'í', {0, KEY_I, 0, 0}},
-	{U'ð', {0, KEY_D, 0, 0}},
-	{U'ó', {0, KEY_O, 0, 0}},
-	{U'ø', {0, KEY_0, 0, 0}},
-	{U'ý', {0, KEY_Y, 0, 0}},
-	{U'ÿ', {0, KEY_Y, 0, 0}},
-	{U'þ', {0, KEY_T, 0, KEY_H}},
-	{U'Ý', {0, KEY_Y, 0, 0}},
-	{U'å', {0, KEY_A, 0, 0}},
-	{U'÷', {LSHIFT, KEY_COLON, 0, 0}},
-	{U'³', {0, KEY_CIRCUMFLEX, 0, KEY_3}},
-	{U'ª', {0, KEY_CIRCUMFLEX, 0, KEY_A}},
-	{U'¦', {ALT_GR, KEY_6, 0, 0}},
-	{U'¥', {LSHIFT, KEY_Y, 0, 0}},
-	{U'¢', {0, KEY_C, 0, KEY_T}},
-	{U'¡', {0, KEY_EXCLAMATION, 0, 0}},
-	{U'Ÿ', {LSHIFT, KEY_Y, 0, 0}},
-	{U'ž', {0, KEY_Z, 0, 0}},
-	{U'š', {0, KEY_S, 0, 0}},
-	{U'™', {LSHIFT, KEY_T, LSHIFT, KEY_M}},
-	{0x00A0, {0, KEY_SPACE, 0, 0}}, // NBSP U+00A0 160
-};
-static const size_t keymapSize = sizeof(keymap) / sizeof(KeymapEntry);
+#if defined(BLE_KEYBOARD_COUNT_ALLOCATIONS)
+static std::atomic<uint32_t> heapAllocations{0};
+
+#if defined(CONFIG_HEAP_USE_HOOKS)
+extern "C" void esp_heap_trace_alloc_hook(void* ptr, size_t size, uint32_t caps)
+{
+  heapAllocations++;
+}
+#else
+// The default operator delete frees with free(), so only allocation is replaced
+void* operator new(size_t size)
+{
+  heapAllocations++;
+  void* p = malloc(size != 0 ? size : 1);
+  if (p == nullptr) {
+    abort();
+  }
+  return p;
+}
+
+void* operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+  heapAllocations++;
+  return malloc(size != 0 ? size : 1);
+}
 
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept
+{
+  return operator new(size, tag);
+}
+#endif
+#endif
 
 // Report IDs:
 #define KEYBOARD_ID 0x01
@@ -351,8 +100,95 @@ static const uint8_t _hidReportDescriptor[] = {
   END_COLLECTION(0),                 // END_COLLECTION
 };
 
-BleKeyboard::BleKeyboard(std::string deviceName, std::string deviceManufacturer, uint8_t batteryLevel) : hid(0)
+// Same layout with the 6-key array replaced by a bitmap of key usages
+static const uint8_t _nkroReportDescriptor[] = {
+  USAGE_PAGE(1),      0x01,          // USAGE_PAGE (Generic Desktop Ctrls)
+  USAGE(1),           0x06,          // USAGE (Keyboard)
+  COLLECTION(1),      0x01,          // COLLECTION (Application)
+  // ------------------------------------------------- Keyboard
+  REPORT_ID(1),       KEYBOARD_ID,   //   REPORT_ID (1)
+  USAGE_PAGE(1),      0x07,          //   USAGE_PAGE (Kbrd/Keypad)
+  USAGE_MINIMUM(1),   0xE0,          //   USAGE_MINIMUM (0xE0)
+  USAGE_MAXIMUM(1),   0xE7,          //   USAGE_MAXIMUM (0xE7)
+  LOGICAL_MINIMUM(1), 0x00,          //   LOGICAL_MINIMUM (0)
+  LOGICAL_MAXIMUM(1), 0x01,          //   Logical Maximum (1)
+  REPORT_SIZE(1),     0x01,          //   REPORT_SIZE (1)
+  REPORT_COUNT(1),    0x08,          //   REPORT_COUNT (8)
+  HIDINPUT(1),        0x02,          //   INPUT (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
+  REPORT_COUNT(1),    0x05,          //   REPORT_COUNT (5) ; 5 bits (Num lock, Caps lock, Scroll lock, Compose, Kana)
+  REPORT_SIZE(1),     0x01,          //   REPORT_SIZE (1)
+  USAGE_PAGE(1),      0x08,          //   USAGE_PAGE (LEDs)
+  USAGE_MINIMUM(1),   0x01,          //   USAGE_MINIMUM (0x01) ; Num Lock
+  USAGE_MAXIMUM(1),   0x05,          //   USAGE_MAXIMUM (0x05) ; Kana
+  HIDOUTPUT(1),       0x02,          //   OUTPUT (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+  REPORT_COUNT(1),    0x01,          //   REPORT_COUNT (1) ; 3 bits (Padding)
+  REPORT_SIZE(1),     0x03,          //   REPORT_SIZE (3)
+  HIDOUTPUT(1),       0x01,          //   OUTPUT (Const,Array,Abs,No Wrap,Linear,Preferred State,No Null Position,Non-volatile)
+  REPORT_COUNT(1),    NKRO_KEY_COUNT, //  REPORT_COUNT (128) ; 1 bit per key
+  REPORT_SIZE(1),     0x01,          //   REPORT_SIZE (1)
+  LOGICAL_MINIMUM(1), 0x00,          //   LOGICAL_MINIMUM (0)
+  LOGICAL_MAXIMUM(1), 0x01,          //   LOGICAL_MAXIMUM (1)
+  USAGE_PAGE(1),      0x07,          //   USAGE_PAGE (Kbrd/Keypad)
+  USAGE_MINIMUM(1),   0x00,          //   USAGE_MINIMUM (0)
+  USAGE_MAXIMUM(1),   NKRO_KEY_COUNT - 1, // USAGE_MAXIMUM (0x7F)
+  HIDINPUT(1),        0x02,          //   INPUT (Data,Var,Abs,No Wrap,Linear,Preferred State,No Null Position)
+  END_COLLECTION(0),                 // END_COLLECTION
+};
+
+bool SerialExecutor::isRunning(void) const
+{
+  return _executor == xTaskGetCurrentTaskHandle();
+}
+
+size_t SerialExecutor::execute(Call& call)
+{
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  if (_executor == self) {
+    return call.run(call.context); // Nested in the call being executed
+  }
+  call.ran = xSemaphoreCreateBinaryStatic(&call.ranBuffer);
+  _queue.push(&call);
+  for (;;) {
+    bool idle = false;
+    if (_busy.compare_exchange_strong(idle, true, std::memory_order_acquire)) {
+      _executor = self;
+      // Run the calls queued before ours, then ours. Later ones are left to
+      // their own callers, so no caller does much more than its own work.
+      while (!call.done.load(std::memory_order_relaxed)) {
+        Call* next = static_cast<Call*>(_queue.pop());
+        if (next == nullptr) {
+          break; // A push is halfway done, its task was interrupted between two stores
+        }
+        SemaphoreHandle_t ran = next->ran; // next may be gone once done is set
+        next->result = next->run(next->context);
+        next->done.store(true, std::memory_order_release);
+        if (next != &call) {
+          xSemaphoreGive(ran);
+        }
+      }
+      _executor = nullptr;
+      _busy.store(false, std::memory_order_release);
+      if (call.done.load(std::memory_order_acquire)) {
+        break;
+      }
+    }
+    // Block rather than retry at once, so that a task of lower priority
+    // halfway through its push, or running calls, gets the CPU. The
+    // semaphore is only given once our call has run; the timeout covers a
+    // turn nobody hands over.
+    if (xSemaphoreTake(call.ran, 1) == pdTRUE) {
+      break;
+    }
+  }
+  vSemaphoreDelete(call.ran);
+  return call.result;
+}
+
+BleKeyboard* BleKeyboard::_gapInstance = nullptr;
+
+BleKeyboard::BleKeyboard(std::string deviceName, std::string deviceManufacturer, uint8_t batteryLevel) : hid(0), _layout(&LayoutFrAzerty)
 {
+  updateCapsLockKeys();
   this->deviceName = deviceName;
   this->deviceManufacturer = deviceManufacturer;
   this->batteryLevel = batteryLevel;
@@ -360,27 +196,69 @@ BleKeyboard::BleKeyboard(std::string deviceName, std::string deviceManufacturer,
 
 void BleKeyboard::begin(void)
 {
+  _reportLock = xSemaphoreCreateMutex();
+  _reportSent = xSemaphoreCreateBinary();
+  _ledChanged = xSemaphoreCreateBinary();
+  _linkLock = xSemaphoreCreateMutex();
+  esp_timer_create_args_t linkTimerArgs = {};
+  linkTimerArgs.callback = linkIdleTimer;
+  linkTimerArgs.arg = this;
+  linkTimerArgs.name = "bleKeyboardLink";
+  esp_timer_create(&linkTimerArgs, &_linkTimer);
+  _edgeReached = xSemaphoreCreateBinary();
+  esp_timer_create_args_t edgeTimerArgs = {};
+  edgeTimerArgs.callback = edgeTimer;
+  edgeTimerArgs.arg = this;
+  edgeTimerArgs.name = "bleKeyboardEdge";
+  esp_timer_create(&edgeTimerArgs, &_edgeTimer);
+  esp_timer_create_args_t pumpTimerArgs = {};
+  pumpTimerArgs.callback = pumpTimer;
+  pumpTimerArgs.arg = this;
+  pumpTimerArgs.name = "bleKeyboardPump";
+  esp_timer_create(&pumpTimerArgs, &_pumpTimer);
+
   NimBLEDevice::init(deviceName);
   BLEDevice::setSecurityAuth(true, true, false);
 
   NimBLEServer *pServer = NimBLEDevice::createServer();
   pServer->setCallbacks(this);
+  pServer->advertiseOnDisconnect(false); // See startAdvertising()
 
   hid        = new NimBLEHIDDevice(pServer);
   inputKeyboard = hid->getInputReport(KEYBOARD_ID); // <-- input REPORTID from report map
   outputKeyboard = hid->getOutputReport(KEYBOARD_ID);
   outputKeyboard->setCallbacks(this);
+  inputKeyboard->setCallbacks(this); // onStatus() wakes writers waiting for queue room
+  // Size the input report value once, so sendKeyState() updates it in place
+  static const NkroReport noKeys = {};
+  inputKeyboard->setValue((const uint8_t*)&noKeys, _reportMode == ReportMode::Nkro ? sizeof(NkroReport) : sizeof(KeyReport));
   
   hid->setManufacturer(deviceManufacturer);
   hid->setPnp(0x02, 0xe502, 0xa111, 0x0210);
   hid->setHidInfo(0x08, 0x01); // hid->setHidInfo(0x00, 0x01); 0x08 for FR, not sure it has any impact
-  hid->setReportMap((uint8_t*)_hidReportDescriptor, sizeof(_hidReportDescriptor));
+  if (_reportMode == ReportMode::Nkro) {
+    hid->setReportMap((uint8_t*)_nkroReportDescriptor, sizeof(_nkroReportDescriptor));
+  } else {
+    hid->setReportMap((uint8_t*)_hidReportDescriptor, sizeof(_hidReportDescriptor));
+  }
   hid->startServices();
 
+  if (_metricsEnabled) {
+    NimBLEService* metricsService = pServer->createService(BLE_KEYBOARD_METRICS_SERVICE_UUID);
+    _metricsCharacteristic = metricsService->createCharacteristic(BLE_KEYBOARD_METRICS_CHAR_UUID, NIMBLE_PROPERTY::READ,
+                                                                  sizeof(KeyboardMetrics));
+    _metricsCharacteristic->setCallbacks(this);
+    metricsService->start();
+  }
+
   NimBLEAdvertising *pAdvertising = pServer->getAdvertising();
   pAdvertising->setAppearance(HID_KEYBOARD);
   pAdvertising->addServiceUUID(hid->getHidService()->getUUID());
-  pAdvertising->start();
+  _gapInstance = this;
+  NimBLEDevice::setCustomGapHandler(gapEvent); // Advertising timeouts, see advertisingComplete()
+  _offlineSince = esp_timer_get_time();
+  _awaitingFirstReport = true;
+  startAdvertising();
   hid->setBatteryLevel(batteryLevel);
 }
 
@@ -389,7 +267,89 @@ void BleKeyboard::end(void)
 }
 
 bool BleKeyboard::isConnected(void) const {
-  return connected;
+  for (const Host& host : _hosts) {
+    if (host.connHandle != BLE_HS_CONN_HANDLE_NONE) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool BleKeyboard::isSubscribed(void) const {
+  for (const Host& host : _hosts) {
+    if (host.connHandle != BLE_HS_CONN_HANDLE_NONE && host.subscribed) {
+      return true;
+    }
+  }
+  return false;
+}
+
+BleKeyboard::Host* BleKeyboard::findHost(uint16_t connHandle) {
+  for (Host& host : _hosts) {
+    if (host.connHandle == connHandle) {
+      return &host;
+    }
+  }
+  return nullptr;
+}
+
+const BleKeyboard::Host* BleKeyboard::findHost(uint16_t connHandle) const {
+  return const_cast<BleKeyboard*>(this)->findHost(connHandle);
+}
+
+const BleKeyboard::Host* BleKeyboard::firstTarget(void) const {
+  uint32_t targets = _targets;
+  for (size_t i = 0; i < BLE_KEYBOARD_MAX_HOSTS; i++) {
+    if ((targets >> i) & 1) {
+      return &_hosts[i];
+    }
+  }
+  return nullptr;
+}
+
+size_t BleKeyboard::getHosts(uint16_t* connHandles, size_t max) const {
+  size_t count = 0;
+  for (const Host& host : _hosts) {
+    if (host.connHandle != BLE_HS_CONN_HANDLE_NONE) {
+      if (count < max) {
+        connHandles[count] = host.connHandle;
+      }
+      count++;
+    }
+  }
+  return count;
+}
+
+// Reports go to the targeted hosts only. Keys held on a host stay held when it
+// stops being a target; call releaseAll() before switching to release them.
+bool BleKeyboard::targetHost(uint16_t connHandle) {
+  return targetHosts(&connHandle, 1) == 1;
+}
+
+size_t BleKeyboard::targetHosts(const uint16_t* connHandles, size_t count) {
+  uint32_t targets = 0;
+  size_t found = 0;
+  for (size_t i = 0; i < count; i++) {
+    Host* host = connHandles[i] != BLE_HS_CONN_HANDLE_NONE ? findHost(connHandles[i]) : nullptr;
+    if (host != nullptr) {
+      targets |= 1u << (host - _hosts);
+      found++;
+    }
+  }
+  _targetAll = false;
+  _targets = targets;
+  return found;
+}
+
+void BleKeyboard::targetAllHosts(void) {
+  uint32_t targets = 0;
+  for (size_t i = 0; i < BLE_KEYBOARD_MAX_HOSTS; i++) {
+    if (_hosts[i].connHandle != BLE_HS_CONN_HANDLE_NONE) {
+      targets |= 1u << i;
+    }
+  }
+  _targetAll = true;
+  _targets = targets;
 }
 
 void BleKeyboard::setBatteryLevel(uint8_t level) {
@@ -398,25 +358,627 @@ void BleKeyboard::setBatteryLevel(uint8_t level) {
     this->hid->setBatteryLevel(this->batteryLevel);
 }
 
+// Sets the key state of every targeted host
 void BleKeyboard::sendReport(KeyReport* keys)
 {
-  if (this->isConnected())
-  {
-    this->inputKeyboard->setValue((uint8_t*)keys, sizeof(KeyReport));
-    this->inputKeyboard->notify();
+  forEachTarget([keys](Host& host) { host.keyReport = *keys; });
+  if (_reportMode == ReportMode::Nkro) {
+    memset(&_nkroReport, 0, sizeof(_nkroReport));
+    _nkroReport.modifiers = keys->modifiers;
+    for (int i = 0; i < 6; i++) {
+      if (keys->keys[i] != 0 && keys->keys[i] < NKRO_KEY_COUNT) {
+        _nkroReport.keys[keys->keys[i] / 8] |= 1 << (keys->keys[i] % 8);
+      }
+    }
+    sendReport(&_nkroReport);
+    return;
+  }
+  sendKeyState();
+}
+
+void BleKeyboard::sendReport(NkroReport* keys)
+{
+  forEachTarget([keys](Host& host) {
+    host.nkroReport = *keys;
+    host.keyReport.modifiers = keys->modifiers;
+  });
+  sendKeyState();
+}
+
+// Queues the key state of every targeted host. Reports go through a queue per
+// host that is drained with as many notifications as the stack will take, so
+// several reports can leave in the same connection event, for all hosts at
+// once. Sending stops while the mbuf pool runs low and resumes once the
+// controller has freed some. The caller waits for the hosts whose queue is
+// full, all together and for at most BLE_KEYBOARD_HOST_STALL_MS: those still
+// full then are marked lagging and lose their oldest reports until they have
+// caught up, so slow hosts do not hold up the others for longer than that.
+void BleKeyboard::sendKeyState(void)
+{
+  if (_reportLock == nullptr) {
+    return; // Before begin()
+  }
+  noteActivity();
+  auto enqueue = [this](Host& host) {
+    if (_reportMode == ReportMode::Nkro) {
+      // The bitmap holds every key, including those that did not fit in keyReport
+      host.nkroReport.modifiers = host.keyReport.modifiers;
+      return enqueueReport(host, (const uint8_t*)&host.nkroReport, sizeof(NkroReport));
+    }
+    return enqueueReport(host, (const uint8_t*)&host.keyReport, sizeof(KeyReport));
+  };
+  uint32_t full = 0; // Bit i set: _hosts[i] had no room
+  forEachTarget([&](Host& host) {
+    reportQueued(host.connHandle, host.keyReport);
+    if (!enqueue(host)) {
+      full |= 1u << (&host - _hosts);
+    }
+  });
+  // The characteristic has one value, read by any host: the first target's
+  // keys, with the bitmap's modifiers brought up to date by enqueue
+  const Host* primary = _targets == 0 && _targetAll ? &_offline : firstTarget();
+  if (primary != nullptr) {
+    if (_reportMode == ReportMode::Nkro) {
+      this->inputKeyboard->setValue((const uint8_t*)&primary->nkroReport, sizeof(NkroReport));
+    } else {
+      this->inputKeyboard->setValue((const uint8_t*)&primary->keyReport, sizeof(KeyReport));
+    }
+  }
+
+  int64_t blockedSince = 0;
+  while (full != 0) {
+    int64_t now = esp_timer_get_time();
+    if (blockedSince != 0 && now - blockedSince > BLE_KEYBOARD_HOST_STALL_MS * 1000LL) {
+      for (size_t i = 0; i < BLE_KEYBOARD_MAX_HOSTS; i++) {
+        Host& host = _hosts[i];
+        if (((full >> i) & 1) == 0 || host.connHandle == BLE_HS_CONN_HANDLE_NONE) {
+          continue;
+        }
+        xSemaphoreTake(_reportLock, portMAX_DELAY);
+        bool wasLagging = host.lagging;
+        host.lagging = true;
+        xSemaphoreGive(_reportLock);
+        if (!wasLagging) {
+          ESP_LOGW(LOG_TAG, "host %d is lagging, dropping its oldest reports", host.connHandle);
+        }
+        enqueue(host); // Makes room by dropping the oldest report
+      }
+      break;
+    }
+    if (blockedSince == 0) {
+      blockedSince = now;
+    }
+    pumpReports();
+    xSemaphoreTake(_reportSent, pdMS_TO_TICKS(getReportInterval() / 1000 + 1));
+    for (size_t i = 0; i < BLE_KEYBOARD_MAX_HOSTS; i++) {
+      if (((full >> i) & 1) == 0) {
+        continue;
+      }
+      if (_hosts[i].connHandle == BLE_HS_CONN_HANDLE_NONE) {
+        full &= ~(1u << i); // Disconnected meanwhile
+      } else if (enqueue(_hosts[i])) {
+        full &= ~(1u << i);
+      }
+    }
+  }
+  if (blockedSince != 0) {
+    _metrics.blockedMicros += esp_timer_get_time() - blockedSince;
+  }
+  pumpReports();
+}
+
+bool BleKeyboard::enqueueReport(Host& host, const uint8_t* data, size_t length)
+{
+  xSemaphoreTake(_reportLock, portMAX_DELAY);
+  if (&host == &_offline || (&host == _replayHost && _backlogCount > 0)) {
+    if (&host != &_offline && _backlogCount == BLE_KEYBOARD_BACKLOG_SIZE && !host.lagging) {
+      // The host is connected: wait for the replay to make room, as for its own queue
+      xSemaphoreGive(_reportLock);
+      return false;
+    }
+    traceReport(TraceEvent::Queued, host.connHandle, data, length);
+    backlogReport(data, length);
+    xSemaphoreGive(_reportLock);
+    return true;
+  }
+  if (host.lagging && host.queueCount == BLE_KEYBOARD_REPORT_QUEUE_SIZE) {
+    // Every report is a full key state, so dropping the oldest leaves no key held
+    const QueuedReport& oldest = host.queue[host.queueHead];
+    traceReport(TraceEvent::Dropped, host.connHandle, oldest.data, oldest.length);
+    host.queueHead = (host.queueHead + 1) % BLE_KEYBOARD_REPORT_QUEUE_SIZE;
+    host.queueCount--;
+    _metrics.reportsDropped++;
+  }
+  bool queued = host.queueCount < BLE_KEYBOARD_REPORT_QUEUE_SIZE;
+  if (queued) {
+    traceReport(TraceEvent::Queued, host.connHandle, data, length);
+    QueuedReport& report = host.queue[(host.queueHead + host.queueCount) % BLE_KEYBOARD_REPORT_QUEUE_SIZE];
+    memcpy(report.data, data, length);
+    report.length = length;
+    host.queueCount++;
+    if (host.queueCount > _metrics.queueHighWater) {
+      _metrics.queueHighWater = host.queueCount;
+    }
   }
+  xSemaphoreGive(_reportLock);
+  return queued;
+}
+
+// Called with _reportLock held. The backlog is bounded: once full, its oldest
+// reports are dropped, which leaves no key held since every report is a full
+// key state.
+void BleKeyboard::backlogReport(const uint8_t* data, size_t length)
+{
+  if (_backlogCount == BLE_KEYBOARD_BACKLOG_SIZE) {
+    const QueuedReport& oldest = _backlog[_backlogHead];
+    traceReport(TraceEvent::Dropped, BLE_HS_CONN_HANDLE_NONE, oldest.data, oldest.length);
+    _backlogHead = (_backlogHead + 1) % BLE_KEYBOARD_BACKLOG_SIZE;
+    _backlogCount--;
+    _metrics.reportsDropped++;
+  }
+  QueuedReport& report = _backlog[(_backlogHead + _backlogCount) % BLE_KEYBOARD_BACKLOG_SIZE];
+  memcpy(report.data, data, length);
+  report.length = length;
+  _backlogCount++;
+}
+
+// Offline text is meant for the host that left: the last host if it was
+// bonded, or any bonded host when none has left since start-up. Anyone else
+// connecting, such as a stranger pairing meanwhile, never sees it.
+bool BleKeyboard::isBacklogOwner(const NimBLEAddress& address) const
+{
+  if (_lastHost.isNull()) {
+    return NimBLEDevice::isBonded(address);
+  }
+  return _lastHostBonded && address == _lastHost;
+}
+
+// Called with _reportLock held
+void BleKeyboard::dropBacklog(void)
+{
+  for (; _backlogCount > 0; _backlogCount--) {
+    const QueuedReport& report = _backlog[_backlogHead];
+    traceReport(TraceEvent::Dropped, BLE_HS_CONN_HANDLE_NONE, report.data, report.length);
+    _backlogHead = (_backlogHead + 1) % BLE_KEYBOARD_BACKLOG_SIZE;
+    _metrics.reportsDropped++;
+  }
+  memset(&_offline.keyReport, 0, sizeof(_offline.keyReport));
+  memset(&_offline.nkroReport, 0, sizeof(_offline.nkroReport));
+}
+
+// Takes one report from each host in turn, so a host with a long backlog does
+// not delay the others' reports. Hosts that have not enabled notifications yet
+// keep their reports. One pass runs at a time; a call made meanwhile by
+// another task has the running pass go round again instead.
+void BleKeyboard::pumpReports(void)
+{
+  _pumpAgain = true; // Before trying, so a pass ending meanwhile sees it
+  while (_pumpAgain && !_pumping.exchange(true)) {
+    _pumpAgain = false;
+    pumpPass();
+    _pumping = false;
+  }
+}
+
+// Reports are taken off the queues under _reportLock, but handed to NimBLE
+// without it: the stack emits NOTIFY_TX, and so calls onStatus(), before
+// ble_gatts_notify_custom() returns. The mbufs come from NimBLE's own pool, so
+// sending never touches the heap. Sending pauses while the pool runs low; as
+// nothing tells when the controller frees them, _pumpTimer tries again a
+// connection interval later.
+void BleKeyboard::pumpPass(void)
+{
+  uint32_t refused = 0; // Hosts whose notification failed in this pass
+  bool sent = true;
+  bool starved = false;
+  while (sent && !starved) {
+    sent = false;
+    for (size_t i = 0; i < BLE_KEYBOARD_MAX_HOSTS && !starved; i++) {
+      Host& host = _hosts[i];
+      QueuedReport report;
+      uint16_t connHandle;
+      struct os_mbuf* om = nullptr;
+      xSemaphoreTake(_reportLock, portMAX_DELAY);
+      connHandle = host.connHandle;
+      if (connHandle == BLE_HS_CONN_HANDLE_NONE || !host.subscribed || ((refused >> i) & 1)) {
+        xSemaphoreGive(_reportLock);
+        continue;
+      }
+      if (&host == _replayHost) {
+        // Move the backlog over as room frees up in the host's queue
+        while (_backlogCount > 0 && host.queueCount < BLE_KEYBOARD_REPORT_QUEUE_SIZE) {
+          host.queue[(host.queueHead + host.queueCount) % BLE_KEYBOARD_REPORT_QUEUE_SIZE] = _backlog[_backlogHead];
+          host.queueCount++;
+          _backlogHead = (_backlogHead + 1) % BLE_KEYBOARD_BACKLOG_SIZE;
+          _backlogCount--;
+          _metrics.reportsReplayed++;
+        }
+        if (_backlogCount == 0) {
+          _replayHost = nullptr;
+        }
+      }
+      if (host.queueCount > 0) {
+        report = host.queue[host.queueHead];
+        if (os_msys_num_free() >= BLE_KEYBOARD_MIN_FREE_MBUFS) {
+          om = ble_hs_mbuf_from_flat(report.data, report.length);
+        }
+        if (om == nullptr) {
+          traceReport(TraceEvent::Refused, connHandle, report.data, report.length);
+          _metrics.reportsFailed++;
+          starved = true;
+        } else {
+          traceReport(TraceEvent::Sent, connHandle, report.data, report.length);
+          _metrics.reportsSent++;
+          if (_awaitingFirstReport) {
+            _metrics.firstReportMicros = esp_timer_get_time() - _offlineSince;
+            _awaitingFirstReport = false;
+          }
+          host.queueHead = (host.queueHead + 1) % BLE_KEYBOARD_REPORT_QUEUE_SIZE;
+          if (--host.queueCount == 0) {
+            host.lagging = false;
+          }
+        }
+      }
+      xSemaphoreGive(_reportLock);
+      if (om == nullptr) {
+        continue;
+      }
+      if (ble_gatts_notify_custom(connHandle, this->inputKeyboard->getHandle(), om) == 0) {
+        sent = true;
+        continue;
+      }
+      // NimBLE freed the mbuf and onStatus() counted the failure. The report
+      // goes back to the front of its queue, unless the host is gone.
+      refused |= 1u << i;
+      xSemaphoreTake(_reportLock, portMAX_DELAY);
+      if (host.connHandle == connHandle && host.queueCount < BLE_KEYBOARD_REPORT_QUEUE_SIZE) {
+        host.queueHead = (host.queueHead + BLE_KEYBOARD_REPORT_QUEUE_SIZE - 1) % BLE_KEYBOARD_REPORT_QUEUE_SIZE;
+        host.queue[host.queueHead] = report;
+        host.queueCount++;
+      } else {
+        traceReport(TraceEvent::Dropped, connHandle, report.data, report.length);
+        _metrics.reportsDropped++;
+      }
+      xSemaphoreGive(_reportLock);
+    }
+  }
+  if (starved || refused != 0) {
+    esp_timer_start_once(_pumpTimer, getReportInterval()); // Fails harmlessly while armed
+  }
+}
+
+void BleKeyboard::pumpTimer(void* arg) {
+  static_cast<BleKeyboard*>(arg)->pumpReports();
+}
+
+// Called from within ble_gatts_notify_custom(), on the task pumping reports:
+// the report was handed to the controller, or failed.
+void BleKeyboard::onStatus(NimBLECharacteristic* pCharacteristic, int code) {
+  if (pCharacteristic != this->inputKeyboard) {
+    return;
+  }
+  if (code != 0) {
+    xSemaphoreTake(_reportLock, portMAX_DELAY);
+    _metrics.reportsFailed++;
+    xSemaphoreGive(_reportLock);
+  }
+  xSemaphoreGive(_reportSent);
+}
+
+// Reports flow once the host has enabled notifications on the input report,
+// which a bonded host's stored subscription does as soon as the link is
+// encrypted again.
+void BleKeyboard::onSubscribe(NimBLECharacteristic* pCharacteristic, NimBLEConnInfo& connInfo, uint16_t subValue) {
+  Host* host = findHost(connInfo.getConnHandle());
+  if (pCharacteristic != this->inputKeyboard || host == nullptr) {
+    return;
+  }
+  host->subscribed = (subValue & 1) != 0;
+  pumpReports();
+  xSemaphoreGive(_reportSent);
+}
+
+void BleKeyboard::clearReportQueue(Host& host)
+{
+  xSemaphoreTake(_reportLock, portMAX_DELAY);
+  _metrics.reportsDropped += host.queueCount;
+  for (size_t i = 0; i < host.queueCount; i++) {
+    const QueuedReport& report = host.queue[(host.queueHead + i) % BLE_KEYBOARD_REPORT_QUEUE_SIZE];
+    traceReport(TraceEvent::Dropped, host.connHandle, report.data, report.length);
+  }
+  host.queueHead = 0;
+  host.queueCount = 0;
+  host.lagging = false;
+  if (_replayHost == &host) {
+    _replayHost = nullptr; // The rest of the backlog goes to the next host
+  }
+  xSemaphoreGive(_reportLock);
+  xSemaphoreGive(_reportSent);
+}
+
+// Longest connection interval among the targeted hosts, in microseconds (the
+// BLE unit is 1.25 ms)
+uint32_t BleKeyboard::getReportInterval(void) const {
+  uint16_t interval = 0;
+  uint32_t targets = _targets;
+  for (size_t i = 0; i < BLE_KEYBOARD_MAX_HOSTS; i++) {
+    if (((targets >> i) & 1) && _hosts[i].connInterval > interval) {
+      interval = _hosts[i].connInterval;
+    }
+  }
+  return (interval != 0 ? interval : BLE_KEYBOARD_DEFAULT_CONN_INTERVAL) * 1250;
+}
+
+void BleKeyboard::updateConnectionParams(NimBLEConnInfo& connInfo) {
+    Host* host = findHost(connInfo.getConnHandle());
+    if (host == nullptr) {
+        return;
+    }
+    host->connInterval = connInfo.getConnInterval();
+    host->connLatency = connInfo.getConnLatency();
+    ESP_LOGI(LOG_TAG, "host %d: connection interval: %d x 1.25 ms, latency: %d",
+             host->connHandle, host->connInterval, host->connLatency);
+}
+
+void BleKeyboard::setConnectionPolicy(const ConnectionPolicy& policy) {
+    if (_linkLock == nullptr) {
+        _connectionPolicy = policy; // Before begin()
+        return;
+    }
+    xSemaphoreTake(_linkLock, portMAX_DELAY);
+    _connectionPolicy = policy;
+    esp_timer_stop(_linkTimer); // Armed for the previous idle time
+    if (policy.idleMs != 0) {
+        _lastActivity = esp_timer_get_time();
+        applyLinkProfile(_linkProfile, true);
+    }
+    xSemaphoreGive(_linkLock);
+}
+
+ConnectionPolicy BleKeyboard::getConnectionPolicy(void) const {
+    return _connectionPolicy;
+}
+
+LinkProfile BleKeyboard::getLinkProfile(void) const {
+    return _linkProfile;
+}
+
+// Connection parameters follow the typing: the active profile is requested
+// from every host as soon as there is something to type, and the idle one once
+// nothing has been typed or queued for the policy's idle time. With peripheral
+// latency the radio sleeps through most idle connection events, and the first
+// report after a pause waits at most one idle interval.
+void BleKeyboard::noteActivity(void) {
+    if (_linkTimer == nullptr || _connectionPolicy.idleMs == 0) {
+        return;
+    }
+    _lastActivity = esp_timer_get_time();
+    if (_linkProfile != LinkProfile::Active) {
+        xSemaphoreTake(_linkLock, portMAX_DELAY);
+        applyLinkProfile(LinkProfile::Active, false);
+        xSemaphoreGive(_linkLock);
+    }
+}
+
+// Called with _linkLock held. Hosts that already have the profile are skipped
+// unless forced.
+void BleKeyboard::applyLinkProfile(LinkProfile profile, bool force) {
+    _linkProfile = profile;
+    for (Host& host : _hosts) {
+        if (host.connHandle != BLE_HS_CONN_HANDLE_NONE && (force || host.linkProfile != profile)) {
+            requestLinkProfile(host, profile);
+        }
+    }
+    if (profile == LinkProfile::Active) {
+        esp_timer_start_once(_linkTimer, _connectionPolicy.idleMs * 1000ULL); // Fails harmlessly if already armed
+    }
+}
+
+void BleKeyboard::requestLinkProfile(Host& host, LinkProfile profile) {
+    const ConnectionPolicy& policy = _connectionPolicy;
+    bool active = profile == LinkProfile::Active;
+    host.linkProfile = profile;
+    NimBLEDevice::getServer()->updateConnParams(host.connHandle,
+                                                active ? policy.activeMinInterval : policy.idleMinInterval,
+                                                active ? policy.activeMaxInterval : policy.idleMaxInterval,
+                                                active ? policy.activeLatency : policy.idleLatency,
+                                                policy.supervisionTimeout);
+}
+
+void BleKeyboard::linkIdleTimer(void* arg) {
+    static_cast<BleKeyboard*>(arg)->checkLinkIdle();
+}
+
+// Runs on the esp_timer task. Reports still queued or text still waiting in
+// the async buffer keep the active profile, whatever the time since the last report.
+void BleKeyboard::checkLinkIdle(void) {
+    xSemaphoreTake(_linkLock, portMAX_DELAY);
+    int64_t idleTime = _connectionPolicy.idleMs * 1000LL;
+    int64_t idleFor = esp_timer_get_time() - _lastActivity;
+    if (_linkProfile == LinkProfile::Active && idleTime > 0) {
+        bool queued = _asyncPending > 0;
+        xSemaphoreTake(_reportLock, portMAX_DELAY);
+        for (const Host& host : _hosts) {
+            queued = queued || (host.subscribed && host.queueCount > 0);
+        }
+        xSemaphoreGive(_reportLock);
+        if (idleFor >= idleTime && !queued) {
+            applyLinkProfile(LinkProfile::Idle, false);
+        } else {
+            esp_timer_start_once(_linkTimer, idleFor < idleTime ? idleTime - idleFor : idleTime);
+        }
+    }
+    xSemaphoreGive(_linkLock);
 }
 
 void BleKeyboard::onConnect(NimBLEServer* pServer, NimBLEConnInfo& connInfo) {
-    connected = true;
+    Host* host = findHost(BLE_HS_CONN_HANDLE_NONE);
+    if (host == nullptr) {
+        ESP_LOGW(LOG_TAG, "already serving %d hosts, refusing another", BLE_KEYBOARD_MAX_HOSTS);
+        pServer->disconnect(connInfo.getConnHandle());
+        return;
+    }
+    bool wasOffline = !isConnected();
+    if (wasOffline && _awaitingFirstReport) {
+        _metrics.connectMicros = esp_timer_get_time() - _offlineSince;
+    }
+    memset(&host->keyReport, 0, sizeof(host->keyReport));
+    memset(&host->nkroReport, 0, sizeof(host->nkroReport));
+    host->queueHead = 0;
+    host->queueCount = 0;
+    host->lagging = false;
+    host->subscribed = false;
+    host->address = connInfo.getIdAddress();
+    host->ledState = 0;
+    host->scrollLockTaps = 0;
+    host->scrollLockEchoes = 0;
+    host->planner = KeyReportPlanner();
+    host->typingCapsLock = false;
+    host->linkProfile = LinkProfile::Idle; // Nothing requested yet, the host chose the parameters
+    xSemaphoreTake(_reportLock, portMAX_DELAY);
+    if (wasOffline && _targetAll && _backlogCount > 0 && _replayHost == nullptr) {
+        if (isBacklogOwner(host->address)) {
+            // This host gets what was typed meanwhile, and the key state it left
+            _replayHost = host;
+            host->keyReport = _offline.keyReport;
+            host->nkroReport = _offline.nkroReport;
+        } else {
+            ESP_LOGW(LOG_TAG, "dropping %d offline reports, typed for another host", (int)_backlogCount);
+            dropBacklog();
+        }
+    }
+    xSemaphoreGive(_reportLock);
+    host->connHandle = connInfo.getConnHandle();
+    updateConnectionParams(connInfo);
+    if (_connectionPolicy.idleMs != 0) {
+        // Set-up goes faster on a short interval, and the host may be about to get a backlog
+        _lastActivity = esp_timer_get_time();
+        xSemaphoreTake(_linkLock, portMAX_DELAY);
+        applyLinkProfile(LinkProfile::Active, false);
+        xSemaphoreGive(_linkLock);
+    }
+    if (_targetAll) {
+        _targets |= 1u << (host - _hosts);
+    }
+    if (findHost(BLE_HS_CONN_HANDLE_NONE) != nullptr) {
+        startAdvertising(); // Keep accepting hosts while there is room
+    } else {
+        pServer->getAdvertising()->stop();
+    }
     if (connectCallback) connectCallback();
 }
 
+void BleKeyboard::onConnParamsUpdate(NimBLEConnInfo& connInfo) {
+    updateConnectionParams(connInfo);
+}
+
 void BleKeyboard::onDisconnect(NimBLEServer* pServer, NimBLEConnInfo& connInfo, int reason) {
-    connected = false;
+    Host* host = findHost(connInfo.getConnHandle());
+    if (host == nullptr) {
+        return; // Refused in onConnect()
+    }
+    _targets &= ~(1u << (host - _hosts));
+    host->connHandle = BLE_HS_CONN_HANDLE_NONE;
+    _lastHost = connInfo.getIdAddress();
+    _lastHostBonded = connInfo.isBonded();
+    if (!isConnected()) {
+        _offlineSince = esp_timer_get_time();
+        _awaitingFirstReport = true;
+        if (_targetAll) {
+            // Typing carries on offline from the host's key state, and what it
+            // did not get yet goes in front of the backlog for the next host
+            xSemaphoreTake(_reportLock, portMAX_DELAY);
+            _offline.keyReport = host->keyReport;
+            _offline.nkroReport = host->nkroReport;
+            while (host->queueCount > 0 && _backlogCount < BLE_KEYBOARD_BACKLOG_SIZE) {
+                host->queueCount--;
+                _backlogHead = (_backlogHead + BLE_KEYBOARD_BACKLOG_SIZE - 1) % BLE_KEYBOARD_BACKLOG_SIZE;
+                _backlog[_backlogHead] = host->queue[(host->queueHead + host->queueCount) % BLE_KEYBOARD_REPORT_QUEUE_SIZE];
+                _backlogCount++;
+            }
+            xSemaphoreGive(_reportLock);
+        }
+    }
+    clearReportQueue(*host);
+    startAdvertising();
     if (disconnectCallback) disconnectCallback();
 }
 
+// Reconnection strategy: directed advertising to the bonded hosts most likely
+// to come back, which a host scanning for its devices answers at once, then
+// fast advertising for BLE_KEYBOARD_FAST_ADV_MS so a waking host finds the
+// keyboard quickly, then slow advertising to save power.
+void BleKeyboard::startAdvertising(void) {
+    _directedPeer = 0;
+    advertise(AdvertisingPhase::Directed);
+}
+
+void BleKeyboard::advertise(AdvertisingPhase phase) {
+    NimBLEAdvertising* advertising = NimBLEDevice::getAdvertising();
+    NimBLEAddress peer;
+    if (phase == AdvertisingPhase::Directed && !directedPeer(_directedPeer, peer)) {
+        phase = AdvertisingPhase::Fast;
+    }
+    advertising->stop();
+    _advPhase = phase;
+    if (phase == AdvertisingPhase::Directed) {
+        ESP_LOGI(LOG_TAG, "directed advertising to %s", peer.toString().c_str());
+        advertising->setConnectableMode(BLE_GAP_CONN_MODE_DIR);
+        advertising->start(BLE_KEYBOARD_DIRECTED_ADV_MS, &peer);
+        return;
+    }
+    uint16_t interval = phase == AdvertisingPhase::Fast ? BLE_KEYBOARD_FAST_ADV_INTERVAL : BLE_KEYBOARD_SLOW_ADV_INTERVAL;
+    advertising->setConnectableMode(BLE_GAP_CONN_MODE_UND);
+    advertising->setMinInterval(interval);
+    advertising->setMaxInterval(interval);
+    advertising->start(phase == AdvertisingPhase::Fast ? BLE_KEYBOARD_FAST_ADV_MS : 0);
+}
+
+// Moves on to the next phase once one has run its course. A phase cut short
+// by a connection ends with another reason, and onConnect() has already
+// decided what follows.
+int BleKeyboard::gapEvent(struct ble_gap_event* event, void* arg) {
+    if (event->type == BLE_GAP_EVENT_ADV_COMPLETE && event->adv_complete.reason == BLE_HS_ETIMEOUT &&
+        _gapInstance != nullptr) {
+        _gapInstance->advertisingComplete();
+    }
+    return 0;
+}
+
+void BleKeyboard::advertisingComplete(void) {
+    if (_advPhase == AdvertisingPhase::Directed) {
+        _directedPeer++;
+        advertise(AdvertisingPhase::Directed);
+    } else if (_advPhase == AdvertisingPhase::Fast) {
+        advertise(AdvertisingPhase::Slow);
+    }
+}
+
+// The index-th host to advertise to directly: the last host if it was bonded,
+// then the other bonded hosts, newest first. Connected hosts are skipped.
+bool BleKeyboard::directedPeer(size_t index, NimBLEAddress& peer) const {
+    if (index >= BLE_KEYBOARD_DIRECTED_ADV_PEERS) {
+        return false;
+    }
+    int bonds = NimBLEDevice::getNumBonds();
+    size_t found = 0;
+    for (int i = _lastHostBonded ? -1 : 0; i < bonds; i++) {
+        NimBLEAddress candidate = i < 0 ? _lastHost : NimBLEDevice::getBondedAddress(bonds - 1 - i);
+        if (i >= 0 && _lastHostBonded && candidate == _lastHost) {
+            continue;
+        }
+        bool connected = false;
+        for (const Host& host : _hosts) {
+            connected = connected || (host.connHandle != BLE_HS_CONN_HANDLE_NONE && host.address == candidate);
+        }
+        if (!connected && found++ == index) {
+            peer = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
 void BleKeyboard::onConnect(Callback cb) {
     connectCallback = cb;
 }
@@ -426,8 +988,15 @@ void BleKeyboard::onDisconnect(Callback cb) {
 }
 
 void BleKeyboard::onWrite(NimBLECharacteristic* pCharacteristic, NimBLEConnInfo& connInfo) {
-  uint8_t* value = (uint8_t*)(pCharacteristic->getValue().c_str());
-  ESP_LOGI(LOG_TAG, "special keys: %d", *value);
+  Host* host = findHost(connInfo.getConnHandle());
+  if (pCharacteristic->getLength() > 0 && host != nullptr) {
+    uint8_t ledState = pCharacteristic->getValue<uint8_t>(); // Read in place, getValue() would copy to the heap
+    if ((host->ledState.exchange(ledState) ^ ledState) & LED_SCROLL_LOCK) {
+      host->scrollLockEchoes++; // See flush(timeout)
+    }
+    ESP_LOGI(LOG_TAG, "host %d: LED state: 0x%02x", host->connHandle, host->ledState.load());
+    xSemaphoreGive(_ledChanged);
+  }
 }
 
 
@@ -437,124 +1006,179 @@ void BleKeyboard::onWrite(NimBLECharacteristic* pCharacteristic, NimBLEConnInfo&
 // USB HID works, the host acts like the key remains pressed until we
 // call release(), releaseAll(), or otherwise clear the report and resend.
 
-// private method to find and place a usage ID in the report
-bool BleKeyboard::addKeyToReport(uint8_t usage_id)
+// private method to find and place a usage ID in a host's report. In NKRO
+// mode the key goes into the bitmap, and into keyReport as long as it has room.
+bool BleKeyboard::addKeyToReport(Host& host, uint8_t usage_id)
 {
+    if (_reportMode == ReportMode::Nkro) {
+        if (usage_id >= NKRO_KEY_COUNT) {
+            return false; // Outside the bitmap
+        }
+        host.nkroReport.keys[usage_id / 8] |= 1 << (usage_id % 8);
+    }
     for (int i = 0; i < 6; i++) {
-        if (_keyReport.keys[i] == usage_id) { // Key already in report
+        if (host.keyReport.keys[i] == usage_id) { // Key already in report
             return true;
         }
     }
     for (int i = 0; i < 6; i++) {
-        if (_keyReport.keys[i] == 0x00) { // Found empty slot
-            _keyReport.keys[i] = usage_id;
-			vTaskDelay(10);
+        if (host.keyReport.keys[i] == 0x00) { // Found empty slot
+            host.keyReport.keys[i] = usage_id;
             return true;
         }
     }
-    return false; // No empty slot
+    return _reportMode == ReportMode::Nkro; // No empty slot
 }
 
-// private method to remove a usage ID from the report
-void BleKeyboard::removeKeyFromReport(uint8_t usage_id)
+// private method to remove a usage ID from a host's report
+void BleKeyboard::removeKeyFromReport(Host& host, uint8_t usage_id)
 {
+    if (usage_id < NKRO_KEY_COUNT) {
+        host.nkroReport.keys[usage_id / 8] &= ~(1 << (usage_id % 8));
+    }
     for (int i = 0; i < 6; i++) {
-        if (_keyReport.keys[i] == usage_id) {
-            _keyReport.keys[i] = 0x00;
+        if (host.keyReport.keys[i] == usage_id) {
+            host.keyReport.keys[i] = 0x00;
         }
     }
 }
 
-// press() for UNICODE characters.
-size_t BleKeyboard::press(uint8_t k)
+// press() for UNICODE characters. Each targeted host gets the key with the
+// modifiers its own CapsLock state calls for.
+size_t BleKeyboard::pressKey(char32_t k)
 {
-    for (size_t i = 0; i < keymapSize; i++) {
-        if (keymap[i].unicode == k) {
-            const KeyPressSequence* seq = &keymap[i].sequence;
-            
-            _keyReport.modifiers |= seq->modifiers1;
-            
-            if (seq->key1 != 0 && !addKeyToReport(seq->key1)) {
-                setWriteError();
-                return 0; // Report is full
-            }
-            
-            sendReport(&_keyReport);
-            return 1;
+    const KeymapEntry* entry = _layout->find(k);
+    if (entry == nullptr) {
+        _metrics.charactersUnmapped++;
+        setWriteError();
+        return 0; // Character not in map
+    }
+    const KeyPressSequence* seq = &entry->sequence;
+
+    bool added = true;
+    forEachTarget([&](Host& host) {
+        bool capsLock = (host.ledState & LED_CAPS_LOCK) != 0;
+        host.keyReport.modifiers |= capsLockModifiers(seq->modifiers1, seq->key1, capsLock);
+        if (seq->key1 != 0 && !addKeyToReport(host, seq->key1)) {
+            added = false;
         }
-        vTaskDelay(10);
+    });
+
+    sendKeyState();
+    if (!added) {
+        _metrics.keysDropped++;
+        setWriteError();
+        return 0; // Report is full on some host
     }
-    
-    setWriteError();
-    return 0; // Character not in map
+    return 1;
 }
 
 // press() for Modifier Keys
-size_t BleKeyboard::press(ModifierKey k)
+size_t BleKeyboard::pressKey(ModifierKey k)
 {
-    _keyReport.modifiers |= (1 << static_cast<uint8_t>(k));
-    sendReport(&_keyReport);
-	vTaskDelay(10);
+    forEachTarget([k](Host& host) { host.keyReport.modifiers |= (1 << static_cast<uint8_t>(k)); });
+    sendKeyState();
     return 1;
 }
 
 // press() for Special Keys
-size_t BleKeyboard::press(SpecialKey k)
+size_t BleKeyboard::pressKey(SpecialKey k)
 {
-    if (!addKeyToReport(static_cast<uint8_t>(k))) {
+    bool added = true;
+    forEachTarget([&](Host& host) { added = addKeyToReport(host, static_cast<uint8_t>(k)) && added; });
+    sendKeyState();
+    if (!added) {
+        _metrics.keysDropped++;
         setWriteError();
-        return 0; // Report is full
+        return 0; // Report is full on some host
     }
-    sendReport(&_keyReport);
-	vTaskDelay(10);
     return 1;
 }
 
 // release() for UNICODE characters
-size_t BleKeyboard::release(uint8_t k)
-{
-    for (size_t i = 0; i < keymapSize; i++) {
-        if (keymap[i].unicode == k) {
-            const KeyPressSequence* seq = &keymap[i].sequence;
-            
-            _keyReport.modifiers &= ~seq->modifiers1;
-            
-            if (seq->key1 != 0) {
-                removeKeyFromReport(seq->key1);
-            }
-            
-            sendReport(&_keyReport);
-            return 1;
-        }
+size_t BleKeyboard::releaseKey(char32_t k)
+{
+    const KeymapEntry* entry = _layout->find(k);
+    if (entry == nullptr) {
+        return 0; // Character not in map
     }
-    vTaskDelay(10);
-    return 0; // Character not in map
+    const KeyPressSequence* seq = &entry->sequence;
+
+    forEachTarget([&](Host& host) {
+        bool capsLock = (host.ledState & LED_CAPS_LOCK) != 0;
+        host.keyReport.modifiers &= ~capsLockModifiers(seq->modifiers1, seq->key1, capsLock);
+        if (seq->key1 != 0) {
+            removeKeyFromReport(host, seq->key1);
+        }
+    });
+
+    sendKeyState();
+    return 1;
 }
 
 // release() for Modifier Keys
-size_t BleKeyboard::release(ModifierKey k)
+size_t BleKeyboard::releaseKey(ModifierKey k)
 {
-    _keyReport.modifiers &= ~(1 << static_cast<uint8_t>(k));
-    sendReport(&_keyReport);
+    forEachTarget([k](Host& host) { host.keyReport.modifiers &= ~(1 << static_cast<uint8_t>(k)); });
+    sendKeyState();
     return 1;
 }
 
 // release() for Special Keys
-size_t BleKeyboard::release(SpecialKey k)
+size_t BleKeyboard::releaseKey(SpecialKey k)
 {
-    removeKeyFromReport(static_cast<uint8_t>(k));
-    sendReport(&_keyReport);
+    forEachTarget([this, k](Host& host) { removeKeyFromReport(host, static_cast<uint8_t>(k)); });
+    sendKeyState();
     return 1;
 }
 
+size_t BleKeyboard::press(char32_t k)
+{
+    return afterQueuedText([&] { return pressKey(k); });
+}
+
+size_t BleKeyboard::press(ModifierKey k)
+{
+    return afterQueuedText([&] { return pressKey(k); });
+}
+
+size_t BleKeyboard::press(SpecialKey k)
+{
+    return afterQueuedText([&] { return pressKey(k); });
+}
+
+size_t BleKeyboard::release(char32_t k)
+{
+    return afterQueuedText([&] { return releaseKey(k); });
+}
+
+size_t BleKeyboard::release(ModifierKey k)
+{
+    return afterQueuedText([&] { return releaseKey(k); });
+}
+
+size_t BleKeyboard::release(SpecialKey k)
+{
+    return afterQueuedText([&] { return releaseKey(k); });
+}
+
 size_t BleKeyboard::tap(SpecialKey k)
 {
-    press(k);
-    delay(10); 
-    return release(k);
+    return afterQueuedText([&] {
+        pressKey(k);
+        return releaseKey(k);
+    });
 }
 
 void BleKeyboard::releaseAll(void)
+{
+    afterQueuedText([this] {
+        releaseAllKeys();
+        return size_t(0);
+    });
+}
+
+void BleKeyboard::releaseAllKeys(void)
 {
 	_keyReport.keys[0] = 0;
 	_keyReport.keys[1] = 0;
@@ -564,104 +1188,922 @@ void BleKeyboard::releaseAll(void)
 	_keyReport.keys[5] = 0;
 	_keyReport.modifiers = 0;
 	sendReport(&_keyReport);
-	vTaskDelay(10);
 }
 
 size_t BleKeyboard::write(const uint8_t *buffer, size_t size) {
-    size_t n = 0;
-    for (size_t i = 0; i < size; ) {
-        uint32_t unicode_char = 0;
-        int len = 0;
-        unsigned char c = buffer[i];
-
-        if (c < 0x80) { // 1-byte
-            unicode_char = c;
-            len = 1;
-        } else if ((c & 0xE0) == 0xC0 && i + 1 < size) { // 2-byte
-            unicode_char = ((buffer[i] & 0x1F) << 6) | (buffer[i+1] & 0x3F);
-            len = 2;
-        } else if ((c & 0xF0) == 0xE0 && i + 2 < size) { // 3-byte
-            unicode_char = ((buffer[i] & 0x0F) << 12) | ((buffer[i+1] & 0x3F) << 6) | (buffer[i+2] & 0x3F);
-            len = 3;
-        } else if ((c & 0xF8) == 0xF0 && i + 3 < size) { // 4-byte
-             unicode_char = ((buffer[i] & 0x07) << 18) | ((buffer[i+1] & 0x3F) << 12) | ((buffer[i+2] & 0x3F) << 6) | (buffer[i+3] & 0x3F);
-            len = 4;
-        } else { // Invalid sequence, skip
-            i++;
-            continue;
-        }
+    if (_asyncBuffer == nullptr) {
+        return _input.run([&] {
+            typeText(buffer, size);
+            return size;
+        });
+    }
+    return _textInput.run([&] { return queueText(buffer, size); });
+}
 
-        typeUnicodeCharacter(unicode_char);
-        i += len;
-        n++;
-        delay(_delay);
+/**
+ * @brief Private helper storing one write() in the async buffer as a frame: a
+ * 16-bit length, then the text. The typing task types each frame as a single
+ * call, so it is not interleaved with other tasks' keys. Text that fits in the
+ * buffer is queued whole or not at all; only text larger than the whole buffer
+ * is split, as far as there is room.
+ */
+size_t BleKeyboard::queueText(const uint8_t *buffer, size_t size) {
+    const size_t header = sizeof(uint16_t);
+    size_t space = xStreamBufferSpacesAvailable(_asyncBuffer);
+    if (size + header > space && size + header <= _asyncBufferSize) {
+        return 0;
     }
-    return n;
+    noteActivity(); // The link is fast again by the time the typing task gets to the text
+    size_t queued = 0;
+    while (queued < size && space > header) {
+        uint16_t length = std::min<size_t>(std::min<size_t>(size - queued, space - header), UINT16_MAX);
+        // Count the bytes as pending before they become visible to the typing task,
+        // so that flush() never sees an empty queue while text is still in flight.
+        _asyncPending += length;
+        xStreamBufferSend(_asyncBuffer, &length, header, 0);
+        xStreamBufferSend(_asyncBuffer, buffer + queued, length, 0);
+        queued += length;
+        space -= header + length;
+    }
+    return queued;
 }
 
 size_t BleKeyboard::write(uint8_t c) {
     return write(&c, 1);
 }
 
+// Typed text is planned for each targeted host on its own, since hosts with
+// CapsLock in different states need different Shift states for the same
+// characters. plan(host, emit) calls emit(report) for each report of that
+// host; the n-th reports of all hosts then go out together, each followed by
+// the typing delay when paced. A host with fewer reports repeats its last one.
+template <typename Plan>
+void BleKeyboard::typeOnEachHost(bool paced, Plan&& plan) {
+    uint8_t steps = 0;
+    forEachTarget([&](Host& host) {
+        host.plannedCount = 0;
+        plan(host, [&host](const KeyReport& report) {
+            if (host.plannedCount < sizeof(host.planned) / sizeof(host.planned[0])) {
+                host.planned[host.plannedCount++] = report;
+            }
+        });
+        steps = std::max(steps, host.plannedCount);
+    });
+    for (uint8_t i = 0; i < steps; i++) {
+        forEachTarget([&](Host& host) {
+            if (i < host.plannedCount) {
+                setHostReport(host, host.planned[i]);
+            }
+        });
+        sendKeyState();
+        if (paced) {
+            typingDelay();
+        }
+    }
+}
+
+// Sets a typed report as the key state of one host, in the report mode's layout
+void BleKeyboard::setHostReport(Host& host, const KeyReport& report) {
+    host.keyReport = report;
+    if (_reportMode == ReportMode::Nkro) {
+        memset(&host.nkroReport, 0, sizeof(host.nkroReport));
+        for (int i = 0; i < 6; i++) {
+            if (report.keys[i] != 0 && report.keys[i] < NKRO_KEY_COUNT) {
+                host.nkroReport.keys[report.keys[i] / 8] |= 1 << (report.keys[i] % 8);
+            }
+        }
+    }
+}
+
 /**
- * @brief Private helper to type a single Unicode character using the keymap.
+ * @brief Private helper to type a UTF-8 buffer; returns the number of characters.
  */
-void BleKeyboard::typeUnicodeCharacter(uint32_t unicode_char) {
-    for (size_t i = 0; i < keymapSize; i++) {
-        if (keymap[i].unicode == unicode_char) {
-            const KeyPressSequence* seq = &keymap[i].sequence;
-
-            // Check if it's a sequence (e.g., dead key)
-            if (seq->key1 != 0 && seq->key2 != 0) {
-                // First key press of the sequence
-                pressRaw(seq->key1, seq->modifiers1);
-                vTaskDelay(10); // Use a short, fixed delay for reliability
-                releaseAll();
-                vTaskDelay(10);
-
-                // Second key press of the sequence
-                pressRaw(seq->key2, seq->modifiers2); // Use the new modifier for the second key
-                vTaskDelay(10);
-                releaseAll();
-            } else { // Single keypress
-                uint8_t key_to_press = seq->key1;
-                if (key_to_press != 0) {
-                    pressRaw(key_to_press, seq->modifiers1);
-                    vTaskDelay(10);
-                    releaseAll();
+size_t BleKeyboard::typeText(const uint8_t *buffer, size_t size) {
+    beginText();
+    size_t n = typeTextChunk(buffer, size);
+    endText();
+    return n;
+}
+
+// A text is typed as one or more chunks between beginText() and endText(). The
+// keys held by rollover and the CapsLock state each host had when the text
+// began carry over from one chunk to the next.
+void BleKeyboard::beginText(void) {
+    forEachTarget([](Host& host) { host.typingCapsLock = (host.ledState & LED_CAPS_LOCK) != 0; });
+}
+
+size_t BleKeyboard::typeTextChunk(const uint8_t *buffer, size_t size) {
+    return _decoder.decode(buffer, size, [&](uint32_t unicode_char) {
+        int64_t start = esp_timer_get_time();
+        if (_typingMode == TypingMode::Rollover) {
+            typeRolloverCharacter(unicode_char);
+        } else {
+            typeUnicodeCharacter(unicode_char);
+        }
+        recordLatency(esp_timer_get_time() - start);
+        characterTyped(unicode_char);
+        if (_adaptiveRate && ++_charsSinceProbe >= BLE_KEYBOARD_ADAPTIVE_PROBE_CHARS) {
+            finishRollover(); // Nothing held down while waiting for the host
+            adaptRate();
+        }
+    });
+}
+
+void BleKeyboard::endText(void) {
+    finishRollover();
+}
+
+// Releases whatever rollover still holds
+void BleKeyboard::finishRollover(void) {
+    typeOnEachHost(false, [](Host& host, auto&& emit) { host.planner.finish(emit); });
+}
+
+bool BleKeyboard::beginAsync(size_t bufferSize)
+{
+    if (_asyncBuffer != nullptr) {
+        return true;
+    }
+    _asyncBuffer = xStreamBufferCreate(bufferSize, 1);
+    if (_asyncBuffer == nullptr) {
+        return false;
+    }
+    _asyncBufferSize = bufferSize;
+    _asyncStop = false;
+    _asyncStopped = xSemaphoreCreateBinaryStatic(&_asyncStoppedBuffer);
+    if (xTaskCreatePinnedToCore(asyncTypingTask, "BleKeyboard", 4096, this, _taskPlacement.priority, &_asyncTask,
+                                _taskPlacement.core) != pdPASS) {
+        vStreamBufferDelete(_asyncBuffer);
+        _asyncBuffer = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void BleKeyboard::endAsync(void)
+{
+    if (_asyncBuffer == nullptr) {
+        return;
+    }
+    flush();
+    // An empty frame wakes the typing task, which sees the stop flag and ends
+    // itself between frames, with nothing held and no lock taken
+    _asyncStop = true;
+    _textInput.run([this] {
+        uint16_t length = 0;
+        return xStreamBufferSend(_asyncBuffer, &length, sizeof(length), portMAX_DELAY);
+    });
+    xSemaphoreTake(_asyncStopped, portMAX_DELAY);
+    vSemaphoreDelete(_asyncStopped);
+    vStreamBufferDelete(_asyncBuffer);
+    _asyncTask = nullptr;
+    _asyncBuffer = nullptr;
+}
+
+bool BleKeyboard::isAsync(void) const
+{
+    return _asyncBuffer != nullptr;
+}
+
+size_t BleKeyboard::pendingText(void) const
+{
+    return _asyncPending;
+}
+
+int BleKeyboard::availableForWrite(void)
+{
+    if (_asyncBuffer == nullptr) {
+        return Print::availableForWrite();
+    }
+    size_t space = xStreamBufferSpacesAvailable(_asyncBuffer);
+    return space > sizeof(uint16_t) ? space - sizeof(uint16_t) : 0; // Less the frame header
+}
+
+// Waits until everything queued by write() has been typed.
+void BleKeyboard::flush(void)
+{
+    while (_asyncBuffer != nullptr && _asyncPending > 0) {
+        vTaskDelay(1);
+    }
+}
+
+// End-to-end barrier: once the reports already sent have left, ScrollLock is
+// tapped and the call waits for every targeted host to echo the new LED state,
+// then tapped again to restore it. A host handles reports in order, so its echo
+// means it has processed everything typed before. Returns false on timeout,
+// with no host connected, or with a host that does not echo ScrollLock, such as
+// macOS. Keys held with press() stay held, so avoid holding modifiers: with
+// Ctrl, ScrollLock is Break.
+bool BleKeyboard::flush(uint32_t timeoutMs)
+{
+    return afterQueuedText([&] { return size_t(hostBarrier(timeoutMs)); }) != 0;
+}
+
+bool BleKeyboard::hostBarrier(uint32_t timeoutMs)
+{
+    uint32_t hosts = _targets;
+    if (hosts == 0) {
+        return false; // Offline text waits in the backlog, nobody can answer
+    }
+    int64_t deadline = esp_timer_get_time() + timeoutMs * 1000LL;
+    // Echoes still owed by an earlier barrier that timed out come first
+    bool echoed = drainReports(hosts, deadline) && waitForEchoes(hosts, deadline);
+    // The second tap always goes out, so ScrollLock ends as it was even when
+    // the first echo is late
+    for (int tap = 0; tap < 2; tap++) {
+        int64_t sent = esp_timer_get_time();
+        pressKey(SpecialKey::ScrollLock);
+        releaseKey(SpecialKey::ScrollLock);
+        forEachTarget([](Host& host) { host.scrollLockTaps++; });
+        if (!echoed) {
+            continue;
+        }
+        echoed = waitForEchoes(hosts, deadline);
+        if (echoed) {
+            uint32_t roundTrip = std::max<int64_t>(esp_timer_get_time() - sent, 1);
+            _metrics.roundTrips++;
+            _metrics.roundTripMicros = roundTrip;
+            if (_roundTripBest == 0 || roundTrip < _roundTripBest) {
+                _roundTripBest = roundTrip;
+            }
+        }
+    }
+    if (!echoed) {
+        _metrics.flushTimeouts++;
+    }
+    return echoed;
+}
+
+// Waits until the given hosts have handed every queued report to the stack
+bool BleKeyboard::drainReports(uint32_t hosts, int64_t deadline)
+{
+    for (;;) {
+        bool queued = false;
+        for (size_t i = 0; i < BLE_KEYBOARD_MAX_HOSTS; i++) {
+            queued = queued || (((hosts >> i) & 1) && _hosts[i].queueCount > 0);
+        }
+        int64_t remaining = deadline - esp_timer_get_time();
+        if (!queued || remaining <= 0) {
+            return !queued;
+        }
+        pumpReports();
+        xSemaphoreTake(_reportSent, pdMS_TO_TICKS(remaining / 1000 + 1));
+    }
+}
+
+// Waits until the given hosts have echoed every ScrollLock tap. Hosts that
+// disconnect meanwhile no longer count. On timeout the counts are brought
+// level, so an echo that never comes does not fail every later barrier.
+bool BleKeyboard::waitForEchoes(uint32_t hosts, int64_t deadline)
+{
+    for (;;) {
+        bool echoed = true;
+        for (size_t i = 0; i < BLE_KEYBOARD_MAX_HOSTS; i++) {
+            const Host& host = _hosts[i];
+            if (((hosts >> i) & 1) && host.connHandle != BLE_HS_CONN_HANDLE_NONE &&
+                host.scrollLockEchoes < host.scrollLockTaps) {
+                echoed = false;
+            }
+        }
+        int64_t remaining = deadline - esp_timer_get_time();
+        if (echoed || remaining <= 0) {
+            for (Host& host : _hosts) {
+                host.scrollLockEchoes = host.scrollLockTaps; // Also drops changes made by another keyboard
+            }
+            return echoed;
+        }
+        xSemaphoreTake(_ledChanged, pdMS_TO_TICKS(remaining / 1000 + 1));
+    }
+}
+
+// Additive increase, multiplicative decrease of the typing rate: a probe that
+// comes back in time and close to the best round trip seen shortens the delay
+// by 1 ms, while one that times out or takes over twice as long, as when the
+// host falls behind and starts losing keys, doubles it. Hosts that never echo
+// leave the delay alone.
+void BleKeyboard::adaptRate(void)
+{
+    _charsSinceProbe = 0;
+    bool echoed = hostBarrier(BLE_KEYBOARD_ADAPTIVE_TIMEOUT_MS);
+    if (_roundTripBest == 0) {
+        return;
+    }
+    if (echoed && _metrics.roundTripMicros <= 2 * _roundTripBest) {
+        if (_delay > 0) {
+            _delay--;
+        }
+    } else {
+        _delay = std::min<uint32_t>(std::max<uint32_t>(_delay * 2, 1), BLE_KEYBOARD_ADAPTIVE_MAX_DELAY);
+    }
+}
+
+void BleKeyboard::onTypingComplete(Callback cb) {
+    typingCompleteCallback = cb;
+}
+
+void BleKeyboard::asyncTypingTask(void* arg)
+{
+    static_cast<BleKeyboard*>(arg)->runAsyncTyping();
+}
+
+void BleKeyboard::runAsyncTyping(void)
+{
+    for (;;) {
+        // A frame is written whole before the next write(), so its text is
+        // all there once its header is
+        uint16_t length;
+        size_t received = 0;
+        while (received < sizeof(length)) {
+            received += xStreamBufferReceive(_asyncBuffer, (uint8_t*)&length + received, sizeof(length) - received,
+                                             portMAX_DELAY);
+        }
+        if (_asyncStop) {
+            break;
+        }
+        _input.run([&] {
+            typeQueuedText(length);
+            return size_t(length);
+        });
+
+        if ((_asyncPending -= length) == 0 && typingCompleteCallback) {
+            typingCompleteCallback();
+        }
+    }
+    xSemaphoreGive(_asyncStopped);
+    vTaskDelete(nullptr);
+}
+
+void BleKeyboard::typeQueuedText(size_t length)
+{
+    uint8_t chunk[64];
+    beginText();
+
+    while (length > 0) {
+        // A character split across chunks is completed by the decoder on the next one
+        size_t received = xStreamBufferReceive(_asyncBuffer, chunk, std::min(length, sizeof(chunk)), portMAX_DELAY);
+        typeTextChunk(chunk, received);
+        length -= received;
+    }
+    endText();
+}
+
+// Starts a macro and returns at once; false if it is malformed or another
+// macro is still playing.
+bool BleKeyboard::playMacro(const uint8_t* macro, size_t size)
+{
+    if (!validateKeyMacro(macro, size)) {
+        return false;
+    }
+    MacroState state = _macroState;
+    do {
+        if (state == MacroState::Playing) {
+            return false;
+        }
+        // Cleared before the macro shows as playing, so a stopMacro() from then on is kept
+        _macroStop = false;
+    } while (!_macroState.compare_exchange_weak(state, MacroState::Playing));
+    if (_macroTask == nullptr && xTaskCreatePinnedToCore(macroTask, "BleKeyboardMacro", 4096, this, _taskPlacement.priority,
+                                                         &_macroTask, _taskPlacement.core) != pdPASS) {
+        _macroTask = nullptr;
+        _macroState = state;
+        return false;
+    }
+    _macroPending = macro + KEY_MACRO_HEADER_SIZE;
+    xTaskNotifyGive(_macroTask);
+    return true;
+}
+
+void BleKeyboard::stopMacro(void)
+{
+    if (_macroState == MacroState::Playing) {
+        _macroStop = true;
+        xTaskNotifyGive(_macroTask); // Cuts the current wait short
+    }
+}
+
+MacroState BleKeyboard::getMacroState(void) const
+{
+    return _macroState;
+}
+
+void BleKeyboard::onMacroComplete(Callback cb) {
+    macroCompleteCallback = cb;
+}
+
+void BleKeyboard::macroTask(void* arg)
+{
+    static_cast<BleKeyboard*>(arg)->runMacros();
+}
+
+void BleKeyboard::runMacros(void)
+{
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        const uint8_t* step = _macroPending.exchange(nullptr);
+        if (step == nullptr) {
+            continue; // Woken by a stale notification
+        }
+        MacroState result = runMacroSteps(step);
+        if (result != MacroState::Done) {
+            afterQueuedText([this] {
+                releaseAllKeys(); // Nothing stays held by a macro cut short
+                return size_t(0);
+            });
+        }
+        _macroState = result;
+        if (macroCompleteCallback) {
+            macroCompleteCallback();
+        }
+    }
+}
+
+// Each step is a call of its own, like press() and write(), so other tasks'
+// keys can go out while a macro waits. Waits sleep on the task notification
+// until they are due, which stopMacro() cuts short.
+MacroState BleKeyboard::runMacroSteps(const uint8_t* step)
+{
+    for (;; step += keyMacroStepSize(step, SIZE_MAX)) {
+        if (_macroStop) {
+            return MacroState::Stopped;
+        }
+        uint8_t modifiers = step[1];
+        uint8_t key = step[2];
+        switch (static_cast<KeyMacroOp>(step[0])) {
+        case KeyMacroOp::End:
+            return MacroState::Done;
+        case KeyMacroOp::Press:
+        case KeyMacroOp::Release:
+        case KeyMacroOp::Chord:
+            afterQueuedText([&] {
+                if (static_cast<KeyMacroOp>(step[0]) != KeyMacroOp::Release) {
+                    macroKeys(modifiers, key, true);
+                }
+                if (static_cast<KeyMacroOp>(step[0]) != KeyMacroOp::Press) {
+                    macroKeys(modifiers, key, false);
+                }
+                return size_t(0);
+            });
+            break;
+        case KeyMacroOp::Hold: {
+            afterQueuedText([&] {
+                macroKeys(modifiers, key, true);
+                return size_t(0);
+            });
+            bool held = macroWait(esp_timer_get_time() + (step[3] | step[4] << 8) * 1000LL);
+            afterQueuedText([&] {
+                macroKeys(modifiers, key, false);
+                return size_t(0);
+            });
+            if (!held) {
+                return MacroState::Stopped;
+            }
+            break;
+        }
+        case KeyMacroOp::Wait:
+            if (!macroWait(esp_timer_get_time() + (step[1] | step[2] << 8) * 1000LL)) {
+                return MacroState::Stopped;
+            }
+            break;
+        case KeyMacroOp::Type:
+            afterQueuedText([&] { return typeText(step + 2, step[1]); });
+            break;
+        case KeyMacroOp::WaitLed: {
+            int64_t deadline = esp_timer_get_time() + (step[3] | step[4] << 8) * 1000LL;
+            while ((getLedState() & step[1]) != step[2]) {
+                // LED reports come in connection events, no point looking more often
+                int64_t next = esp_timer_get_time() + getReportInterval();
+                if (next > deadline) {
+                    return MacroState::TimedOut;
+                }
+                if (!macroWait(next)) {
+                    return MacroState::Stopped;
                 }
             }
-            return; // Found and typed the character
+            break;
         }
+        case KeyMacroOp::ReleaseAll:
+            afterQueuedText([this] {
+                releaseAllKeys();
+                return size_t(0);
+            });
+            break;
+        }
+    }
+}
+
+bool BleKeyboard::macroWait(int64_t until)
+{
+    for (;;) {
+        if (_macroStop) {
+            return false;
+        }
+        int64_t remaining = until - esp_timer_get_time();
+        if (remaining <= 0) {
+            return true;
+        }
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS((remaining + 999) / 1000));
     }
 }
 
+// Presses or releases modifiers and a key together, in one report
+void BleKeyboard::macroKeys(uint8_t modifiers, uint8_t usage_id, bool down)
+{
+    bool added = true;
+    forEachTarget([&](Host& host) {
+        if (down) {
+            host.keyReport.modifiers |= modifiers;
+            added = (usage_id == 0 || addKeyToReport(host, usage_id)) && added;
+        } else {
+            host.keyReport.modifiers &= ~modifiers;
+            if (usage_id != 0) {
+                removeKeyFromReport(host, usage_id);
+            }
+        }
+    });
+    sendKeyState();
+    if (!added) {
+        _metrics.keysDropped++;
+    }
+}
+
+/**
+ * @brief Private helper to type a single Unicode character using the keymap.
+ */
+void BleKeyboard::typeUnicodeCharacter(uint32_t unicode_char) {
+    const KeymapEntry* entry = _layout->find(unicode_char);
+    if (entry == nullptr) {
+        _metrics.charactersUnmapped++;
+        return;
+    }
+    _metrics.charactersTyped++;
+    const KeyPressSequence* seq = &entry->sequence;
+
+    // Each key is held from its press edge to its release edge, and released
+    // for as long before the next press
+    const KeyReport up = {};
+    typeOnEachHost(true, [&](Host& host, auto&& emit) {
+        // Check if it's a sequence (e.g., dead key)
+        if (seq->key1 != 0 && seq->key2 != 0) {
+            // First key press of the sequence
+            emit(KeyReport{capsLockModifiers(seq->modifiers1, seq->key1, host.typingCapsLock), 0, {seq->key1}});
+            emit(up);
+
+            // Second key press of the sequence, with its own modifiers
+            emit(KeyReport{capsLockModifiers(seq->modifiers2, seq->key2, host.typingCapsLock), 0, {seq->key2}});
+            emit(up);
+        } else if (seq->key1 != 0) { // Single keypress
+            emit(KeyReport{capsLockModifiers(seq->modifiers1, seq->key1, host.typingCapsLock), 0, {seq->key1}});
+            emit(up);
+        }
+    });
+}
+
+/**
+ * @brief Private helper to type a single Unicode character with key rollover.
+ * Each report is held for _delay before the next one; each host's planner
+ * releases everything once the whole text has been typed.
+ */
+void BleKeyboard::typeRolloverCharacter(uint32_t unicode_char) {
+    const KeymapEntry* entry = _layout->find(unicode_char);
+    if (entry == nullptr) {
+        _metrics.charactersUnmapped++;
+        return;
+    }
+    _metrics.charactersTyped++;
+    const KeyPressSequence* seq = &entry->sequence;
+
+    typeOnEachHost(true, [&](Host& host, auto&& emit) {
+        host.planner.stroke(capsLockModifiers(seq->modifiers1, seq->key1, host.typingCapsLock), seq->key1, emit);
+        host.planner.stroke(capsLockModifiers(seq->modifiers2, seq->key2, host.typingCapsLock), seq->key2, emit);
+    });
+}
+
+/**
+ * @brief Replays a compiled report stream (see compileText()). Each report is
+ * held for _delay; no decoding or keymap lookup happens here, and
+ * characterTyped() is not called.
+ */
+size_t BleKeyboard::send(const CompactKeyReport* reports, size_t count) {
+    return afterQueuedText([&] { return sendCompiled(reports, count); });
+}
+
+size_t BleKeyboard::sendCompiled(const CompactKeyReport* reports, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        _keyReport.modifiers = reports[i].modifiers;
+        _keyReport.keys[0] = reports[i].keys[0];
+        _keyReport.keys[1] = reports[i].keys[1];
+        for (int k = 2; k < 6; k++) {
+            _keyReport.keys[k] = 0;
+        }
+        sendReport(&_keyReport);
+        typingDelay();
+    }
+    return count;
+}
+
+KeyCategory BleKeyboard::classifyCharacter(char32_t c) const {
+    const KeymapEntry* entry = _layout->find(c);
+    if (entry == nullptr) {
+        return KeyCategory::Unmapped;
+    }
+    if (entry->flags & KEYMAP_SUBSTITUTE) {
+        return KeyCategory::Substituted;
+    }
+    if (entry->sequence.key2 != 0) {
+        return KeyCategory::DeadKey;
+    }
+    if (entry->sequence.modifiers1 & ALT_GR) {
+        return KeyCategory::AltGr;
+    }
+    if (entry->sequence.modifiers1 & LSHIFT) {
+        return KeyCategory::Shift;
+    }
+    return KeyCategory::Direct;
+}
+
+void BleKeyboard::characterTyped(uint32_t unicode_char) {
+}
+
+void BleKeyboard::reportQueued(uint16_t connHandle, const KeyReport& report) {
+}
+
+// Holds the report just sent for _delay. Reports are paced against a schedule
+// rather than from whenever the previous one was queued: each is due _delay
+// after the one before, and the typing task is woken for it by an esp_timer,
+// so holds do not pick up the tick rounding of delay(). A report that took
+// longer than _delay to queue, waiting for a host, starts the schedule over.
+void BleKeyboard::typingDelay(void) {
+  if (_delay == 0) {
+    return;
+  }
+  int64_t start = esp_timer_get_time();
+  int64_t period = _delay * 1000LL;
+  bool onSchedule = _nextEdge != 0 && start - _nextEdge < period;
+  _nextEdge = onSchedule ? _nextEdge + period : start + period;
+  if (_edgeTimer == nullptr) {
+    delay(_delay); // Before begin()
+  } else if (_nextEdge > start) {
+    esp_timer_start_once(_edgeTimer, _nextEdge - start);
+    xSemaphoreTake(_edgeReached, portMAX_DELAY);
+  }
+  int64_t now = esp_timer_get_time();
+  _metrics.blockedMicros += now - start;
+  if (onSchedule) {
+    int64_t hold = now - _lastEdge;
+    uint32_t jitter = hold > period ? hold - period : period - hold;
+    _metrics.holds++;
+    _metrics.holdJitterMicros += jitter;
+    _metrics.holdJitterMaxMicros = std::max(_metrics.holdJitterMaxMicros, jitter);
+  }
+  _lastEdge = now;
+}
+
+void BleKeyboard::edgeTimer(void* arg) {
+  xSemaphoreGive(static_cast<BleKeyboard*>(arg)->_edgeReached);
+}
+
+// Bucket 0 holds latencies under BLE_KEYBOARD_LATENCY_BUCKET_US, each following
+// bucket is twice as wide as the previous one and the last one is open-ended.
+void BleKeyboard::recordLatency(int64_t micros) {
+  uint32_t scaled = micros / BLE_KEYBOARD_LATENCY_BUCKET_US;
+  size_t bucket = 0;
+  while (scaled != 0 && bucket < BLE_KEYBOARD_LATENCY_BUCKETS - 1) {
+    scaled >>= 1;
+    bucket++;
+  }
+  _metrics.latency[bucket]++;
+}
+
+KeyboardMetrics BleKeyboard::getMetrics(void) const {
+  KeyboardMetrics metrics = _metrics;
+  metrics.queueDepth = 0;
+  for (const Host& host : _hosts) {
+    metrics.queueDepth += host.queueCount;
+  }
+  metrics.queueDepth += _backlogCount;
+#if defined(BLE_KEYBOARD_COUNT_ALLOCATIONS)
+  metrics.heapAllocations = heapAllocations - _heapAllocationsBase;
+#endif
+  return metrics;
+}
+
+void BleKeyboard::resetMetrics(void) {
+  memset(&_metrics, 0, sizeof(_metrics));
+#if defined(BLE_KEYBOARD_COUNT_ALLOCATIONS)
+  _heapAllocationsBase = heapAllocations;
+#endif
+}
+
+void BleKeyboard::enableMetricsService(void) {
+  this->_metricsEnabled = true;
+}
+
+// Called with _reportLock held. The trace is a ring: once full, each new
+// entry replaces the oldest one.
+void BleKeyboard::traceReport(TraceEvent event, uint16_t connHandle, const uint8_t* data, size_t length) {
+#if BLE_KEYBOARD_TRACE_SIZE > 0
+  if (_traceDumping) {
+    _traceLost++; // dumpTrace() is reading the ring outside the lock
+    return;
+  }
+  TraceEntry& entry = _trace[(_traceHead + _traceCount) % BLE_KEYBOARD_TRACE_SIZE];
+  if (_traceCount == BLE_KEYBOARD_TRACE_SIZE) {
+    _traceHead = (_traceHead + 1) % BLE_KEYBOARD_TRACE_SIZE;
+    _traceLost++;
+  } else {
+    _traceCount++;
+  }
+  entry.micros = (uint32_t)esp_timer_get_time();
+  entry.connHandle = connHandle;
+  entry.event = (uint8_t)event;
+  entry.reserved = 0;
+  if (length == sizeof(KeyReport)) {
+    memcpy(&entry.report, data, sizeof(KeyReport));
+    return;
+  }
+  // NKRO: the modifiers and the first 6 keys of the bitmap, in usage order
+  const NkroReport* nkro = (const NkroReport*)data;
+  memset(&entry.report, 0, sizeof(KeyReport));
+  entry.report.modifiers = nkro->modifiers;
+  size_t count = 0;
+  for (size_t usage = 0; usage < NKRO_KEY_COUNT && count < 6; usage++) {
+    if ((nkro->keys[usage / 8] >> (usage % 8)) & 1) {
+      entry.report.keys[count++] = usage;
+    }
+  }
+#endif
+}
+
+// Writes the trace to out, Serial typically, without holding up reports:
+// entries that would be recorded meanwhile are counted as lost instead.
+size_t BleKeyboard::dumpTrace(Print& out) {
+  uint32_t header[4] = {BLE_KEYBOARD_TRACE_MAGIC, BLE_KEYBOARD_TRACE_VERSION | (sizeof(TraceEntry) << 16), 0, 0};
+#if BLE_KEYBOARD_TRACE_SIZE > 0
+  if (_reportLock == nullptr) {
+    return out.write((const uint8_t*)header, sizeof(header)); // Before begin()
+  }
+  xSemaphoreTake(_reportLock, portMAX_DELAY);
+  _traceDumping = true;
+  size_t head = _traceHead;
+  size_t count = _traceCount;
+  header[2] = count;
+  header[3] = _traceLost;
+  xSemaphoreGive(_reportLock);
+
+  size_t written = out.write((const uint8_t*)header, sizeof(header));
+  // Up to the end of the ring, then from its start
+  size_t first = count < BLE_KEYBOARD_TRACE_SIZE - head ? count : BLE_KEYBOARD_TRACE_SIZE - head;
+  written += out.write((const uint8_t*)&_trace[head], first * sizeof(TraceEntry));
+  written += out.write((const uint8_t*)&_trace[0], (count - first) * sizeof(TraceEntry));
+  _traceDumping = false;
+  return written;
+#else
+  return out.write((const uint8_t*)header, sizeof(header));
+#endif
+}
+
+void BleKeyboard::clearTrace(void) {
+#if BLE_KEYBOARD_TRACE_SIZE > 0
+  if (_reportLock == nullptr) {
+    return;
+  }
+  xSemaphoreTake(_reportLock, portMAX_DELAY);
+  _traceHead = 0;
+  _traceCount = 0;
+  _traceLost = 0;
+  xSemaphoreGive(_reportLock);
+#endif
+}
+
+void BleKeyboard::onRead(NimBLECharacteristic* pCharacteristic, NimBLEConnInfo& connInfo) {
+  if (pCharacteristic == _metricsCharacteristic) {
+    KeyboardMetrics metrics = getMetrics();
+    pCharacteristic->setValue((const uint8_t*)&metrics, sizeof(metrics));
+  }
+}
+
+// Keys CapsLock acts on: those typing a lowercase ASCII letter without
+// modifiers, plus the digit row on layouts where it behaves like Shift there.
+void BleKeyboard::updateCapsLockKeys(void) {
+  memset(_capsLockKeys, 0, sizeof(_capsLockKeys));
+  for (char32_t c = U'a'; c <= U'z'; c++) {
+    const KeymapEntry* entry = _layout->find(c);
+    if (entry != nullptr && entry->sequence.modifiers1 == 0 && entry->sequence.key2 == 0 &&
+        entry->sequence.key1 < 128) {
+      _capsLockKeys[entry->sequence.key1 / 32] |= 1u << (entry->sequence.key1 % 32);
+    }
+  }
+  if (_layout->capsLockShiftsTopRow) {
+    for (uint8_t key = KC_1; key <= KC_0; key++) {
+      _capsLockKeys[key / 32] |= 1u << (key % 32);
+    }
+  }
+}
+
+bool BleKeyboard::isCapsLockKey(uint8_t modifiers, uint8_t key) const {
+  return (modifiers & ~LSHIFT) == 0 && key < 128 && (_capsLockKeys[key / 32] >> (key % 32)) & 1;
+}
+
+// Modifiers to send so that the host, applying CapsLock itself, gets the
+// character the keymap describes
+uint8_t BleKeyboard::capsLockModifiers(uint8_t modifiers, uint8_t key, bool capsLock) const {
+  if (capsLock && _capsLockMode == CapsLockMode::Compensate && isCapsLockKey(modifiers, key)) {
+    return modifiers ^ LSHIFT;
+  }
+  return modifiers;
+}
+
+// The typing settings change between calls, after the text already queued,
+// never under a text being typed
+void BleKeyboard::setCapsLockMode(CapsLockMode mode) {
+  afterQueuedText([&] {
+    this->_capsLockMode = mode;
+    return size_t(0);
+  });
+}
+
+uint8_t BleKeyboard::getLedState(void) const {
+  const Host* host = firstTarget();
+  return host != nullptr ? host->ledState.load() : 0;
+}
+
+uint8_t BleKeyboard::getLedState(uint16_t connHandle) const {
+  const Host* host = connHandle != BLE_HS_CONN_HANDLE_NONE ? findHost(connHandle) : nullptr;
+  return host != nullptr ? host->ledState.load() : 0;
+}
+
+bool BleKeyboard::isCapsLockOn(void) const {
+  return (getLedState() & LED_CAPS_LOCK) != 0;
+}
+
+void BleKeyboard::setTaskPlacement(const TaskPlacement& placement) {
+  this->_taskPlacement = placement;
+}
+
+TaskPlacement BleKeyboard::getTaskPlacement(void) const {
+  return this->_taskPlacement;
+}
+
 void BleKeyboard::setDelay(uint32_t ms) {
-  this->_delay = ms;
+  afterQueuedText([&] {
+    this->_delay = ms;
+    return size_t(0);
+  });
+}
+
+uint32_t BleKeyboard::getDelay(void) const {
+  return this->_delay;
+}
+
+void BleKeyboard::setAdaptiveRate(bool enabled) {
+  afterQueuedText([&] {
+    this->_adaptiveRate = enabled;
+    this->_charsSinceProbe = 0;
+    return size_t(0);
+  });
+}
+
+void BleKeyboard::setTypingMode(TypingMode mode) {
+  afterQueuedText([&] {
+    this->_typingMode = mode;
+    return size_t(0);
+  });
+}
+
+void BleKeyboard::setReportMode(ReportMode mode) {
+  this->_reportMode = mode;
+}
+
+ReportMode BleKeyboard::getReportMode(void) const {
+  return this->_reportMode;
+}
+
+void BleKeyboard::setLayout(const KeyboardLayout& layout) {
+  afterQueuedText([&] {
+    this->_layout = &layout;
+    updateCapsLockKeys();
+    return size_t(0);
+  });
+}
+
+const KeyboardLayout& BleKeyboard::getLayout(void) const {
+  return *this->_layout;
 }
 
 void BleKeyboard::debug(uint8_t usage_id, uint8_t modifiers)
 {
   if (this->isConnected())
   {
-    // Prepare the key report
-    _keyReport.modifiers = modifiers;
-    _keyReport.keys[0] = usage_id;
+    afterQueuedText([&] {
+      // Prepare the key report
+      _keyReport.modifiers = modifiers;
+      _keyReport.keys[0] = usage_id;
 
-    // Send the key press
-    sendReport(&_keyReport);
-    vTaskDelay(10); // A small delay
+      // Send the key press
+      sendReport(&_keyReport);
 
-    // Release the key
-    releaseAll();
+      // Release the key
+      releaseAllKeys();
+      return size_t(1);
+    });
   }
 }
-
-size_t BleKeyboard::pressRaw(uint8_t usage_id, uint8_t modifiers) {
-    _keyReport.modifiers = modifiers;
-    if (usage_id != 0 && !addKeyToReport(usage_id)) {
-        return 0; // Report full
-    }
-    sendReport(&_keyReport);
-    return 1;
-}
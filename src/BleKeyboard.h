@@ -10,6 +10,161 @@
 #include <NimBLECharacteristic.h>
 #include <NimBLEHIDDevice.h>
 #include <Print.h>
+#include "KeyboardLayout.h"
+#include "Utf8Decoder.h"
+#include "MpscQueue.h"
+#include "KeyMacro.h"
+#include <atomic>
+#include <type_traits>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/stream_buffer.h>
+#include <freertos/semphr.h>
+#include "esp_timer.h"
+
+// Connection interval assumed until the host reports one, in units of 1.25 ms
+#ifndef BLE_KEYBOARD_DEFAULT_CONN_INTERVAL
+#define BLE_KEYBOARD_DEFAULT_CONN_INTERVAL 12
+#endif
+
+// Hosts served at once. NimBLE must allow as many connections
+// (CONFIG_BT_NIMBLE_MAX_CONNECTIONS); centrals beyond this are turned away.
+#ifndef BLE_KEYBOARD_MAX_HOSTS
+#define BLE_KEYBOARD_MAX_HOSTS 3
+#endif
+
+// Reports waiting for the stack, per host; write() only blocks once this many are pending
+#ifndef BLE_KEYBOARD_REPORT_QUEUE_SIZE
+#define BLE_KEYBOARD_REPORT_QUEUE_SIZE 16
+#endif
+
+// Stop handing notifications to NimBLE when fewer mbufs than this are free
+#ifndef BLE_KEYBOARD_MIN_FREE_MBUFS
+#define BLE_KEYBOARD_MIN_FREE_MBUFS 4
+#endif
+
+// write() waits at most this long for the hosts whose report queue is full, all
+// together; those still full then lose their oldest reports until they catch up
+#ifndef BLE_KEYBOARD_HOST_STALL_MS
+#define BLE_KEYBOARD_HOST_STALL_MS 200
+#endif
+
+// Reports typed while no host is connected, replayed to the next host to connect
+#ifndef BLE_KEYBOARD_BACKLOG_SIZE
+#define BLE_KEYBOARD_BACKLOG_SIZE 64
+#endif
+
+// Reconnection: directed advertising to up to this many bonded hosts, the last
+// one first, then a burst of fast advertising, then slow advertising until a
+// host connects. Intervals are in units of 0.625 ms.
+#ifndef BLE_KEYBOARD_DIRECTED_ADV_PEERS
+#define BLE_KEYBOARD_DIRECTED_ADV_PEERS 2
+#endif
+
+#ifndef BLE_KEYBOARD_DIRECTED_ADV_MS
+#define BLE_KEYBOARD_DIRECTED_ADV_MS 1280
+#endif
+
+#ifndef BLE_KEYBOARD_FAST_ADV_MS
+#define BLE_KEYBOARD_FAST_ADV_MS 30000
+#endif
+
+#ifndef BLE_KEYBOARD_FAST_ADV_INTERVAL
+#define BLE_KEYBOARD_FAST_ADV_INTERVAL 48 // 30 ms
+#endif
+
+#ifndef BLE_KEYBOARD_SLOW_ADV_INTERVAL
+#define BLE_KEYBOARD_SLOW_ADV_INTERVAL 1636 // 1022.5 ms
+#endif
+
+// Connection parameters requested while there is something to type, and after
+// BLE_KEYBOARD_IDLE_MS with nothing to type, see setConnectionPolicy().
+// Intervals are in units of 1.25 ms, the supervision timeout in units of 10 ms.
+#ifndef BLE_KEYBOARD_ACTIVE_MIN_INTERVAL
+#define BLE_KEYBOARD_ACTIVE_MIN_INTERVAL 9 // 11.25 ms
+#endif
+
+#ifndef BLE_KEYBOARD_ACTIVE_MAX_INTERVAL
+#define BLE_KEYBOARD_ACTIVE_MAX_INTERVAL 12 // 15 ms
+#endif
+
+#ifndef BLE_KEYBOARD_IDLE_MIN_INTERVAL
+#define BLE_KEYBOARD_IDLE_MIN_INTERVAL 48 // 60 ms
+#endif
+
+#ifndef BLE_KEYBOARD_IDLE_MAX_INTERVAL
+#define BLE_KEYBOARD_IDLE_MAX_INTERVAL 60 // 75 ms
+#endif
+
+#ifndef BLE_KEYBOARD_IDLE_LATENCY
+#define BLE_KEYBOARD_IDLE_LATENCY 4
+#endif
+
+#ifndef BLE_KEYBOARD_SUPERVISION_TIMEOUT
+#define BLE_KEYBOARD_SUPERVISION_TIMEOUT 400 // 4 s
+#endif
+
+#ifndef BLE_KEYBOARD_IDLE_MS
+#define BLE_KEYBOARD_IDLE_MS 5000
+#endif
+
+// The adaptive rate controller (setAdaptiveRate()) checks the host round trip
+// every this many characters, waits this long for the echo, and never sets a
+// typing delay above the maximum (ms)
+#ifndef BLE_KEYBOARD_ADAPTIVE_PROBE_CHARS
+#define BLE_KEYBOARD_ADAPTIVE_PROBE_CHARS 64
+#endif
+
+#ifndef BLE_KEYBOARD_ADAPTIVE_TIMEOUT_MS
+#define BLE_KEYBOARD_ADAPTIVE_TIMEOUT_MS 250
+#endif
+
+#ifndef BLE_KEYBOARD_ADAPTIVE_MAX_DELAY
+#define BLE_KEYBOARD_ADAPTIVE_MAX_DELAY 20
+#endif
+
+// Per-character latency histogram: width of the first bucket, bucket count
+#ifndef BLE_KEYBOARD_LATENCY_BUCKET_US
+#define BLE_KEYBOARD_LATENCY_BUCKET_US 250
+#endif
+
+#ifndef BLE_KEYBOARD_LATENCY_BUCKETS
+#define BLE_KEYBOARD_LATENCY_BUCKETS 10
+#endif
+
+// Report trace: the last this many reports queued, sent, refused or dropped,
+// kept in RAM for dumpTrace(), 16 bytes each. 0 leaves the trace out.
+#ifndef BLE_KEYBOARD_TRACE_SIZE
+#define BLE_KEYBOARD_TRACE_SIZE 0
+#endif
+
+// Define to count heap allocations in KeyboardMetrics::heapAllocations, e.g. to
+// check in a test build that typing allocates nothing. With CONFIG_HEAP_USE_HOOKS
+// every allocation is counted, otherwise only C++ ones (operator new).
+// #define BLE_KEYBOARD_COUNT_ALLOCATIONS
+
+// Vendor service exposing KeyboardMetrics, see enableMetricsService()
+#define BLE_KEYBOARD_METRICS_SERVICE_UUID "6c1a0001-3f4e-4d8b-9a52-8e0f2b7d4c31"
+#define BLE_KEYBOARD_METRICS_CHAR_UUID    "6c1a0002-3f4e-4d8b-9a52-8e0f2b7d4c31"
+
+#ifndef BLE_KEYBOARD_ASYNC_BUFFER_SIZE
+#define BLE_KEYBOARD_ASYNC_BUFFER_SIZE 1024
+#endif
+
+// Core and priority of the library's tasks (async typing, macros, StreamPump),
+// see setTaskPlacement(). By default they run next to the NimBLE host task,
+// below its priority and above the Arduino loop.
+#ifndef BLE_KEYBOARD_TASK_CORE
+#ifdef CONFIG_BT_NIMBLE_PINNED_TO_CORE
+#define BLE_KEYBOARD_TASK_CORE CONFIG_BT_NIMBLE_PINNED_TO_CORE
+#else
+#define BLE_KEYBOARD_TASK_CORE tskNO_AFFINITY
+#endif
+#endif
+
+#ifndef BLE_KEYBOARD_TASK_PRIORITY
+#define BLE_KEYBOARD_TASK_PRIORITY 5
+#endif
 
 
 enum class ModifierKey : uint8_t {
@@ -39,6 +194,7 @@ enum class SpecialKey : uint8_t {
     Home       = 0x4A,
     End        = 0x4D,
     CapsLock   = 0x39,
+    ScrollLock = 0x47,
     F1         = 0x3A,
     F2         = 0x3B,
     F3         = 0x3C,
@@ -74,6 +230,354 @@ typedef struct
   uint8_t keys[6];
 } KeyReport;
 
+// NKRO key report: one bit per key usage 0x00-0x7F, so any number of keys can
+// be held and usages above 0x65 (F13-F24) can be sent
+#define NKRO_KEY_COUNT 128
+
+typedef struct
+{
+  uint8_t modifiers;
+  uint8_t keys[NKRO_KEY_COUNT / 8];
+} NkroReport;
+
+enum class ReportMode : uint8_t {
+    Boot, // 6-key array, understood by BIOS and boot-protocol hosts
+    Nkro  // Key bitmap, no limit on simultaneous keys
+};
+
+// Host LED state, from the keyboard output report
+#define LED_NUM_LOCK    0x01
+#define LED_CAPS_LOCK   0x02
+#define LED_SCROLL_LOCK 0x04
+#define LED_COMPOSE     0x08
+#define LED_KANA        0x10
+
+enum class CapsLockMode : uint8_t {
+    Ignore,    // Type as if CapsLock were off
+    Compensate // Flip Shift on the keys CapsLock affects while the host has it on
+};
+
+enum class TypingMode : uint8_t {
+    Classic,  // Press and release every key, one character at a time
+    Rollover  // Overlap consecutive keys and send only the reports that change
+};
+
+enum class LinkProfile : uint8_t {
+    Idle,  // Long interval with peripheral latency, to save power
+    Active // Short interval and no latency, while there is something to type
+};
+
+// Connection parameters requested from every host for each profile. Intervals
+// are in units of 1.25 ms, the supervision timeout in units of 10 ms, and it
+// must be longer than (1 + latency) * maxInterval * 2.
+struct ConnectionPolicy
+{
+  uint16_t activeMinInterval = BLE_KEYBOARD_ACTIVE_MIN_INTERVAL;
+  uint16_t activeMaxInterval = BLE_KEYBOARD_ACTIVE_MAX_INTERVAL;
+  uint16_t activeLatency = 0;
+  uint16_t idleMinInterval = BLE_KEYBOARD_IDLE_MIN_INTERVAL;
+  uint16_t idleMaxInterval = BLE_KEYBOARD_IDLE_MAX_INTERVAL;
+  uint16_t idleLatency = BLE_KEYBOARD_IDLE_LATENCY;
+  uint16_t supervisionTimeout = BLE_KEYBOARD_SUPERVISION_TIMEOUT;
+  uint32_t idleMs = BLE_KEYBOARD_IDLE_MS; // 0 leaves the parameters to the hosts
+};
+
+// Where the library's tasks run. core is 0, 1 or tskNO_AFFINITY.
+struct TaskPlacement
+{
+  BaseType_t core = BLE_KEYBOARD_TASK_CORE;
+  UBaseType_t priority = BLE_KEYBOARD_TASK_PRIORITY;
+};
+
+enum class MacroState : uint8_t {
+    Idle,     // No macro played yet
+    Playing,
+    Done,
+    Stopped,  // By stopMacro()
+    TimedOut  // A WaitLed step did not see the LED state in time
+};
+
+// How a character is produced by the keymap
+enum class KeyCategory : uint8_t {
+    Direct,      // Single key, no modifier
+    Shift,       // Single key with Shift
+    AltGr,       // Single key with AltGr
+    DeadKey,     // Dead key followed by a base key
+    Substituted, // Approximated by similar looking characters
+    Unmapped
+};
+
+// Counters since start-up or resetMetrics(). The metrics characteristic returns
+// this struct as is, little-endian.
+typedef struct
+{
+  uint64_t blockedMicros;      // Time spent in typing delays and waiting for room in the report queue
+  uint32_t reportsSent;        // Notifications accepted by NimBLE
+  uint32_t reportsFailed;      // notify() calls refused for lack of buffers, retried later
+  uint32_t reportsDropped;     // Queued reports discarded on disconnect or by a lagging host
+  uint32_t charactersTyped;
+  uint32_t charactersUnmapped; // Not in the current layout
+  uint32_t keysDropped;        // Key report full (the setWriteError() paths)
+  uint32_t queueDepth;         // Reports waiting right now, all hosts
+  uint32_t queueHighWater;     // Deepest queue of any single host
+  // Time to type one character, from its first report to its last. Bucket 0 is
+  // under BLE_KEYBOARD_LATENCY_BUCKET_US, each next one twice as wide, the last open-ended.
+  uint32_t latency[BLE_KEYBOARD_LATENCY_BUCKETS];
+  // Last reconnection, timed from losing the last host (or from begin())
+  uint32_t connectMicros;      // Until a host connected
+  uint32_t firstReportMicros;  // Until its first report went out
+  uint32_t reportsReplayed;    // Typed while no host was connected, sent on reconnection
+  uint32_t heapAllocations;    // Any task; 0 unless built with BLE_KEYBOARD_COUNT_ALLOCATIONS
+  // flush(timeout): from a ScrollLock report leaving to its LED echo from every targeted host
+  uint32_t roundTrips;
+  uint32_t roundTripMicros;    // Last one
+  uint32_t flushTimeouts;      // Echo not seen in time
+  // Typing delay: time each report is held, from one paced report to the next,
+  // against the delay set. Reports that had to wait for the queue are not counted.
+  uint32_t holds;
+  uint32_t holdJitterMicros;   // Total of the differences, divide by holds for the mean
+  uint32_t holdJitterMaxMicros;
+} KeyboardMetrics;
+
+enum class TraceEvent : uint8_t {
+    Queued,  // Accepted by sendReport() for this host, or for the backlog
+    Sent,    // Taken by NimBLE
+    Refused, // notify() failed, retried later
+    Dropped  // Lost to a lagging host, a full backlog or a disconnect
+};
+
+// One report in the trace. dumpTrace() writes a 16-byte header (magic "BKTR",
+// version, entry size, entry count, entries lost) and then the entries, oldest
+// first, little-endian. tools/tracereplay.py reads it.
+typedef struct
+{
+  uint32_t micros;     // esp_timer_get_time(), low 32 bits
+  uint16_t connHandle; // BLE_HS_CONN_HANDLE_NONE while no host was connected
+  uint8_t event;       // TraceEvent
+  uint8_t reserved;
+  KeyReport report;    // NKRO reports as their first 6 keys
+} TraceEntry;
+
+#define BLE_KEYBOARD_TRACE_MAGIC   0x52544B42 // "BKTR"
+#define BLE_KEYBOARD_TRACE_VERSION 1
+
+// Plans the report stream for a run of keystrokes with key rollover: the next
+// key goes down while the previous one is still held, modifiers change in the
+// same report as the key that needs them, a key is only released early when it
+// has to be pressed again, and reports identical to the last one are skipped.
+class KeyReportPlanner
+{
+public:
+  constexpr KeyReportPlanner() : _report{0, 0, {0, 0, 0, 0, 0, 0}}, _sent{0, 0, {0, 0, 0, 0, 0, 0}}, _previous(0) {}
+
+  // Types one keystroke, calling emit(const KeyReport&) for every report to send.
+  template <typename Emit>
+  constexpr void stroke(uint8_t modifiers, uint8_t key, Emit&& emit)
+  {
+    if (key == 0) {
+      return;
+    }
+    if (hasKey(key)) {
+      // Still held from the previous keystroke: it has to go up first
+      clearKeys();
+      emitIfChanged(emit);
+    }
+    for (int i = 0; i < 6; i++) {
+      if (_report.keys[i] != _previous) {
+        _report.keys[i] = 0; // Only the previous key stays down
+      }
+    }
+    _report.modifiers = modifiers;
+    for (int i = 0; i < 6; i++) {
+      if (_report.keys[i] == 0) {
+        _report.keys[i] = key;
+        break;
+      }
+    }
+    _previous = key;
+    emitIfChanged(emit);
+  }
+
+  // Releases every key and modifier.
+  template <typename Emit>
+  constexpr void finish(Emit&& emit)
+  {
+    _report.modifiers = 0;
+    clearKeys();
+    _previous = 0;
+    emitIfChanged(emit);
+  }
+
+private:
+  constexpr bool hasKey(uint8_t key) const
+  {
+    for (int i = 0; i < 6; i++) {
+      if (_report.keys[i] == key) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  constexpr void clearKeys()
+  {
+    for (int i = 0; i < 6; i++) {
+      _report.keys[i] = 0;
+    }
+  }
+
+  template <typename Emit>
+  constexpr void emitIfChanged(Emit&& emit)
+  {
+    bool changed = _report.modifiers != _sent.modifiers;
+    for (int i = 0; i < 6; i++) {
+      changed = changed || _report.keys[i] != _sent.keys[i];
+    }
+    if (changed) {
+      _sent = _report;
+      emit(_report);
+    }
+  }
+
+  KeyReport _report;
+  KeyReport _sent;
+  uint8_t _previous;
+};
+
+// One report of a compiled text. Both the classic and the rollover report
+// streams hold at most two keys at a time, so three bytes are enough.
+typedef struct
+{
+  uint8_t modifiers;
+  uint8_t keys[2];
+} CompactKeyReport;
+
+// Text compiled into its report stream. Replaying it with BleKeyboard::send()
+// skips UTF-8 decoding and keymap lookups entirely.
+template <size_t N>
+struct CompiledText
+{
+  size_t count;
+  CompactKeyReport reports[N > 0 ? N : 1];
+};
+
+// Runs the report stream of a NUL-terminated UTF-8 string through emit(const
+// CompactKeyReport&). Unmapped characters are skipped, as they are by write().
+template <typename Emit>
+constexpr void compileReports(const KeyboardLayout& layout, const char* text, TypingMode mode, Emit&& emit)
+{
+  auto compact = [&emit](const KeyReport& report) {
+    emit(CompactKeyReport{report.modifiers, {report.keys[0], report.keys[1]}});
+  };
+  KeyReportPlanner planner;
+  Utf8Decoder decoder;
+  for (; *text != 0; text++) {
+    uint32_t unicode = 0;
+    if (!decoder.push(static_cast<uint8_t>(*text), unicode)) {
+      continue;
+    }
+    const KeymapEntry* entry = layout.find(unicode);
+    if (entry == nullptr) {
+      continue;
+    }
+    const KeyPressSequence& seq = entry->sequence;
+    if (mode == TypingMode::Rollover) {
+      planner.stroke(seq.modifiers1, seq.key1, compact);
+      planner.stroke(seq.modifiers2, seq.key2, compact);
+    } else {
+      // Same reports as typing the character in classic mode
+      emit(CompactKeyReport{seq.modifiers1, {seq.key1, 0}});
+      emit(CompactKeyReport{0, {0, 0}});
+      if (seq.key2 != 0) {
+        emit(CompactKeyReport{seq.modifiers2, {seq.key2, 0}});
+        emit(CompactKeyReport{0, {0, 0}});
+      }
+    }
+  }
+  if (mode == TypingMode::Rollover) {
+    planner.finish(compact);
+  }
+}
+
+// Number of reports compileText() produces for a string
+constexpr size_t compiledTextSize(const KeyboardLayout& layout, const char* text, TypingMode mode = TypingMode::Rollover)
+{
+  size_t count = 0;
+  compileReports(layout, text, mode, [&count](const CompactKeyReport&) { count++; });
+  return count;
+}
+
+// Compile-time form, sized with compiledTextSize(); see BLE_KEYBOARD_COMPILE_TEXT
+template <size_t N>
+constexpr CompiledText<N> compileText(const KeyboardLayout& layout, const char* text, TypingMode mode = TypingMode::Rollover)
+{
+  CompiledText<N> compiled{};
+  compileReports(layout, text, mode, [&compiled](const CompactKeyReport& report) {
+    if (compiled.count < N) {
+      compiled.reports[compiled.count] = report;
+    }
+    compiled.count++;
+  });
+  return compiled;
+}
+
+// Run-time form: fills a caller-owned buffer and returns the number of reports
+// the text needs. Only the first capacity reports are stored, so a result
+// larger than capacity means the buffer was too small.
+inline size_t compileText(const KeyboardLayout& layout, const char* text, CompactKeyReport* reports, size_t capacity,
+                          TypingMode mode = TypingMode::Rollover)
+{
+  size_t count = 0;
+  compileReports(layout, text, mode, [&](const CompactKeyReport& report) {
+    if (count < capacity) {
+      reports[count] = report;
+    }
+    count++;
+  });
+  return count;
+}
+
+// Compiles a string literal into flash, e.g.
+//   static constexpr auto prompt = BLE_KEYBOARD_COMPILE_TEXT(LayoutFrAzerty, "ssh admin@");
+#define BLE_KEYBOARD_COMPILE_TEXT(layout, text) compileText<compiledTextSize(layout, text)>(layout, text)
+
+// Runs calls from any number of tasks one at a time and in order, without a
+// lock: each call is pushed on a lock-free queue, and a caller that finds no
+// call running executes the queued calls up to its own (flat combining). The
+// others wait on a semaphore of their own until theirs has run. A call made
+// from within a running call runs at once.
+class SerialExecutor
+{
+public:
+  template <typename F>
+  size_t run(F&& f)
+  {
+    using Function = typename std::remove_reference<F>::type;
+    Call call;
+    call.run = [](void* context) -> size_t { return (*static_cast<Function*>(context))(); };
+    call.context = &f;
+    return execute(call);
+  }
+
+  bool isRunning(void) const; // True in the task executing calls
+
+private:
+  struct Call : MpscNode {
+    size_t (*run)(void* context);
+    void* context;
+    size_t result;
+    SemaphoreHandle_t ran; // Given by the task that ran the call, if not its caller
+    StaticSemaphore_t ranBuffer;
+    std::atomic<bool> done{false};
+  };
+
+  size_t execute(Call& call);
+
+  MpscQueue _queue;
+  std::atomic<bool> _busy{false};
+  std::atomic<TaskHandle_t> _executor{nullptr};
+};
+
 class BleKeyboard : public Print, NimBLEServerCallbacks, NimBLECharacteristicCallbacks
 {
 public:
@@ -83,56 +587,316 @@ public:
   BleKeyboard(std::string deviceName = "ESP32 Keyboard", std::string deviceManufacturer = "DIY", uint8_t batteryLevel = 100);
   void begin(void);
   void end(void);
-  void sendReport(KeyReport* keys);
-  
-  size_t press(uint8_t k); // For UNICODE characters
+  virtual void sendReport(KeyReport* keys); // Not serialized, see below
+  virtual void sendReport(NkroReport* keys);
+
+  // The calls below may be made from several tasks at once: each one runs as
+  // a whole, and a write() is never interleaved with another task's keys. In
+  // asynchronous mode, press() and the other raw key calls first wait for the
+  // text already queued by write(), and so do the setters of the delay, typing
+  // mode, CapsLock mode, adaptive rate and layout.
+  size_t press(char32_t k); // For UNICODE characters
   size_t press(ModifierKey k);
   size_t press(SpecialKey k);
   size_t tap(SpecialKey k);
   
-  size_t release(uint8_t k); // For UNICODE characters
+  size_t release(char32_t k); // For UNICODE characters
   size_t release(ModifierKey k);
   size_t release(SpecialKey k);
   
   void setDelay(uint32_t ms);
+  uint32_t getDelay(void) const;
+  void setAdaptiveRate(bool enabled); // Tunes the delay from host round trips, see README
+  void setTypingMode(TypingMode mode);
+  void setCapsLockMode(CapsLockMode mode);
+  uint8_t getLedState(void) const; // Of the first targeted host
+  uint8_t getLedState(uint16_t connHandle) const;
+  bool isCapsLockOn(void) const;
+  void setReportMode(ReportMode mode); // Before begin()
+  ReportMode getReportMode(void) const;
+  void setLayout(const KeyboardLayout& layout);
+  const KeyboardLayout& getLayout(void) const;
+  uint32_t getReportInterval(void) const; // Longest among the targeted hosts
   void releaseAll(void);
-  bool isConnected(void) const;
+  bool isConnected(void) const; // At least one host
+  bool isSubscribed(void) const; // At least one host has enabled input reports
+  size_t getHosts(uint16_t* connHandles, size_t max) const; // Returns the number of connected hosts
+  bool targetHost(uint16_t connHandle);
+  size_t targetHosts(const uint16_t* connHandles, size_t count);
+  void targetAllHosts(void); // The default, includes hosts connecting later
   void setBatteryLevel(uint8_t level);
+  void setConnectionPolicy(const ConnectionPolicy& policy);
+  ConnectionPolicy getConnectionPolicy(void) const;
+  LinkProfile getLinkProfile(void) const; // Last profile requested from the hosts
   void onConnect(Callback cb);
   void onDisconnect(Callback cb);
+  void onTypingComplete(Callback cb);
+
+  // Key macros (see KeyMacro.h), played one at a time on their own task. The
+  // macro must stay valid until it has finished.
+  bool playMacro(const uint8_t* macro, size_t size);
+  template <size_t N>
+  bool playMacro(const uint8_t (&macro)[N]) { return playMacro(macro, N); }
+  void stopMacro(void); // Releases every key
+  MacroState getMacroState(void) const;
+  void onMacroComplete(Callback cb);
   void debug(uint8_t usage_id, uint8_t modifiers = 0);
+  size_t send(const CompactKeyReport* reports, size_t count);
+  template <size_t N>
+  size_t send(const CompiledText<N>& compiled) { return send(compiled.reports, compiled.count); }
+  KeyCategory classifyCharacter(char32_t c) const;
+  KeyboardMetrics getMetrics(void) const;
+  void resetMetrics(void);
+  void enableMetricsService(void); // Before begin()
+  size_t dumpTrace(Print& out); // Returns the bytes written, see BLE_KEYBOARD_TRACE_SIZE
+  void clearTrace(void);
   
   virtual size_t write(uint8_t c) override;
   virtual size_t write(const uint8_t *buffer, size_t size) override;
 
+  // Asynchronous typing: write() queues text and returns immediately
+  bool beginAsync(size_t bufferSize = BLE_KEYBOARD_ASYNC_BUFFER_SIZE);
+  void endAsync(void);
+  bool isAsync(void) const;
+  size_t pendingText(void) const; // Bytes queued by write() and not typed yet
+  virtual int availableForWrite(void) override;
+  virtual void flush(void) override;
+  bool flush(uint32_t timeoutMs); // Until the hosts have processed every report, see README
+  void setTaskPlacement(const TaskPlacement& placement); // Applies to tasks started afterwards
+  TaskPlacement getTaskPlacement(void) const;
+
 protected:
   void onConnect(NimBLEServer* pServer, NimBLEConnInfo& connInfo) override;
   void onDisconnect(NimBLEServer* pServer, NimBLEConnInfo& connInfo, int reason) override;
+  void onConnParamsUpdate(NimBLEConnInfo& connInfo) override;
   virtual void onWrite(NimBLECharacteristic* pCharacteristic, NimBLEConnInfo& connInfo) override;
+  virtual void onRead(NimBLECharacteristic* pCharacteristic, NimBLEConnInfo& connInfo) override;
+  virtual void onStatus(NimBLECharacteristic* pCharacteristic, int code) override;
+  virtual void onSubscribe(NimBLECharacteristic* pCharacteristic, NimBLEConnInfo& connInfo, uint16_t subValue) override;
+  // Called after each character of a write() has been handed to the report path
+  virtual void characterTyped(uint32_t unicode_char);
+  // Called for every report queued for a host, or for the offline backlog,
+  // whichever call made it; NKRO reports as their first six keys
+  virtual void reportQueued(uint16_t connHandle, const KeyReport& report);
   // void writeSequence(uint8_t c); // NEW
 
 protected:
   NimBLEHIDDevice*      hid;
   NimBLECharacteristic* inputKeyboard;
   NimBLECharacteristic* outputKeyboard;
-  KeyReport _keyReport;
+  KeyReport _keyReport;   // Report being built by the typing paths
+  NkroReport _nkroReport;
 
   uint8_t batteryLevel;
   std::string deviceManufacturer;
   std::string deviceName;
-  bool connected = false;
 
   Callback connectCallback    = nullptr;
   Callback disconnectCallback = nullptr;
+  Callback typingCompleteCallback = nullptr;
+  Callback macroCompleteCallback = nullptr;
   
 private:
-  uint32_t _delay = 50;
+  uint32_t _delay = 0;
+  bool _adaptiveRate = false;
+  size_t _charsSinceProbe = 0;
+  uint32_t _roundTripBest = 0; // Shortest round trip seen, 0 until a host has echoed
+  TypingMode _typingMode = TypingMode::Classic;
+  ReportMode _reportMode = ReportMode::Boot;
+  CapsLockMode _capsLockMode = CapsLockMode::Compensate;
+  uint32_t _capsLockKeys[4]; // Key usages CapsLock applies to in the current layout
+  const KeyboardLayout* _layout;
+  Utf8Decoder _decoder;
+
+  struct QueuedReport {
+    uint8_t data[sizeof(NkroReport)];
+    uint8_t length;
+  };
+
+  // A connected central, with its own key state, report queue and link
+  // parameters. A free slot has no connection handle.
+  struct Host {
+    uint16_t connHandle = BLE_HS_CONN_HANDLE_NONE;
+    KeyReport keyReport = {};
+    NkroReport nkroReport = {};
+    QueuedReport queue[BLE_KEYBOARD_REPORT_QUEUE_SIZE] = {};
+    size_t queueHead = 0;
+    size_t queueCount = 0;
+    bool lagging = false; // Queue was full, oldest reports are dropped until it drains
+    bool subscribed = false; // Reports are held back until the host enables notifications
+    NimBLEAddress address; // Identity address
+    uint16_t connInterval = 0;
+    uint16_t connLatency = 0;
+    LinkProfile linkProfile = LinkProfile::Idle; // Last requested from this host
+    std::atomic<uint8_t> ledState{0};
+    uint32_t scrollLockTaps = 0; // Sent by flush(timeout)
+    std::atomic<uint32_t> scrollLockEchoes{0}; // ScrollLock changes in the host's LED reports
+    // Text is typed for each host with its own CapsLock state
+    KeyReportPlanner planner;
+    KeyReport planned[4] = {}; // This host's reports for the character being typed
+    uint8_t plannedCount = 0;
+    bool typingCapsLock = false; // Assumed by the text being typed
+  };
+  static_assert(BLE_KEYBOARD_MAX_HOSTS <= 32, "hosts are tracked in a 32-bit mask");
+
+  Host _hosts[BLE_KEYBOARD_MAX_HOSTS];
+  std::atomic<uint32_t> _targets{0}; // Bit i set: _hosts[i] receives reports
+  bool _targetAll = true;
+
+  // Key state and reports while no host is connected. The backlog is then
+  // replayed to the host that left when it reconnects; until it is empty, that
+  // host's new reports are appended to it so they keep their order, waiting for
+  // room once it is full as they would for the host's own queue.
+  Host _offline;
+  QueuedReport _backlog[BLE_KEYBOARD_BACKLOG_SIZE];
+  size_t _backlogHead = 0;
+  size_t _backlogCount = 0;
+  Host* _replayHost = nullptr;
+  std::atomic<bool> _pumping{false}; // A pumpReports() pass is running
+  std::atomic<bool> _pumpAgain{false};
+  esp_timer_handle_t _pumpTimer = nullptr; // Retries while the mbuf pool is low
+  SemaphoreHandle_t _reportLock = nullptr;
+  SemaphoreHandle_t _reportSent = nullptr;
+  SemaphoreHandle_t _ledChanged = nullptr; // Given by onWrite()
+
+  enum class AdvertisingPhase : uint8_t { Directed, Fast, Slow };
+  AdvertisingPhase _advPhase = AdvertisingPhase::Slow;
+  size_t _directedPeer = 0;
+  NimBLEAddress _lastHost; // Identity of the last host to disconnect
+  bool _lastHostBonded = false;
+  static BleKeyboard* _gapInstance; // Receives advertising timeouts
+  int64_t _offlineSince = 0;
+  bool _awaitingFirstReport = false;
+
+  ConnectionPolicy _connectionPolicy;
+  std::atomic<LinkProfile> _linkProfile{LinkProfile::Idle};
+  std::atomic<int64_t> _lastActivity{0};
+  SemaphoreHandle_t _linkLock = nullptr;
+  esp_timer_handle_t _linkTimer = nullptr;
+
+  TaskPlacement _taskPlacement;
+  esp_timer_handle_t _edgeTimer = nullptr; // Wakes the typing task for its next report
+  SemaphoreHandle_t _edgeReached = nullptr;
+  int64_t _nextEdge = 0; // When the last paced report was due
+  int64_t _lastEdge = 0; // When it was sent
+
+  KeyboardMetrics _metrics = {};
+  uint32_t _heapAllocationsBase = 0; // Counter value at the last resetMetrics()
+#if BLE_KEYBOARD_TRACE_SIZE > 0
+  TraceEntry _trace[BLE_KEYBOARD_TRACE_SIZE];
+  size_t _traceHead = 0;
+  size_t _traceCount = 0;
+  uint32_t _traceLost = 0; // Overwritten, or not recorded while dumping
+  std::atomic<bool> _traceDumping{false};
+#endif
+  bool _metricsEnabled = false;
+  NimBLECharacteristic* _metricsCharacteristic = nullptr;
+
+  SerialExecutor _input;     // Everything that changes key state
+  SerialExecutor _textInput; // Writers to _asyncBuffer
+
+  StreamBufferHandle_t _asyncBuffer = nullptr;
+  size_t _asyncBufferSize = 0;
+  TaskHandle_t _asyncTask = nullptr;
+  std::atomic<bool> _asyncStop{false}; // Set by endAsync() for the typing task to end itself
+  SemaphoreHandle_t _asyncStopped = nullptr; // Given by the typing task as it ends
+  StaticSemaphore_t _asyncStoppedBuffer;
+  std::atomic<size_t> _asyncPending{0}; // Bytes accepted by write() and not typed yet
+
+  TaskHandle_t _macroTask = nullptr;
+  std::atomic<MacroState> _macroState{MacroState::Idle};
+  std::atomic<const uint8_t*> _macroPending{nullptr}; // First step of the macro to play next
+  std::atomic<bool> _macroStop{false};
   
-  bool addKeyToReport(uint8_t usage_id);
-  void removeKeyFromReport(uint8_t usage_id);
+  // With every host targeted and none connected, the offline state is the target
+  template <typename F>
+  void forEachTarget(F&& f)
+  {
+    uint32_t targets = _targets;
+    if (targets == 0 && _targetAll) {
+      f(_offline);
+      return;
+    }
+    for (size_t i = 0; i < BLE_KEYBOARD_MAX_HOSTS; i++) {
+      if ((targets >> i) & 1) {
+        f(_hosts[i]);
+      }
+    }
+  }
+
+  Host* findHost(uint16_t connHandle);
+  const Host* findHost(uint16_t connHandle) const;
+  const Host* firstTarget(void) const;
+  bool addKeyToReport(Host& host, uint8_t usage_id);
+  void removeKeyFromReport(Host& host, uint8_t usage_id);
+  void sendKeyState(void);
+  void setHostReport(Host& host, const KeyReport& report);
+  bool enqueueReport(Host& host, const uint8_t* data, size_t length);
+  void pumpReports(void);
+  void pumpPass(void);
+  void clearReportQueue(Host& host);
+  void backlogReport(const uint8_t* data, size_t length);
+  bool isBacklogOwner(const NimBLEAddress& address) const;
+  void dropBacklog(void);
+  void traceReport(TraceEvent event, uint16_t connHandle, const uint8_t* data, size_t length);
+  void startAdvertising(void);
+  void advertise(AdvertisingPhase phase);
+  static int gapEvent(struct ble_gap_event* event, void* arg);
+  void advertisingComplete(void);
+  bool directedPeer(size_t index, NimBLEAddress& peer) const;
+  void typingDelay(void);
+  bool hostBarrier(uint32_t timeoutMs);
+  bool drainReports(uint32_t hosts, int64_t deadline);
+  bool waitForEchoes(uint32_t hosts, int64_t deadline);
+  void adaptRate(void);
+  void updateCapsLockKeys(void);
+  bool isCapsLockKey(uint8_t modifiers, uint8_t key) const;
+  uint8_t capsLockModifiers(uint8_t modifiers, uint8_t key, bool capsLock) const;
+  void recordLatency(int64_t micros);
+  void updateConnectionParams(NimBLEConnInfo& connInfo);
+  void noteActivity(void);
+  void applyLinkProfile(LinkProfile profile, bool force);
+  void requestLinkProfile(Host& host, LinkProfile profile);
+  static void linkIdleTimer(void* arg);
+  static void edgeTimer(void* arg);
+  static void pumpTimer(void* arg);
+  void checkLinkIdle(void);
   
+  template <typename F>
+  size_t afterQueuedText(F&& f)
+  {
+    if (_asyncBuffer != nullptr && !_input.isRunning()) {
+      flush();
+    }
+    return _input.run(f);
+  }
+
+  size_t pressKey(char32_t k);
+  size_t pressKey(ModifierKey k);
+  size_t pressKey(SpecialKey k);
+  size_t releaseKey(char32_t k);
+  size_t releaseKey(ModifierKey k);
+  size_t releaseKey(SpecialKey k);
+  void releaseAllKeys(void);
+  size_t sendCompiled(const CompactKeyReport* reports, size_t count);
+  static void asyncTypingTask(void* arg);
+  void runAsyncTyping(void);
+  size_t queueText(const uint8_t *buffer, size_t size);
+  void typeQueuedText(size_t length);
+  size_t typeText(const uint8_t *buffer, size_t size);
+  void beginText(void);
+  size_t typeTextChunk(const uint8_t *buffer, size_t size);
+  void endText(void);
+  void finishRollover(void);
+  template <typename Plan>
+  void typeOnEachHost(bool paced, Plan&& plan);
+  static void macroTask(void* arg);
+  void runMacros(void);
+  MacroState runMacroSteps(const uint8_t* step);
+  bool macroWait(int64_t until);
+  void macroKeys(uint8_t modifiers, uint8_t usage_id, bool down);
   void typeUnicodeCharacter(uint32_t unicode_char);
-  size_t pressRaw(uint8_t usage_id, uint8_t modifiers);
+  void typeRolloverCharacter(uint32_t unicode_char);
   
 };
 
@@ -0,0 +1,66 @@
+#include "KeyMacro.h"
+
+#include "sdkconfig.h"
+
+#if defined(CONFIG_ARDUHAL_ESP_LOG)
+  #include "esp32-hal-log.h"
+  #define LOG_TAG ""
+#else
+  #include "esp_log.h"
+  static const char* LOG_TAG = "KeyMacro";
+#endif
+
+size_t keyMacroStepSize(const uint8_t* step, size_t remaining)
+{
+    if (remaining == 0) {
+        return 0;
+    }
+    size_t size;
+    switch (static_cast<KeyMacroOp>(step[0])) {
+    case KeyMacroOp::End:
+    case KeyMacroOp::ReleaseAll:
+        size = 1;
+        break;
+    case KeyMacroOp::Wait:
+    case KeyMacroOp::Press:
+    case KeyMacroOp::Release:
+    case KeyMacroOp::Chord:
+        size = 3;
+        break;
+    case KeyMacroOp::Hold:
+    case KeyMacroOp::WaitLed:
+        size = 5;
+        break;
+    case KeyMacroOp::Type:
+        size = remaining >= 2 ? 2 + step[1] : 2;
+        break;
+    default:
+        return 0;
+    }
+    return size <= remaining ? size : 0;
+}
+
+bool validateKeyMacro(const uint8_t* macro, size_t size)
+{
+    if (size < KEY_MACRO_HEADER_SIZE || macro[0] != KEY_MACRO_MAGIC0 || macro[1] != KEY_MACRO_MAGIC1) {
+        ESP_LOGE(LOG_TAG, "not a key macro");
+        return false;
+    }
+    if (macro[2] != KEY_MACRO_VERSION) {
+        ESP_LOGE(LOG_TAG, "unsupported key macro version %d", macro[2]);
+        return false;
+    }
+    for (size_t offset = KEY_MACRO_HEADER_SIZE; offset < size;) {
+        size_t step = keyMacroStepSize(macro + offset, size - offset);
+        if (step == 0) {
+            ESP_LOGE(LOG_TAG, "invalid key macro step at offset %u", (unsigned)offset);
+            return false;
+        }
+        if (static_cast<KeyMacroOp>(macro[offset]) == KeyMacroOp::End) {
+            return true;
+        }
+        offset += step;
+    }
+    ESP_LOGE(LOG_TAG, "key macro has no end");
+    return false;
+}
@@ -0,0 +1,39 @@
+#ifndef ESP32_BLE_KEYBOARD_KEY_MACRO_H
+#define ESP32_BLE_KEYBOARD_KEY_MACRO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Key macro bytecode, played by BleKeyboard::playMacro() on its own task so
+// the caller does not wait. tools/macroasm.py assembles macros from text and
+// checks them ahead of time.
+//
+// A macro is a 4-byte header ('K', 'M', version, 0) followed by steps: an
+// opcode byte and its operands, 16-bit values little-endian, up to an End
+// step. Modifiers are a KeyReport modifier mask, keys are HID usages, and a
+// key of 0 means modifiers only.
+#define KEY_MACRO_MAGIC0      'K'
+#define KEY_MACRO_MAGIC1      'M'
+#define KEY_MACRO_VERSION     1
+#define KEY_MACRO_HEADER_SIZE 4
+
+enum class KeyMacroOp : uint8_t {
+    End        = 0x00,
+    Press      = 0x01, // modifiers, key: pressed in the same report
+    Release    = 0x02, // modifiers, key
+    Chord      = 0x03, // modifiers, key: pressed, then released
+    Hold       = 0x04, // modifiers, key, ms: pressed, released ms later
+    Wait       = 0x05, // ms
+    Type       = 0x06, // length, UTF-8 text: typed like write(), with the current layout
+    WaitLed    = 0x07, // mask, value, timeout ms: until the LED state & mask is value; the macro stops on timeout
+    ReleaseAll = 0x08
+};
+
+// Size of the step at step, operands included, or 0 if it is not a valid step
+// or does not fit in the remaining bytes.
+size_t keyMacroStepSize(const uint8_t* step, size_t remaining);
+
+// Checks the header and that every step is valid, up to an End step within size.
+bool validateKeyMacro(const uint8_t* macro, size_t size);
+
+#endif // ESP32_BLE_KEYBOARD_KEY_MACRO_H
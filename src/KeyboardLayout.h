@@ -0,0 +1,208 @@
+#ifndef ESP32_BLE_KEYBOARD_LAYOUT_H
+#define ESP32_BLE_KEYBOARD_LAYOUT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Keyboard usage IDs, named after the key position on a US keyboard.
+// Layout tables map characters to these positions, so the AZERTY 'a' is KC_Q.
+#define KC_A 0x04
+#define KC_B 0x05
+#define KC_C 0x06
+#define KC_D 0x07
+#define KC_E 0x08
+#define KC_F 0x09
+#define KC_G 0x0A
+#define KC_H 0x0B
+#define KC_I 0x0C
+#define KC_J 0x0D
+#define KC_K 0x0E
+#define KC_L 0x0F
+#define KC_M 0x10
+#define KC_N 0x11
+#define KC_O 0x12
+#define KC_P 0x13
+#define KC_Q 0x14
+#define KC_R 0x15
+#define KC_S 0x16
+#define KC_T 0x17
+#define KC_U 0x18
+#define KC_V 0x19
+#define KC_W 0x1A
+#define KC_X 0x1B
+#define KC_Y 0x1C
+#define KC_Z 0x1D
+
+#define KC_1 0x1E
+#define KC_2 0x1F
+#define KC_3 0x20
+#define KC_4 0x21
+#define KC_5 0x22
+#define KC_6 0x23
+#define KC_7 0x24
+#define KC_8 0x25
+#define KC_9 0x26
+#define KC_0 0x27
+
+#define KC_RETURN 0x28
+#define KC_ESCAPE 0x29
+#define KC_BACKSPACE 0x2A
+#define KC_TAB 0x2B
+#define KC_SPACE 0x2C
+#define KC_MINUS 0x2D
+#define KC_EQUAL 0x2E
+#define KC_LEFT_BRACKET 0x2F
+#define KC_RIGHT_BRACKET 0x30
+#define KC_BACKSLASH 0x31
+#define KC_NON_US_HASH 0x32
+#define KC_SEMICOLON 0x33
+#define KC_QUOTE 0x34
+#define KC_GRAVE 0x35
+#define KC_COMMA 0x36
+#define KC_PERIOD 0x37
+#define KC_SLASH 0x38
+#define KC_NON_US_BACKSLASH 0x64
+
+#define LSHIFT 0x02 // ModifierKey::LeftShift
+#define ALT_GR 0x40 // ModifierKey::RightAlt
+
+typedef struct {
+    uint8_t modifiers1;
+    uint8_t key1;
+    uint8_t modifiers2;
+    uint8_t key2;
+} KeyPressSequence;
+
+typedef struct {
+    uint32_t unicode;
+    KeyPressSequence sequence;
+    uint8_t flags = 0;
+} KeymapEntry;
+
+#define KEYMAP_SUBSTITUTE 0x01 // Approximation of a character the layout cannot type
+
+// A dead key and the spacing accent it types when followed by a space
+typedef struct {
+    uint32_t accent;
+    uint8_t modifiers;
+    uint8_t key;
+} DeadKey;
+
+// Keymap lookup index, built at compile time next to the keymap it indexes:
+// a direct table for ASCII and an open-addressed hash table for the rest.
+#define KEYMAP_NONE 0xFFFF
+
+template <size_t HashSize>
+struct KeymapIndex {
+    uint16_t ascii[128];
+    uint16_t hash[HashSize];
+};
+
+constexpr uint32_t keymapHash(uint32_t unicode, uint8_t hashBits)
+{
+    return (unicode * 2654435761u) >> (32 - hashBits); // Fibonacci hashing
+}
+
+template <size_t N>
+constexpr bool keymapHasDuplicates(const KeymapEntry (&entries)[N])
+{
+    for (size_t i = 0; i < N; i++) {
+        for (size_t j = i + 1; j < N; j++) {
+            if (entries[i].unicode == entries[j].unicode) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+constexpr uint8_t keymapHashBits(size_t hashSize)
+{
+    uint8_t bits = 0;
+    while ((size_t(1) << bits) < hashSize) {
+        bits++;
+    }
+    return bits;
+}
+
+template <size_t HashSize, size_t N>
+constexpr KeymapIndex<HashSize> buildKeymapIndex(const KeymapEntry (&entries)[N])
+{
+    static_assert((HashSize & (HashSize - 1)) == 0, "hash size must be a power of two");
+    static_assert(N < HashSize && N < KEYMAP_NONE, "hash table too small for the keymap");
+
+    KeymapIndex<HashSize> index{};
+    for (size_t i = 0; i < 128; i++) {
+        index.ascii[i] = KEYMAP_NONE;
+    }
+    for (size_t i = 0; i < HashSize; i++) {
+        index.hash[i] = KEYMAP_NONE;
+    }
+    for (size_t i = 0; i < N; i++) {
+        uint32_t unicode = entries[i].unicode;
+        if (unicode < 128) {
+            index.ascii[unicode] = i;
+            continue;
+        }
+        uint32_t slot = keymapHash(unicode, keymapHashBits(HashSize));
+        while (index.hash[slot] != KEYMAP_NONE) {
+            slot = (slot + 1) & (HashSize - 1); // Linear probing
+        }
+        index.hash[slot] = i;
+    }
+    return index;
+}
+
+// A keyboard layout: keymap, dead keys and lookup index, all flash-resident.
+// Switching layouts only swaps the pointer to one of these.
+struct KeyboardLayout {
+    const char* name;
+    const KeymapEntry* entries;
+    uint16_t entryCount;
+    const uint16_t* asciiIndex;
+    const uint16_t* hashIndex;
+    uint8_t hashBits;
+    const DeadKey* deadKeys;
+    uint8_t deadKeyCount;
+    bool capsLockShiftsTopRow; // CapsLock acts as Shift on the digit row, as on Windows AZERTY
+
+    // Returns the keymap entry for a codepoint, or nullptr if it is not mapped.
+    constexpr const KeymapEntry* find(uint32_t unicode) const
+    {
+        if (unicode < 128) {
+            uint16_t i = asciiIndex[unicode];
+            return i == KEYMAP_NONE ? nullptr : &entries[i];
+        }
+        uint32_t mask = (uint32_t(1) << hashBits) - 1;
+        for (uint32_t slot = keymapHash(unicode, hashBits); ; slot = (slot + 1) & mask) {
+            uint16_t i = hashIndex[slot];
+            if (i == KEYMAP_NONE) {
+                return nullptr;
+            }
+            if (entries[i].unicode == unicode) {
+                return &entries[i];
+            }
+        }
+    }
+
+    constexpr bool isDeadKey(uint8_t modifiers, uint8_t key) const
+    {
+        for (size_t i = 0; i < deadKeyCount; i++) {
+            if (deadKeys[i].modifiers == modifiers && deadKeys[i].key == key) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+template <size_t N, size_t HashSize, size_t D>
+constexpr KeyboardLayout makeKeyboardLayout(const char* name, const KeymapEntry (&entries)[N],
+                                            const KeymapIndex<HashSize>& index, const DeadKey (&deadKeys)[D],
+                                            bool capsLockShiftsTopRow = false)
+{
+    return KeyboardLayout{name, entries, N, index.ascii, index.hash, keymapHashBits(HashSize), deadKeys, D,
+                          capsLockShiftsTopRow};
+}
+
+#endif // ESP32_BLE_KEYBOARD_LAYOUT_H
@@ -0,0 +1,129 @@
+#include "LayoutBlob.h"
+
+#include "sdkconfig.h"
+#include <string.h>
+#include "esp_rom_crc.h"
+#include "esp_partition.h"
+#include "esp_idf_version.h"
+
+#if defined(CONFIG_ARDUHAL_ESP_LOG)
+  #include "esp32-hal-log.h"
+  #define LOG_TAG ""
+#else
+  #include "esp_log.h"
+  static const char* LOG_TAG = "LayoutBlob";
+#endif
+
+static bool tableFits(const LayoutBlobHeader* header, uint32_t offset, size_t length)
+{
+    return offset % 4 == 0 && offset >= header->headerSize && offset <= header->totalSize &&
+           length <= header->totalSize - offset;
+}
+
+bool loadKeyboardLayout(const void* blob, size_t size, KeyboardLayout& layout)
+{
+    const uint8_t* base = static_cast<const uint8_t*>(blob);
+    const LayoutBlobHeader* header = static_cast<const LayoutBlobHeader*>(blob);
+
+    if (reinterpret_cast<uintptr_t>(blob) % 4 != 0 || size < sizeof(LayoutBlobHeader) ||
+        header->magic != LAYOUT_BLOB_MAGIC) {
+        ESP_LOGE(LOG_TAG, "not a layout blob");
+        return false;
+    }
+    if (header->version != LAYOUT_BLOB_VERSION || header->headerSize != sizeof(LayoutBlobHeader)) {
+        ESP_LOGE(LOG_TAG, "unsupported layout blob version %d", header->version);
+        return false;
+    }
+    if (header->totalSize > size || header->totalSize < header->headerSize) {
+        ESP_LOGE(LOG_TAG, "truncated layout blob");
+        return false;
+    }
+    if (esp_rom_crc32_le(0, base + header->headerSize, header->totalSize - header->headerSize) != header->crc32) {
+        ESP_LOGE(LOG_TAG, "layout blob CRC mismatch");
+        return false;
+    }
+
+    // A valid CRC only proves the blob was not damaged; also make sure lookups
+    // cannot leave the tables or probe a full hash table forever
+    if (header->hashBits == 0 || header->hashBits > 15) {
+        ESP_LOGE(LOG_TAG, "malformed layout blob");
+        return false;
+    }
+    size_t hashSize = size_t(1) << header->hashBits;
+    if (memchr(header->name, 0, sizeof(header->name)) == nullptr ||
+        !tableFits(header, header->entriesOffset, header->entryCount * sizeof(KeymapEntry)) ||
+        !tableFits(header, header->asciiOffset, 128 * sizeof(uint16_t)) ||
+        !tableFits(header, header->hashOffset, hashSize * sizeof(uint16_t)) ||
+        !tableFits(header, header->deadKeysOffset, header->deadKeyCount * sizeof(DeadKey))) {
+        ESP_LOGE(LOG_TAG, "malformed layout blob");
+        return false;
+    }
+    const uint16_t* ascii = reinterpret_cast<const uint16_t*>(base + header->asciiOffset);
+    const uint16_t* hash = reinterpret_cast<const uint16_t*>(base + header->hashOffset);
+    bool hasEmptySlot = false;
+    for (size_t i = 0; i < 128 + hashSize; i++) {
+        uint16_t entry = i < 128 ? ascii[i] : hash[i - 128];
+        if (entry == KEYMAP_NONE) {
+            hasEmptySlot = hasEmptySlot || i >= 128;
+        } else if (entry >= header->entryCount) {
+            ESP_LOGE(LOG_TAG, "layout blob index out of range");
+            return false;
+        }
+    }
+    if (!hasEmptySlot) {
+        ESP_LOGE(LOG_TAG, "layout blob hash table is full");
+        return false;
+    }
+    // Usages index per-key tables (such as the CapsLock keys) that stop at 0x80,
+    // and modifiers go in the modifier byte, never as keys
+    const KeymapEntry* entries = reinterpret_cast<const KeymapEntry*>(base + header->entriesOffset);
+    for (size_t i = 0; i < header->entryCount; i++) {
+        if (entries[i].sequence.key1 >= 0x80 || entries[i].sequence.key2 >= 0x80) {
+            ESP_LOGE(LOG_TAG, "layout blob usage out of range");
+            return false;
+        }
+    }
+
+    layout = KeyboardLayout{header->name,
+                            entries,
+                            header->entryCount,
+                            ascii,
+                            hash,
+                            header->hashBits,
+                            reinterpret_cast<const DeadKey*>(base + header->deadKeysOffset),
+                            header->deadKeyCount,
+                            (header->flags & LAYOUT_BLOB_CAPS_TOP_ROW) != 0};
+    return true;
+}
+
+bool mapKeyboardLayoutPartition(const char* label, KeyboardLayout& layout)
+{
+    const esp_partition_t* partition =
+        esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (partition == nullptr) {
+        ESP_LOGE(LOG_TAG, "no partition labelled %s", label);
+        return false;
+    }
+
+    const void* blob = nullptr;
+#if ESP_IDF_VERSION_MAJOR >= 5
+    esp_partition_mmap_handle_t handle;
+    esp_err_t err = esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &blob, &handle);
+#else
+    spi_flash_mmap_handle_t handle;
+    esp_err_t err = esp_partition_mmap(partition, 0, partition->size, SPI_FLASH_MMAP_DATA, &blob, &handle);
+#endif
+    if (err != ESP_OK) {
+        ESP_LOGE(LOG_TAG, "cannot map partition %s: %d", label, err);
+        return false;
+    }
+    if (!loadKeyboardLayout(blob, partition->size, layout)) {
+#if ESP_IDF_VERSION_MAJOR >= 5
+        esp_partition_munmap(handle);
+#else
+        spi_flash_munmap(handle);
+#endif
+        return false;
+    }
+    return true;
+}
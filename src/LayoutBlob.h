@@ -0,0 +1,45 @@
+#ifndef ESP32_BLE_KEYBOARD_LAYOUT_BLOB_H
+#define ESP32_BLE_KEYBOARD_LAYOUT_BLOB_H
+
+#include "KeyboardLayout.h"
+
+// Binary layout blob, for layouts shipped as data (OTA, flash partition, file).
+// The tables after the header are stored in the in-memory format of
+// KeymapEntry, DeadKey and the lookup index, little-endian, so a loaded blob
+// is used where it lies: loading only checks it and fills a KeyboardLayout
+// with pointers into it. tools/layoutblob.py writes blobs.
+#define LAYOUT_BLOB_MAGIC   0x594C4B42 // "BKLY"
+#define LAYOUT_BLOB_VERSION 1
+
+#define LAYOUT_BLOB_CAPS_TOP_ROW 0x01 // KeyboardLayout::capsLockShiftsTopRow
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t totalSize;       // Header and tables
+    uint32_t crc32;           // CRC-32 of the bytes from headerSize to totalSize
+    char name[16];            // NUL-terminated
+    uint32_t entriesOffset;   // KeymapEntry[entryCount]
+    uint32_t asciiOffset;     // uint16_t[128]
+    uint32_t hashOffset;      // uint16_t[1 << hashBits]
+    uint32_t deadKeysOffset;  // DeadKey[deadKeyCount]
+    uint16_t entryCount;
+    uint8_t hashBits;
+    uint8_t deadKeyCount;
+    uint8_t flags;
+    uint8_t reserved[3];
+} LayoutBlobHeader;
+
+static_assert(sizeof(LayoutBlobHeader) == 56, "LayoutBlobHeader layout changed");
+static_assert(sizeof(KeymapEntry) == 12 && sizeof(DeadKey) == 8, "blob tables no longer match the in-memory format");
+
+// Checks a blob and points layout at its tables. The blob must stay mapped,
+// and 4-byte aligned, for as long as the layout is in use.
+bool loadKeyboardLayout(const void* blob, size_t size, KeyboardLayout& layout);
+
+// Memory-maps the data partition with the given label and loads the blob at
+// its start. The mapping is kept on success.
+bool mapKeyboardLayoutPartition(const char* label, KeyboardLayout& layout);
+
+#endif // ESP32_BLE_KEYBOARD_LAYOUT_BLOB_H
@@ -0,0 +1,67 @@
+#ifndef ESP32_BLE_KEYBOARD_MPSC_QUEUE_H
+#define ESP32_BLE_KEYBOARD_MPSC_QUEUE_H
+
+#include <atomic>
+
+struct MpscNode
+{
+  std::atomic<MpscNode*> next{nullptr};
+};
+
+// Intrusive multi-producer, single-consumer queue (D. Vyukov's design).
+// push() is wait-free and may be called from any number of tasks at once;
+// pop() must only be called by one task at a time. Nodes are owned by the
+// caller and must stay alive until they have been popped.
+class MpscQueue
+{
+public:
+  MpscQueue() : _head(&_stub), _tail(&_stub) {}
+
+  MpscQueue(const MpscQueue&) = delete;
+  MpscQueue& operator=(const MpscQueue&) = delete;
+
+  void push(MpscNode* node)
+  {
+    node->next.store(nullptr, std::memory_order_relaxed);
+    MpscNode* previous = _head.exchange(node, std::memory_order_acq_rel);
+    previous->next.store(node, std::memory_order_release);
+  }
+
+  // Returns the oldest node, or nullptr when the queue is empty or a push is
+  // halfway done; that producer's node shows up on a later call. A popped node
+  // is no longer referenced by the queue.
+  MpscNode* pop(void)
+  {
+    MpscNode* tail = _tail;
+    MpscNode* next = tail->next.load(std::memory_order_acquire);
+    if (tail == &_stub) {
+      if (next == nullptr) {
+        return nullptr;
+      }
+      _tail = next;
+      tail = next;
+      next = next->next.load(std::memory_order_acquire);
+    }
+    if (next != nullptr) {
+      _tail = next;
+      return tail;
+    }
+    if (tail != _head.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    push(&_stub); // Keep one node in the queue so tail can move past the last one
+    next = tail->next.load(std::memory_order_acquire);
+    if (next != nullptr) {
+      _tail = next;
+      return tail;
+    }
+    return nullptr;
+  }
+
+private:
+  std::atomic<MpscNode*> _head; // Last pushed, written by producers
+  MpscNode* _tail;              // Next to pop, consumer only
+  MpscNode _stub;
+};
+
+#endif // ESP32_BLE_KEYBOARD_MPSC_QUEUE_H
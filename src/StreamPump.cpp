@@ -0,0 +1,166 @@
+#include "StreamPump.h"
+
+#include <string.h>
+#include <algorithm>
+
+StreamPump::StreamPump(BleKeyboard& keyboard, Stream& stream)
+    : _keyboard(keyboard), _stream(stream)
+{
+}
+
+StreamPump::~StreamPump()
+{
+    end();
+}
+
+bool StreamPump::begin(void)
+{
+    if (_task != nullptr) {
+        return true;
+    }
+    if (!_keyboard.isAsync() && !_keyboard.beginAsync()) {
+        return false;
+    }
+    _stop = false;
+    _flowSignalled = false; // Restarts a source a previous run left stopped
+    _state = PumpState::Running;
+    TaskPlacement placement = _keyboard.getTaskPlacement();
+    if (xTaskCreatePinnedToCore(pumpTask, "BleKeyboardPump", 3072, this, placement.priority, &_task,
+                                placement.core) != pdPASS) {
+        _task = nullptr;
+        _state = PumpState::Stopped;
+        return false;
+    }
+    return true;
+}
+
+void StreamPump::end(void)
+{
+    if (_task == nullptr) {
+        return;
+    }
+    _stop = true;
+    while (_state != PumpState::Stopped) {
+        vTaskDelay(1);
+    }
+    _task = nullptr;
+}
+
+void StreamPump::setXonXoff(bool enabled)
+{
+    _xonXoff = enabled;
+}
+
+void StreamPump::onFlowChange(FlowCallback cb)
+{
+    _flowCallback = cb;
+}
+
+PumpState StreamPump::getState(void) const
+{
+    return _state;
+}
+
+PumpProgress StreamPump::getProgress(void) const
+{
+    PumpProgress progress;
+    progress.received = _received;
+    uint32_t queued = _queued;
+    progress.typed = queued - std::min<uint32_t>(queued, _keyboard.pendingText());
+    progress.buffered = _length;
+    progress.pauses = _pauses;
+    return progress;
+}
+
+void StreamPump::pumpTask(void* arg)
+{
+    static_cast<StreamPump*>(arg)->run();
+    vTaskDelete(nullptr);
+}
+
+void StreamPump::run(void)
+{
+    while (!_stop) {
+        update();
+        vTaskDelay(1);
+    }
+    _state = PumpState::Stopped;
+}
+
+// One pass: reads what fits, hands the keyboard as much as the window allows,
+// then tells the source whether to go on.
+void StreamPump::update(void)
+{
+    size_t length = _length;
+    while (length < sizeof(_buffer) && _stream.available() > 0) {
+        int c = _stream.read();
+        if (c < 0) {
+            break;
+        }
+        if (_xonXoff && (c == XON || c == XOFF)) {
+            continue; // Flow control from the other end, not text
+        }
+        _buffer[length++] = c;
+        _received++;
+    }
+
+    // Only whole characters, so that text written by other tasks in between
+    // cannot end up in the middle of one
+    bool online = _keyboard.isSubscribed();
+    size_t pending = _keyboard.pendingText();
+    size_t taken = 0;
+    if (online && pending < BLE_KEYBOARD_PUMP_WINDOW) {
+        size_t chunk = wholeCharacters(_buffer, std::min(length, BLE_KEYBOARD_PUMP_WINDOW - pending));
+        if (chunk > 0) {
+            taken = _keyboard.write(_buffer, chunk); // 0 while the async buffer is full
+        }
+    }
+    if (taken > 0) {
+        memmove(_buffer, _buffer + taken, length - taken);
+        length -= taken;
+        _queued += taken;
+    }
+    _length = length;
+
+    bool ready = _ready;
+    if (!online || length >= sizeof(_buffer) * 3 / 4) {
+        ready = false;
+    } else if (length <= sizeof(_buffer) / 4 || !_flowSignalled) {
+        ready = true;
+    }
+    if (ready != _ready || !_flowSignalled) {
+        setReady(ready);
+    }
+    _state = !online ? PumpState::Offline : _ready ? PumpState::Running : PumpState::Paused;
+}
+
+void StreamPump::setReady(bool ready)
+{
+    _ready = ready;
+    _flowSignalled = true;
+    if (!ready) {
+        _pauses++;
+    }
+    if (_xonXoff) {
+        _stream.write(ready ? XON : XOFF);
+    }
+    if (_flowCallback) {
+        _flowCallback(ready);
+    }
+}
+
+// Length of text up to the end of its last complete UTF-8 character. A
+// sequence cut short is left for the next pass; invalid bytes go through and
+// are dealt with by the keyboard's decoder.
+size_t StreamPump::wholeCharacters(const uint8_t* text, size_t length)
+{
+    for (size_t back = 1; back <= 3 && back <= length; back++) {
+        uint8_t c = text[length - back];
+        if ((c & 0xC0) == 0x80) {
+            continue; // Continuation byte
+        }
+        size_t needed = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+        return needed > back ? length - back : length;
+    }
+    return length;
+}
@@ -0,0 +1,81 @@
+#ifndef ESP32_BLE_KEYBOARD_STREAM_PUMP_H
+#define ESP32_BLE_KEYBOARD_STREAM_PUMP_H
+
+#include <Arduino.h>
+#include "BleKeyboard.h"
+
+// Bytes the pump reads ahead of the keyboard. The source is asked to stop once
+// three quarters of it are in use, and to go on once it is down to a quarter,
+// leaving room for what the source sends before it reacts.
+#ifndef BLE_KEYBOARD_PUMP_BUFFER_SIZE
+#define BLE_KEYBOARD_PUMP_BUFFER_SIZE 256
+#endif
+
+// Text the pump lets wait in the keyboard's async buffer. That text is still
+// typed into the offline backlog when the host goes away, so it is kept to
+// what BLE_KEYBOARD_BACKLOG_SIZE holds at up to 4 reports a character.
+#ifndef BLE_KEYBOARD_PUMP_WINDOW
+#define BLE_KEYBOARD_PUMP_WINDOW (BLE_KEYBOARD_BACKLOG_SIZE / 4)
+#endif
+
+enum class PumpState : uint8_t {
+    Stopped,
+    Running,
+    Paused, // The source was asked to stop while the keyboard catches up
+    Offline // No host to type on, the source was asked to stop
+};
+
+typedef struct
+{
+  uint32_t received; // Bytes read from the stream
+  uint32_t typed;    // Of those, bytes typed, as long as nothing else writes to the keyboard
+  uint32_t buffered; // Read and not handed to the keyboard yet
+  uint32_t pauses;   // Times the source was asked to stop
+} PumpProgress;
+
+// Types everything read from a Stream, a UART or a network client, on its
+// own task. Only whole UTF-8 characters are handed to the keyboard, and the
+// source is held back with XON/XOFF on the stream itself and/or a callback
+// driving RTS, so nothing is lost when it sends faster than the keyboard types
+// or while no host is connected.
+class StreamPump
+{
+public:
+  typedef void (*FlowCallback)(bool ready); // ready is false while the source should stop
+
+  static const uint8_t XON = 0x11;
+  static const uint8_t XOFF = 0x13;
+
+  StreamPump(BleKeyboard& keyboard, Stream& stream);
+  ~StreamPump();
+  bool begin(void); // Starts async typing if needed; false if the task cannot be created
+  void end(void);   // Stops reading; text already read stays buffered for the next begin()
+  void setXonXoff(bool enabled); // On by default
+  void onFlowChange(FlowCallback cb); // Before begin()
+  PumpState getState(void) const;
+  PumpProgress getProgress(void) const;
+
+private:
+  static void pumpTask(void* arg);
+  void run(void);
+  void update(void);
+  void setReady(bool ready);
+  static size_t wholeCharacters(const uint8_t* text, size_t length);
+
+  BleKeyboard& _keyboard;
+  Stream& _stream;
+  uint8_t _buffer[BLE_KEYBOARD_PUMP_BUFFER_SIZE];
+  std::atomic<size_t> _length{0};
+  bool _ready = false;
+  bool _flowSignalled = false; // Whether the source has been told _ready since begin()
+  bool _xonXoff = true;
+  FlowCallback _flowCallback = nullptr;
+  TaskHandle_t _task = nullptr;
+  std::atomic<bool> _stop{false};
+  std::atomic<PumpState> _state{PumpState::Stopped};
+  std::atomic<uint32_t> _received{0};
+  std::atomic<uint32_t> _queued{0}; // Handed to the keyboard
+  std::atomic<uint32_t> _pauses{0};
+};
+
+#endif // ESP32_BLE_KEYBOARD_STREAM_PUMP_H
@@ -0,0 +1,127 @@
+#ifndef ESP32_BLE_KEYBOARD_UTF8_DECODER_H
+#define ESP32_BLE_KEYBOARD_UTF8_DECODER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// Incremental UTF-8 decoder. The state survives between calls, so a character
+// split across several writes (Print::print(char), Stream bridges) is still
+// decoded. Overlong encodings, surrogates and codepoints above U+10FFFF are
+// rejected; a malformed sequence is dropped and decoding resumes at the next
+// byte that can start a character.
+class Utf8Decoder
+{
+public:
+  // Decodes size bytes, calling emit(uint32_t) for every complete codepoint.
+  // Returns the number of codepoints emitted.
+  template <typename Emit>
+  size_t decode(const uint8_t* buffer, size_t size, Emit&& emit)
+  {
+    size_t count = 0;
+    size_t i = 0;
+    while (i < size) {
+      if (_needed == 0) {
+        // ASCII fast path: classify four bytes at a time
+        size_t run = i;
+        while (run + 4 <= size) {
+          uint32_t word;
+          memcpy(&word, buffer + run, sizeof(word));
+          if (word & 0x80808080u) {
+            break;
+          }
+          run += 4;
+        }
+        while (run < size && buffer[run] < 0x80) {
+          run++;
+        }
+        for (; i < run; i++) {
+          emit(static_cast<uint32_t>(buffer[i]));
+          count++;
+        }
+        if (i == size) {
+          break;
+        }
+      }
+
+      uint32_t codepoint = 0;
+      if (push(buffer[i++], codepoint)) {
+        emit(codepoint);
+        count++;
+      }
+    }
+    return count;
+  }
+
+  // Feeds a single byte; returns true and sets codepoint when it completes one.
+  // Usable in constant expressions, unlike the bulk decode().
+  constexpr bool push(uint8_t c, uint32_t& codepoint)
+  {
+    if (_needed != 0) {
+      if (c >= _lower && c <= _upper) {
+        _lower = 0x80;
+        _upper = 0xBF;
+        _codepoint = (_codepoint << 6) | (c & 0x3F);
+        if (--_needed == 0) {
+          codepoint = _codepoint;
+          return true;
+        }
+        return false;
+      }
+      reset(); // Not a valid continuation: retry this byte as a lead byte
+    }
+    if (c < 0x80) {
+      codepoint = c;
+      return true;
+    }
+    start(c);
+    return false;
+  }
+
+  constexpr void reset(void)
+  {
+    _codepoint = 0;
+    _needed = 0;
+    _lower = 0x80;
+    _upper = 0xBF;
+  }
+
+  // True while a multi-byte character has been started but not completed
+  constexpr bool pending(void) const
+  {
+    return _needed != 0;
+  }
+
+private:
+  constexpr void start(uint8_t c)
+  {
+    if (c >= 0xC2 && c <= 0xDF) {
+      _needed = 1;
+      _codepoint = c & 0x1F;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+      _needed = 2;
+      _codepoint = c & 0x0F;
+      if (c == 0xE0) {
+        _lower = 0xA0; // Overlong
+      } else if (c == 0xED) {
+        _upper = 0x9F; // Surrogates
+      }
+    } else if (c >= 0xF0 && c <= 0xF4) {
+      _needed = 3;
+      _codepoint = c & 0x07;
+      if (c == 0xF0) {
+        _lower = 0x90; // Overlong
+      } else if (c == 0xF4) {
+        _upper = 0x8F; // Above U+10FFFF
+      }
+    }
+    // Anything else (stray continuation, C0, C1, F5..FF) is skipped
+  }
+
+  uint32_t _codepoint = 0;
+  uint8_t _needed = 0;
+  uint8_t _lower = 0x80;
+  uint8_t _upper = 0xBF;
+};
+
+#endif // ESP32_BLE_KEYBOARD_UTF8_DECODER_H
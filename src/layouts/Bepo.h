@@ -0,0 +1,309 @@
+#ifndef ESP32_BLE_KEYBOARD_LAYOUT_BEPO_H
+#define ESP32_BLE_KEYBOARD_LAYOUT_BEPO_H
+
+#include "../KeyboardLayout.h"
+
+// Bepo keymap, generated from the XKB "fr:bepo" symbols
+inline constexpr KeymapEntry bepoKeymap[] = {
+    {U'\t', {0, KC_TAB, 0, 0}},
+    {U'\n', {0, KC_RETURN, 0, 0}},
+    {U' ', {0, KC_SPACE, 0, 0}},
+    {U'!', {LSHIFT, KC_Y, 0, 0}},
+    {U'#', {LSHIFT, KC_GRAVE, 0, 0}},
+    {U'$', {0, KC_GRAVE, 0, 0}},
+    {U'%', {0, KC_EQUAL, 0, 0}},
+    {U'&', {ALT_GR, KC_E, 0, 0}},
+    {U'\'', {0, KC_N, 0, 0}},
+    {U',', {0, KC_G, 0, 0}},
+    {U'.', {0, KC_V, 0, 0}},
+    {U'/', {ALT_GR, KC_NON_US_BACKSLASH, 0, 0}},
+    {U':', {LSHIFT, KC_V, 0, 0}},
+    {U';', {LSHIFT, KC_G, 0, 0}},
+    {U'=', {0, KC_MINUS, 0, 0}},
+    {U'?', {LSHIFT, KC_N, 0, 0}},
+    {U'A', {LSHIFT, KC_A, 0, 0}},
+    {U'B', {LSHIFT, KC_Q, 0, 0}},
+    {U'C', {LSHIFT, KC_H, 0, 0}},
+    {U'D', {LSHIFT, KC_I, 0, 0}},
+    {U'E', {LSHIFT, KC_F, 0, 0}},
+    {U'F', {LSHIFT, KC_SLASH, 0, 0}},
+    {U'G', {LSHIFT, KC_COMMA, 0, 0}},
+    {U'H', {LSHIFT, KC_PERIOD, 0, 0}},
+    {U'I', {LSHIFT, KC_D, 0, 0}},
+    {U'J', {LSHIFT, KC_P, 0, 0}},
+    {U'K', {LSHIFT, KC_B, 0, 0}},
+    {U'L', {LSHIFT, KC_O, 0, 0}},
+    {U'M', {LSHIFT, KC_QUOTE, 0, 0}},
+    {U'N', {LSHIFT, KC_SEMICOLON, 0, 0}},
+    {U'O', {LSHIFT, KC_R, 0, 0}},
+    {U'P', {LSHIFT, KC_E, 0, 0}},
+    {U'Q', {LSHIFT, KC_M, 0, 0}},
+    {U'R', {LSHIFT, KC_L, 0, 0}},
+    {U'S', {LSHIFT, KC_K, 0, 0}},
+    {U'T', {LSHIFT, KC_J, 0, 0}},
+    {U'U', {LSHIFT, KC_S, 0, 0}},
+    {U'V', {LSHIFT, KC_U, 0, 0}},
+    {U'W', {LSHIFT, KC_RIGHT_BRACKET, 0, 0}},
+    {U'X', {LSHIFT, KC_C, 0, 0}},
+    {U'Y', {LSHIFT, KC_X, 0, 0}},
+    {U'Z', {LSHIFT, KC_LEFT_BRACKET, 0, 0}},
+    {U'\\', {ALT_GR, KC_Z, 0, 0}},
+    {U'^', {0, KC_Y, 0, KC_SPACE}},
+    {U'_', {ALT_GR, KC_SPACE, 0, 0}},
+    {U'`', {LSHIFT, KC_EQUAL, 0, 0}},
+    {U'a', {0, KC_A, 0, 0}},
+    {U'b', {0, KC_Q, 0, 0}},
+    {U'c', {0, KC_H, 0, 0}},
+    {U'd', {0, KC_I, 0, 0}},
+    {U'e', {0, KC_F, 0, 0}},
+    {U'f', {0, KC_SLASH, 0, 0}},
+    {U'g', {0, KC_COMMA, 0, 0}},
+    {U'h', {0, KC_PERIOD, 0, 0}},
+    {U'i', {0, KC_D, 0, 0}},
+    {U'j', {0, KC_P, 0, 0}},
+    {U'k', {0, KC_B, 0, 0}},
+    {U'l', {0, KC_O, 0, 0}},
+    {U'm', {0, KC_QUOTE, 0, 0}},
+    {U'n', {0, KC_SEMICOLON, 0, 0}},
+    {U'o', {0, KC_R, 0, 0}},
+    {U'p', {0, KC_E, 0, 0}},
+    {U'q', {0, KC_M, 0, 0}},
+    {U'r', {0, KC_L, 0, 0}},
+    {U's', {0, KC_K, 0, 0}},
+    {U't', {0, KC_J, 0, 0}},
+    {U'u', {0, KC_S, 0, 0}},
+    {U'v', {0, KC_U, 0, 0}},
+    {U'w', {0, KC_RIGHT_BRACKET, 0, 0}},
+    {U'x', {0, KC_C, 0, 0}},
+    {U'y', {0, KC_X, 0, 0}},
+    {U'z', {0, KC_LEFT_BRACKET, 0, 0}},
+    {U'{', {ALT_GR, KC_X, 0, 0}},
+    {U'|', {ALT_GR, KC_Q, 0, 0}},
+    {U'}', {ALT_GR, KC_C, 0, 0}},
+    {U'~', {ALT_GR, KC_B, 0, 0}},
+    {0x00A0, {LSHIFT, KC_SPACE, 0, 0}},
+    {U'¡', {ALT_GR, KC_Y, 0, 0}},
+    {U'¦', {LSHIFT | ALT_GR, KC_Q, 0, 0}},
+    {U'§', {LSHIFT | ALT_GR, KC_E, 0, 0}},
+    {U'¨', {ALT_GR, KC_D, 0, KC_SPACE}},
+    {U'©', {ALT_GR, KC_H, 0, 0}},
+    {U'ª', {LSHIFT | ALT_GR, KC_SLASH, 0, 0}},
+    {U'®', {ALT_GR, KC_L, 0, 0}},
+    {U'¯', {ALT_GR, KC_QUOTE, 0, KC_SPACE}},
+    {U'°', {LSHIFT, KC_MINUS, 0, 0}},
+    {U'´', {ALT_GR, KC_W, 0, KC_SPACE}},
+    {U'¶', {LSHIFT | ALT_GR, KC_GRAVE, 0, 0}},
+    {U'·', {LSHIFT | ALT_GR, KC_V, 0, 0}},
+    {U'¸', {ALT_GR, KC_BACKSLASH, 0, KC_SPACE}},
+    {U'º', {LSHIFT | ALT_GR, KC_QUOTE, 0, 0}},
+    {U'¿', {ALT_GR, KC_N, 0, 0}},
+    {U'À', {LSHIFT, KC_Z, 0, 0}},
+    {U'Á', {ALT_GR, KC_W, LSHIFT, KC_A}},
+    {U'Â', {0, KC_Y, LSHIFT, KC_A}},
+    {U'Ã', {ALT_GR, KC_SEMICOLON, LSHIFT, KC_A}},
+    {U'Ä', {ALT_GR, KC_D, LSHIFT, KC_A}},
+    {U'Å', {ALT_GR, KC_M, LSHIFT, KC_A}},
+    {U'Æ', {LSHIFT | ALT_GR, KC_A, 0, 0}},
+    {U'Ç', {LSHIFT, KC_BACKSLASH, 0, 0}},
+    {U'È', {LSHIFT, KC_T, 0, 0}},
+    {U'É', {LSHIFT, KC_W, 0, 0}},
+    {U'Ê', {LSHIFT, KC_NON_US_BACKSLASH, 0, 0}},
+    {U'Ë', {ALT_GR, KC_D, LSHIFT, KC_F}},
+    {U'Ì', {ALT_GR, KC_T, LSHIFT, KC_D}},
+    {U'Í', {ALT_GR, KC_W, LSHIFT, KC_D}},
+    {U'Î', {0, KC_Y, LSHIFT, KC_D}},
+    {U'Ï', {ALT_GR, KC_D, LSHIFT, KC_D}},
+    {U'Ð', {LSHIFT | ALT_GR, KC_I, 0, 0}},
+    {U'Ñ', {ALT_GR, KC_SEMICOLON, LSHIFT, KC_SEMICOLON}},
+    {U'Ò', {ALT_GR, KC_T, LSHIFT, KC_R}},
+    {U'Ó', {ALT_GR, KC_W, LSHIFT, KC_R}},
+    {U'Ô', {0, KC_Y, LSHIFT, KC_R}},
+    {U'Õ', {ALT_GR, KC_SEMICOLON, LSHIFT, KC_R}},
+    {U'Ö', {ALT_GR, KC_D, LSHIFT, KC_R}},
+    {U'Ù', {LSHIFT | ALT_GR, KC_S, 0, 0}},
+    {U'Ú', {ALT_GR, KC_W, LSHIFT, KC_S}},
+    {U'Û', {0, KC_Y, LSHIFT, KC_S}},
+    {U'Ü', {ALT_GR, KC_D, LSHIFT, KC_S}},
+    {U'Ý', {ALT_GR, KC_W, LSHIFT, KC_X}},
+    {U'Þ', {LSHIFT | ALT_GR, KC_J, 0, 0}},
+    {U'ß', {ALT_GR, KC_K, 0, 0}},
+    {U'à', {0, KC_Z, 0, 0}},
+    {U'á', {ALT_GR, KC_W, 0, KC_A}},
+    {U'â', {0, KC_Y, 0, KC_A}},
+    {U'ã', {ALT_GR, KC_SEMICOLON, 0, KC_A}},
+    {U'ä', {ALT_GR, KC_D, 0, KC_A}},
+    {U'å', {ALT_GR, KC_M, 0, KC_A}},
+    {U'æ', {ALT_GR, KC_A, 0, 0}},
+    {U'ç', {0, KC_BACKSLASH, 0, 0}},
+    {U'è', {0, KC_T, 0, 0}},
+    {U'é', {0, KC_W, 0, 0}},
+    {U'ê', {0, KC_NON_US_BACKSLASH, 0, 0}},
+    {U'ë', {ALT_GR, KC_D, 0, KC_F}},
+    {U'ì', {ALT_GR, KC_T, 0, KC_D}},
+    {U'í', {ALT_GR, KC_W, 0, KC_D}},
+    {U'î', {0, KC_Y, 0, KC_D}},
+    {U'ï', {ALT_GR, KC_D, 0, KC_D}},
+    {U'ð', {ALT_GR, KC_I, 0, 0}},
+    {U'ñ', {ALT_GR, KC_SEMICOLON, 0, KC_SEMICOLON}},
+    {U'ò', {ALT_GR, KC_T, 0, KC_R}},
+    {U'ó', {ALT_GR, KC_W, 0, KC_R}},
+    {U'ô', {0, KC_Y, 0, KC_R}},
+    {U'õ', {ALT_GR, KC_SEMICOLON, 0, KC_R}},
+    {U'ö', {ALT_GR, KC_D, 0, KC_R}},
+    {U'ù', {ALT_GR, KC_S, 0, 0}},
+    {U'ú', {ALT_GR, KC_W, 0, KC_S}},
+    {U'û', {0, KC_Y, 0, KC_S}},
+    {U'ü', {ALT_GR, KC_D, 0, KC_S}},
+    {U'ý', {ALT_GR, KC_W, 0, KC_X}},
+    {U'þ', {ALT_GR, KC_J, 0, 0}},
+    {U'ÿ', {ALT_GR, KC_D, 0, KC_X}},
+    {U'Ā', {ALT_GR, KC_QUOTE, LSHIFT, KC_A}},
+    {U'ā', {ALT_GR, KC_QUOTE, 0, KC_A}},
+    {U'Ă', {ALT_GR, KC_RIGHT_BRACKET, LSHIFT, KC_A}},
+    {U'ă', {ALT_GR, KC_RIGHT_BRACKET, 0, KC_A}},
+    {U'Ą', {ALT_GR, KC_SLASH, LSHIFT, KC_A}},
+    {U'ą', {ALT_GR, KC_SLASH, 0, KC_A}},
+    {U'Ć', {ALT_GR, KC_W, LSHIFT, KC_H}},
+    {U'ć', {ALT_GR, KC_W, 0, KC_H}},
+    {U'Ĉ', {0, KC_Y, LSHIFT, KC_H}},
+    {U'ĉ', {0, KC_Y, 0, KC_H}},
+    {U'Ċ', {LSHIFT | ALT_GR, KC_D, LSHIFT, KC_H}},
+    {U'ċ', {LSHIFT | ALT_GR, KC_D, 0, KC_H}},
+    {U'Č', {ALT_GR, KC_U, LSHIFT, KC_H}},
+    {U'č', {ALT_GR, KC_U, 0, KC_H}},
+    {U'Ď', {ALT_GR, KC_U, LSHIFT, KC_I}},
+    {U'ď', {ALT_GR, KC_U, 0, KC_I}},
+    {U'Ē', {ALT_GR, KC_QUOTE, LSHIFT, KC_F}},
+    {U'ē', {ALT_GR, KC_QUOTE, 0, KC_F}},
+    {U'Ĕ', {ALT_GR, KC_RIGHT_BRACKET, LSHIFT, KC_F}},
+    {U'ĕ', {ALT_GR, KC_RIGHT_BRACKET, 0, KC_F}},
+    {U'Ė', {LSHIFT | ALT_GR, KC_D, LSHIFT, KC_F}},
+    {U'ė', {LSHIFT | ALT_GR, KC_D, 0, KC_F}},
+    {U'Ę', {ALT_GR, KC_SLASH, LSHIFT, KC_F}},
+    {U'ę', {ALT_GR, KC_SLASH, 0, KC_F}},
+    {U'Ě', {ALT_GR, KC_U, LSHIFT, KC_F}},
+    {U'ě', {ALT_GR, KC_U, 0, KC_F}},
+    {U'Ĝ', {0, KC_Y, LSHIFT, KC_COMMA}},
+    {U'ĝ', {0, KC_Y, 0, KC_COMMA}},
+    {U'Ğ', {ALT_GR, KC_RIGHT_BRACKET, LSHIFT, KC_COMMA}},
+    {U'ğ', {ALT_GR, KC_RIGHT_BRACKET, 0, KC_COMMA}},
+    {U'Ġ', {LSHIFT | ALT_GR, KC_D, LSHIFT, KC_COMMA}},
+    {U'ġ', {LSHIFT | ALT_GR, KC_D, 0, KC_COMMA}},
+    {U'Ģ', {ALT_GR, KC_BACKSLASH, LSHIFT, KC_COMMA}},
+    {U'ģ', {ALT_GR, KC_BACKSLASH, 0, KC_COMMA}},
+    {U'Ĥ', {0, KC_Y, LSHIFT, KC_PERIOD}},
+    {U'ĥ', {0, KC_Y, 0, KC_PERIOD}},
+    {U'Ĩ', {ALT_GR, KC_SEMICOLON, LSHIFT, KC_D}},
+    {U'ĩ', {ALT_GR, KC_SEMICOLON, 0, KC_D}},
+    {U'Ī', {ALT_GR, KC_QUOTE, LSHIFT, KC_D}},
+    {U'ī', {ALT_GR, KC_QUOTE, 0, KC_D}},
+    {U'Ĭ', {ALT_GR, KC_RIGHT_BRACKET, LSHIFT, KC_D}},
+    {U'ĭ', {ALT_GR, KC_RIGHT_BRACKET, 0, KC_D}},
+    {U'Į', {ALT_GR, KC_SLASH, LSHIFT, KC_D}},
+    {U'į', {ALT_GR, KC_SLASH, 0, KC_D}},
+    {U'İ', {LSHIFT | ALT_GR, KC_D, LSHIFT, KC_D}},
+    {U'Ĳ', {LSHIFT | ALT_GR, KC_P, 0, 0}},
+    {U'ĳ', {ALT_GR, KC_P, 0, 0}},
+    {U'Ĵ', {0, KC_Y, LSHIFT, KC_P}},
+    {U'ĵ', {0, KC_Y, 0, KC_P}},
+    {U'Ķ', {ALT_GR, KC_BACKSLASH, LSHIFT, KC_B}},
+    {U'ķ', {ALT_GR, KC_BACKSLASH, 0, KC_B}},
+    {U'Ĺ', {ALT_GR, KC_W, LSHIFT, KC_O}},
+    {U'ĺ', {ALT_GR, KC_W, 0, KC_O}},
+    {U'Ļ', {ALT_GR, KC_BACKSLASH, LSHIFT, KC_O}},
+    {U'ļ', {ALT_GR, KC_BACKSLASH, 0, KC_O}},
+    {U'Ľ', {ALT_GR, KC_U, LSHIFT, KC_O}},
+    {U'ľ', {ALT_GR, KC_U, 0, KC_O}},
+    {U'Ń', {ALT_GR, KC_W, LSHIFT, KC_SEMICOLON}},
+    {U'ń', {ALT_GR, KC_W, 0, KC_SEMICOLON}},
+    {U'Ņ', {ALT_GR, KC_BACKSLASH, LSHIFT, KC_SEMICOLON}},
+    {U'ņ', {ALT_GR, KC_BACKSLASH, 0, KC_SEMICOLON}},
+    {U'Ň', {ALT_GR, KC_U, LSHIFT, KC_SEMICOLON}},
+    {U'ň', {ALT_GR, KC_U, 0, KC_SEMICOLON}},
+    {U'Ō', {ALT_GR, KC_QUOTE, LSHIFT, KC_R}},
+    {U'ō', {ALT_GR, KC_QUOTE, 0, KC_R}},
+    {U'Ŏ', {ALT_GR, KC_RIGHT_BRACKET, LSHIFT, KC_R}},
+    {U'ŏ', {ALT_GR, KC_RIGHT_BRACKET, 0, KC_R}},
+    {U'Ő', {LSHIFT | ALT_GR, KC_W, LSHIFT, KC_R}},
+    {U'ő', {LSHIFT | ALT_GR, KC_W, 0, KC_R}},
+    {U'Œ', {LSHIFT | ALT_GR, KC_R, 0, 0}},
+    {U'œ', {ALT_GR, KC_R, 0, 0}},
+    {U'Ŕ', {ALT_GR, KC_W, LSHIFT, KC_L}},
+    {U'ŕ', {ALT_GR, KC_W, 0, KC_L}},
+    {U'Ŗ', {ALT_GR, KC_BACKSLASH, LSHIFT, KC_L}},
+    {U'ŗ', {ALT_GR, KC_BACKSLASH, 0, KC_L}},
+    {U'Ř', {ALT_GR, KC_U, LSHIFT, KC_L}},
+    {U'ř', {ALT_GR, KC_U, 0, KC_L}},
+    {U'Ś', {ALT_GR, KC_W, LSHIFT, KC_K}},
+    {U'ś', {ALT_GR, KC_W, 0, KC_K}},
+    {U'Ŝ', {0, KC_Y, LSHIFT, KC_K}},
+    {U'ŝ', {0, KC_Y, 0, KC_K}},
+    {U'Ş', {ALT_GR, KC_BACKSLASH, LSHIFT, KC_K}},
+    {U'ş', {ALT_GR, KC_BACKSLASH, 0, KC_K}},
+    {U'Š', {ALT_GR, KC_U, LSHIFT, KC_K}},
+    {U'š', {ALT_GR, KC_U, 0, KC_K}},
+    {U'Ţ', {ALT_GR, KC_BACKSLASH, LSHIFT, KC_J}},
+    {U'ţ', {ALT_GR, KC_BACKSLASH, 0, KC_J}},
+    {U'Ť', {ALT_GR, KC_U, LSHIFT, KC_J}},
+    {U'ť', {ALT_GR, KC_U, 0, KC_J}},
+    {U'Ũ', {ALT_GR, KC_SEMICOLON, LSHIFT, KC_S}},
+    {U'ũ', {ALT_GR, KC_SEMICOLON, 0, KC_S}},
+    {U'Ū', {ALT_GR, KC_QUOTE, LSHIFT, KC_S}},
+    {U'ū', {ALT_GR, KC_QUOTE, 0, KC_S}},
+    {U'Ŭ', {ALT_GR, KC_RIGHT_BRACKET, LSHIFT, KC_S}},
+    {U'ŭ', {ALT_GR, KC_RIGHT_BRACKET, 0, KC_S}},
+    {U'Ů', {ALT_GR, KC_M, LSHIFT, KC_S}},
+    {U'ů', {ALT_GR, KC_M, 0, KC_S}},
+    {U'Ű', {LSHIFT | ALT_GR, KC_W, LSHIFT, KC_S}},
+    {U'ű', {LSHIFT | ALT_GR, KC_W, 0, KC_S}},
+    {U'Ų', {ALT_GR, KC_SLASH, LSHIFT, KC_S}},
+    {U'ų', {ALT_GR, KC_SLASH, 0, KC_S}},
+    {U'Ŵ', {0, KC_Y, LSHIFT, KC_RIGHT_BRACKET}},
+    {U'ŵ', {0, KC_Y, 0, KC_RIGHT_BRACKET}},
+    {U'Ŷ', {0, KC_Y, LSHIFT, KC_X}},
+    {U'ŷ', {0, KC_Y, 0, KC_X}},
+    {U'Ÿ', {ALT_GR, KC_D, LSHIFT, KC_X}},
+    {U'Ź', {ALT_GR, KC_W, LSHIFT, KC_LEFT_BRACKET}},
+    {U'ź', {ALT_GR, KC_W, 0, KC_LEFT_BRACKET}},
+    {U'Ż', {LSHIFT | ALT_GR, KC_D, LSHIFT, KC_LEFT_BRACKET}},
+    {U'ż', {LSHIFT | ALT_GR, KC_D, 0, KC_LEFT_BRACKET}},
+    {U'Ž', {ALT_GR, KC_U, LSHIFT, KC_LEFT_BRACKET}},
+    {U'ž', {ALT_GR, KC_U, 0, KC_LEFT_BRACKET}},
+    {U'ſ', {LSHIFT | ALT_GR, KC_H, 0, 0}},
+    {U'ẞ', {LSHIFT | ALT_GR, KC_K, 0, 0}},
+    {U'–', {ALT_GR, KC_GRAVE, 0, 0}},
+    {U'‘', {LSHIFT | ALT_GR, KC_X, 0, 0}},
+    {U'’', {ALT_GR, KC_G, 0, 0}},
+    {U'†', {ALT_GR, KC_PERIOD, 0, 0}},
+    {U'‡', {LSHIFT | ALT_GR, KC_PERIOD, 0, 0}},
+    {U'…', {ALT_GR, KC_V, 0, 0}},
+    {0x202F, {LSHIFT | ALT_GR, KC_SPACE, 0, 0}},
+    {U'‰', {ALT_GR, KC_EQUAL, 0, 0}},
+    {U'′', {LSHIFT | ALT_GR, KC_MINUS, 0, 0}},
+    {U'″', {LSHIFT | ALT_GR, KC_EQUAL, 0, 0}},
+    {U'€', {ALT_GR, KC_F, 0, 0}},
+    {U'™', {LSHIFT | ALT_GR, KC_L, 0, 0}},
+};
+
+inline constexpr DeadKey bepoDeadKeys[] = {
+    {U'^', 0, KC_Y}, // dead_circumflex
+    {U'´', ALT_GR, KC_W}, // dead_acute
+    {U'`', ALT_GR, KC_T}, // dead_grave
+    {U'ˇ', ALT_GR, KC_U}, // dead_caron
+    {U'˘', ALT_GR, KC_RIGHT_BRACKET}, // dead_breve
+    {U'¨', ALT_GR, KC_D}, // dead_diaeresis
+    {U'~', ALT_GR, KC_SEMICOLON}, // dead_tilde
+    {U'¯', ALT_GR, KC_QUOTE}, // dead_macron
+    {U'¸', ALT_GR, KC_BACKSLASH}, // dead_cedilla
+    {U'˚', ALT_GR, KC_M}, // dead_abovering
+    {U'˛', ALT_GR, KC_SLASH}, // dead_ogonek
+    {U'˝', LSHIFT | ALT_GR, KC_W}, // dead_doubleacute
+    {U'˙', LSHIFT | ALT_GR, KC_D}, // dead_abovedot
+};
+
+static_assert(!keymapHasDuplicates(bepoKeymap), "bepoKeymap contains the same codepoint twice");
+
+inline constexpr auto bepoIndex = buildKeymapIndex<512>(bepoKeymap);
+inline constexpr KeyboardLayout LayoutBepo = makeKeyboardLayout("Bepo", bepoKeymap, bepoIndex, bepoDeadKeys);
+
+#endif // ESP32_BLE_KEYBOARD_LAYOUT_BEPO_H
@@ -0,0 +1,330 @@
+#ifndef ESP32_BLE_KEYBOARD_LAYOUT_CHQWERTZ_H
+#define ESP32_BLE_KEYBOARD_LAYOUT_CHQWERTZ_H
+
+#include "../KeyboardLayout.h"
+
+// ChQwertz keymap, generated from the XKB "ch" symbols
+inline constexpr KeymapEntry chQwertzKeymap[] = {
+    {U'\t', {0, KC_TAB, 0, 0}},
+    {U'\n', {0, KC_RETURN, 0, 0}},
+    {U' ', {0, KC_SPACE, 0, 0}},
+    {U'!', {LSHIFT, KC_RIGHT_BRACKET, 0, 0}},
+    {U'"', {LSHIFT, KC_2, 0, 0}},
+    {U'#', {ALT_GR, KC_3, 0, 0}},
+    {U'$', {0, KC_BACKSLASH, 0, 0}},
+    {U'%', {LSHIFT, KC_5, 0, 0}},
+    {U'&', {LSHIFT, KC_6, 0, 0}},
+    {U'\'', {0, KC_MINUS, 0, 0}},
+    {U'(', {LSHIFT, KC_8, 0, 0}},
+    {U')', {LSHIFT, KC_9, 0, 0}},
+    {U'*', {LSHIFT, KC_3, 0, 0}},
+    {U'+', {LSHIFT, KC_1, 0, 0}},
+    {U',', {0, KC_COMMA, 0, 0}},
+    {U'-', {0, KC_SLASH, 0, 0}},
+    {U'.', {0, KC_PERIOD, 0, 0}},
+    {U'/', {LSHIFT, KC_7, 0, 0}},
+    {U'0', {0, KC_0, 0, 0}},
+    {U'1', {0, KC_1, 0, 0}},
+    {U'2', {0, KC_2, 0, 0}},
+    {U'3', {0, KC_3, 0, 0}},
+    {U'4', {0, KC_4, 0, 0}},
+    {U'5', {0, KC_5, 0, 0}},
+    {U'6', {0, KC_6, 0, 0}},
+    {U'7', {0, KC_7, 0, 0}},
+    {U'8', {0, KC_8, 0, 0}},
+    {U'9', {0, KC_9, 0, 0}},
+    {U':', {LSHIFT, KC_PERIOD, 0, 0}},
+    {U';', {LSHIFT, KC_COMMA, 0, 0}},
+    {U'<', {0, KC_NON_US_BACKSLASH, 0, 0}},
+    {U'=', {LSHIFT, KC_0, 0, 0}},
+    {U'>', {LSHIFT, KC_NON_US_BACKSLASH, 0, 0}},
+    {U'?', {LSHIFT, KC_MINUS, 0, 0}},
+    {U'@', {ALT_GR, KC_2, 0, 0}},
+    {U'A', {LSHIFT, KC_A, 0, 0}},
+    {U'B', {LSHIFT, KC_B, 0, 0}},
+    {U'C', {LSHIFT, KC_C, 0, 0}},
+    {U'D', {LSHIFT, KC_D, 0, 0}},
+    {U'E', {LSHIFT, KC_E, 0, 0}},
+    {U'F', {LSHIFT, KC_F, 0, 0}},
+    {U'G', {LSHIFT, KC_G, 0, 0}},
+    {U'H', {LSHIFT, KC_H, 0, 0}},
+    {U'I', {LSHIFT, KC_I, 0, 0}},
+    {U'J', {LSHIFT, KC_J, 0, 0}},
+    {U'K', {LSHIFT, KC_K, 0, 0}},
+    {U'L', {LSHIFT, KC_L, 0, 0}},
+    {U'M', {LSHIFT, KC_M, 0, 0}},
+    {U'N', {LSHIFT, KC_N, 0, 0}},
+    {U'O', {LSHIFT, KC_O, 0, 0}},
+    {U'P', {LSHIFT, KC_P, 0, 0}},
+    {U'Q', {LSHIFT, KC_Q, 0, 0}},
+    {U'R', {LSHIFT, KC_R, 0, 0}},
+    {U'S', {LSHIFT, KC_S, 0, 0}},
+    {U'T', {LSHIFT, KC_T, 0, 0}},
+    {U'U', {LSHIFT, KC_U, 0, 0}},
+    {U'V', {LSHIFT, KC_V, 0, 0}},
+    {U'W', {LSHIFT, KC_W, 0, 0}},
+    {U'X', {LSHIFT, KC_X, 0, 0}},
+    {U'Y', {LSHIFT, KC_Z, 0, 0}},
+    {U'Z', {LSHIFT, KC_Y, 0, 0}},
+    {U'[', {ALT_GR, KC_LEFT_BRACKET, 0, 0}},
+    {U'\\', {ALT_GR, KC_NON_US_BACKSLASH, 0, 0}},
+    {U']', {ALT_GR, KC_RIGHT_BRACKET, 0, 0}},
+    {U'^', {0, KC_EQUAL, 0, KC_SPACE}},
+    {U'_', {LSHIFT, KC_SLASH, 0, 0}},
+    {U'`', {LSHIFT, KC_EQUAL, 0, KC_SPACE}},
+    {U'a', {0, KC_A, 0, 0}},
+    {U'b', {0, KC_B, 0, 0}},
+    {U'c', {0, KC_C, 0, 0}},
+    {U'd', {0, KC_D, 0, 0}},
+    {U'e', {0, KC_E, 0, 0}},
+    {U'f', {0, KC_F, 0, 0}},
+    {U'g', {0, KC_G, 0, 0}},
+    {U'h', {0, KC_H, 0, 0}},
+    {U'i', {0, KC_I, 0, 0}},
+    {U'j', {0, KC_J, 0, 0}},
+    {U'k', {0, KC_K, 0, 0}},
+    {U'l', {0, KC_L, 0, 0}},
+    {U'm', {0, KC_M, 0, 0}},
+    {U'n', {0, KC_N, 0, 0}},
+    {U'o', {0, KC_O, 0, 0}},
+    {U'p', {0, KC_P, 0, 0}},
+    {U'q', {0, KC_Q, 0, 0}},
+    {U'r', {0, KC_R, 0, 0}},
+    {U's', {0, KC_S, 0, 0}},
+    {U't', {0, KC_T, 0, 0}},
+    {U'u', {0, KC_U, 0, 0}},
+    {U'v', {0, KC_V, 0, 0}},
+    {U'w', {0, KC_W, 0, 0}},
+    {U'x', {0, KC_X, 0, 0}},
+    {U'y', {0, KC_Z, 0, 0}},
+    {U'z', {0, KC_Y, 0, 0}},
+    {U'{', {ALT_GR, KC_QUOTE, 0, 0}},
+    {U'|', {ALT_GR, KC_1, 0, 0}},
+    {U'}', {ALT_GR, KC_BACKSLASH, 0, 0}},
+    {U'~', {ALT_GR, KC_EQUAL, 0, KC_SPACE}},
+    {U'¡', {LSHIFT | ALT_GR, KC_1, 0, 0}},
+    {U'¢', {ALT_GR, KC_8, 0, 0}},
+    {U'£', {LSHIFT, KC_BACKSLASH, 0, 0}},
+    {U'¥', {LSHIFT | ALT_GR, KC_Y, 0, 0}},
+    {U'¦', {LSHIFT | ALT_GR, KC_NON_US_BACKSLASH, 0, 0}},
+    {U'§', {0, KC_GRAVE, 0, 0}},
+    {U'¨', {0, KC_RIGHT_BRACKET, 0, KC_SPACE}},
+    {U'©', {LSHIFT | ALT_GR, KC_C, 0, 0}},
+    {U'ª', {LSHIFT | ALT_GR, KC_F, 0, 0}},
+    {U'«', {ALT_GR, KC_Z, 0, 0}},
+    {U'¬', {ALT_GR, KC_6, 0, 0}},
+    {U'®', {LSHIFT | ALT_GR, KC_R, 0, 0}},
+    {U'¯', {LSHIFT | ALT_GR, KC_RIGHT_BRACKET, 0, KC_SPACE}},
+    {U'°', {LSHIFT, KC_GRAVE, 0, 0}},
+    {U'±', {LSHIFT | ALT_GR, KC_9, 0, 0}},
+    {U'´', {ALT_GR, KC_MINUS, 0, KC_SPACE}},
+    {U'µ', {ALT_GR, KC_M, 0, 0}},
+    {U'¶', {ALT_GR, KC_R, 0, 0}},
+    {U'·', {ALT_GR, KC_PERIOD, 0, 0}},
+    {U'º', {LSHIFT | ALT_GR, KC_M, 0, 0}},
+    {U'»', {ALT_GR, KC_X, 0, 0}},
+    {U'¼', {ALT_GR, KC_4, 0, 0}},
+    {U'½', {ALT_GR, KC_5, 0, 0}},
+    {U'¿', {LSHIFT | ALT_GR, KC_MINUS, 0, 0}},
+    {U'À', {LSHIFT, KC_EQUAL, LSHIFT, KC_A}},
+    {U'Á', {ALT_GR, KC_MINUS, LSHIFT, KC_A}},
+    {U'Â', {0, KC_EQUAL, LSHIFT, KC_A}},
+    {U'Ã', {ALT_GR, KC_EQUAL, LSHIFT, KC_A}},
+    {U'Ä', {0, KC_RIGHT_BRACKET, LSHIFT, KC_A}},
+    {U'Å', {LSHIFT | ALT_GR, KC_LEFT_BRACKET, LSHIFT, KC_A}},
+    {U'Æ', {LSHIFT | ALT_GR, KC_A, 0, 0}},
+    {U'È', {LSHIFT, KC_EQUAL, LSHIFT, KC_E}},
+    {U'É', {ALT_GR, KC_MINUS, LSHIFT, KC_E}},
+    {U'Ê', {0, KC_EQUAL, LSHIFT, KC_E}},
+    {U'Ë', {0, KC_RIGHT_BRACKET, LSHIFT, KC_E}},
+    {U'Ì', {LSHIFT, KC_EQUAL, LSHIFT, KC_I}},
+    {U'Í', {ALT_GR, KC_MINUS, LSHIFT, KC_I}},
+    {U'Î', {0, KC_EQUAL, LSHIFT, KC_I}},
+    {U'Ï', {0, KC_RIGHT_BRACKET, LSHIFT, KC_I}},
+    {U'Ð', {LSHIFT | ALT_GR, KC_D, 0, 0}},
+    {U'Ñ', {ALT_GR, KC_EQUAL, LSHIFT, KC_N}},
+    {U'Ò', {LSHIFT, KC_EQUAL, LSHIFT, KC_O}},
+    {U'Ó', {ALT_GR, KC_MINUS, LSHIFT, KC_O}},
+    {U'Ô', {0, KC_EQUAL, LSHIFT, KC_O}},
+    {U'Õ', {ALT_GR, KC_EQUAL, LSHIFT, KC_O}},
+    {U'Ö', {0, KC_RIGHT_BRACKET, LSHIFT, KC_O}},
+    {U'×', {LSHIFT | ALT_GR, KC_COMMA, 0, 0}},
+    {U'Ù', {LSHIFT, KC_EQUAL, LSHIFT, KC_U}},
+    {U'Ú', {ALT_GR, KC_MINUS, LSHIFT, KC_U}},
+    {U'Û', {0, KC_EQUAL, LSHIFT, KC_U}},
+    {U'Ü', {0, KC_RIGHT_BRACKET, LSHIFT, KC_U}},
+    {U'Ý', {ALT_GR, KC_MINUS, LSHIFT, KC_Z}},
+    {U'Þ', {LSHIFT | ALT_GR, KC_P, 0, 0}},
+    {U'ß', {ALT_GR, KC_S, 0, 0}},
+    {U'à', {LSHIFT, KC_QUOTE, 0, 0}},
+    {U'á', {ALT_GR, KC_MINUS, 0, KC_A}},
+    {U'â', {0, KC_EQUAL, 0, KC_A}},
+    {U'ã', {ALT_GR, KC_EQUAL, 0, KC_A}},
+    {U'ä', {0, KC_QUOTE, 0, 0}},
+    {U'å', {LSHIFT | ALT_GR, KC_LEFT_BRACKET, 0, KC_A}},
+    {U'æ', {ALT_GR, KC_A, 0, 0}},
+    {U'ç', {LSHIFT, KC_4, 0, 0}},
+    {U'è', {LSHIFT, KC_LEFT_BRACKET, 0, 0}},
+    {U'é', {LSHIFT, KC_SEMICOLON, 0, 0}},
+    {U'ê', {0, KC_EQUAL, 0, KC_E}},
+    {U'ë', {0, KC_RIGHT_BRACKET, 0, KC_E}},
+    {U'ì', {LSHIFT, KC_EQUAL, 0, KC_I}},
+    {U'í', {ALT_GR, KC_MINUS, 0, KC_I}},
+    {U'î', {0, KC_EQUAL, 0, KC_I}},
+    {U'ï', {0, KC_RIGHT_BRACKET, 0, KC_I}},
+    {U'ð', {ALT_GR, KC_D, 0, 0}},
+    {U'ñ', {ALT_GR, KC_EQUAL, 0, KC_N}},
+    {U'ò', {LSHIFT, KC_EQUAL, 0, KC_O}},
+    {U'ó', {ALT_GR, KC_MINUS, 0, KC_O}},
+    {U'ô', {0, KC_EQUAL, 0, KC_O}},
+    {U'õ', {ALT_GR, KC_EQUAL, 0, KC_O}},
+    {U'ö', {0, KC_SEMICOLON, 0, 0}},
+    {U'÷', {LSHIFT | ALT_GR, KC_PERIOD, 0, 0}},
+    {U'ù', {LSHIFT, KC_EQUAL, 0, KC_U}},
+    {U'ú', {ALT_GR, KC_MINUS, 0, KC_U}},
+    {U'û', {0, KC_EQUAL, 0, KC_U}},
+    {U'ü', {0, KC_LEFT_BRACKET, 0, 0}},
+    {U'ý', {ALT_GR, KC_MINUS, 0, KC_Z}},
+    {U'þ', {ALT_GR, KC_P, 0, 0}},
+    {U'ÿ', {0, KC_RIGHT_BRACKET, 0, KC_Z}},
+    {U'Ā', {LSHIFT | ALT_GR, KC_RIGHT_BRACKET, LSHIFT, KC_A}},
+    {U'ā', {LSHIFT | ALT_GR, KC_RIGHT_BRACKET, 0, KC_A}},
+    {U'Ă', {LSHIFT | ALT_GR, KC_BACKSLASH, LSHIFT, KC_A}},
+    {U'ă', {LSHIFT | ALT_GR, KC_BACKSLASH, 0, KC_A}},
+    {U'Ą', {LSHIFT | ALT_GR, KC_EQUAL, LSHIFT, KC_A}},
+    {U'ą', {LSHIFT | ALT_GR, KC_EQUAL, 0, KC_A}},
+    {U'Ć', {ALT_GR, KC_MINUS, LSHIFT, KC_C}},
+    {U'ć', {ALT_GR, KC_MINUS, 0, KC_C}},
+    {U'Ĉ', {0, KC_EQUAL, LSHIFT, KC_C}},
+    {U'ĉ', {0, KC_EQUAL, 0, KC_C}},
+    {U'Ċ', {LSHIFT | ALT_GR, KC_SLASH, LSHIFT, KC_C}},
+    {U'ċ', {LSHIFT | ALT_GR, KC_SLASH, 0, KC_C}},
+    {U'Č', {LSHIFT | ALT_GR, KC_QUOTE, LSHIFT, KC_C}},
+    {U'č', {LSHIFT | ALT_GR, KC_QUOTE, 0, KC_C}},
+    {U'Ď', {LSHIFT | ALT_GR, KC_QUOTE, LSHIFT, KC_D}},
+    {U'ď', {LSHIFT | ALT_GR, KC_QUOTE, 0, KC_D}},
+    {U'đ', {ALT_GR, KC_F, 0, 0}},
+    {U'Ē', {LSHIFT | ALT_GR, KC_RIGHT_BRACKET, LSHIFT, KC_E}},
+    {U'ē', {LSHIFT | ALT_GR, KC_RIGHT_BRACKET, 0, KC_E}},
+    {U'Ĕ', {LSHIFT | ALT_GR, KC_BACKSLASH, LSHIFT, KC_E}},
+    {U'ĕ', {LSHIFT | ALT_GR, KC_BACKSLASH, 0, KC_E}},
+    {U'Ė', {LSHIFT | ALT_GR, KC_SLASH, LSHIFT, KC_E}},
+    {U'ė', {LSHIFT | ALT_GR, KC_SLASH, 0, KC_E}},
+    {U'Ę', {LSHIFT | ALT_GR, KC_EQUAL, LSHIFT, KC_E}},
+    {U'ę', {LSHIFT | ALT_GR, KC_EQUAL, 0, KC_E}},
+    {U'Ě', {LSHIFT | ALT_GR, KC_QUOTE, LSHIFT, KC_E}},
+    {U'ě', {LSHIFT | ALT_GR, KC_QUOTE, 0, KC_E}},
+    {U'Ĝ', {0, KC_EQUAL, LSHIFT, KC_G}},
+    {U'ĝ', {0, KC_EQUAL, 0, KC_G}},
+    {U'Ğ', {LSHIFT | ALT_GR, KC_BACKSLASH, LSHIFT, KC_G}},
+    {U'ğ', {LSHIFT | ALT_GR, KC_BACKSLASH, 0, KC_G}},
+    {U'Ġ', {LSHIFT | ALT_GR, KC_SLASH, LSHIFT, KC_G}},
+    {U'ġ', {LSHIFT | ALT_GR, KC_SLASH, 0, KC_G}},
+    {U'Ĥ', {0, KC_EQUAL, LSHIFT, KC_H}},
+    {U'ĥ', {0, KC_EQUAL, 0, KC_H}},
+    {U'Ħ', {LSHIFT | ALT_GR, KC_H, 0, 0}},
+    {U'ħ', {ALT_GR, KC_H, 0, 0}},
+    {U'Ĩ', {ALT_GR, KC_EQUAL, LSHIFT, KC_I}},
+    {U'ĩ', {ALT_GR, KC_EQUAL, 0, KC_I}},
+    {U'Ī', {LSHIFT | ALT_GR, KC_RIGHT_BRACKET, LSHIFT, KC_I}},
+    {U'ī', {LSHIFT | ALT_GR, KC_RIGHT_BRACKET, 0, KC_I}},
+    {U'Ĭ', {LSHIFT | ALT_GR, KC_BACKSLASH, LSHIFT, KC_I}},
+    {U'ĭ', {LSHIFT | ALT_GR, KC_BACKSLASH, 0, KC_I}},
+    {U'Į', {LSHIFT | ALT_GR, KC_EQUAL, LSHIFT, KC_I}},
+    {U'į', {LSHIFT | ALT_GR, KC_EQUAL, 0, KC_I}},
+    {U'İ', {LSHIFT | ALT_GR, KC_SLASH, LSHIFT, KC_I}},
+    {U'ı', {LSHIFT | ALT_GR, KC_I, 0, 0}},
+    {U'Ĵ', {0, KC_EQUAL, LSHIFT, KC_J}},
+    {U'ĵ', {0, KC_EQUAL, 0, KC_J}},
+    {U'ĸ', {ALT_GR, KC_K, 0, 0}},
+    {U'Ĺ', {ALT_GR, KC_MINUS, LSHIFT, KC_L}},
+    {U'ĺ', {ALT_GR, KC_MINUS, 0, KC_L}},
+    {U'Ľ', {LSHIFT | ALT_GR, KC_QUOTE, LSHIFT, KC_L}},
+    {U'ľ', {LSHIFT | ALT_GR, KC_QUOTE, 0, KC_L}},
+    {U'Ł', {LSHIFT | ALT_GR, KC_L, 0, 0}},
+    {U'ł', {ALT_GR, KC_L, 0, 0}},
+    {U'Ń', {ALT_GR, KC_MINUS, LSHIFT, KC_N}},
+    {U'ń', {ALT_GR, KC_MINUS, 0, KC_N}},
+    {U'Ň', {LSHIFT | ALT_GR, KC_QUOTE, LSHIFT, KC_N}},
+    {U'ň', {LSHIFT | ALT_GR, KC_QUOTE, 0, KC_N}},
+    {U'Ŋ', {LSHIFT | ALT_GR, KC_G, 0, 0}},
+    {U'ŋ', {ALT_GR, KC_G, 0, 0}},
+    {U'Ō', {LSHIFT | ALT_GR, KC_RIGHT_BRACKET, LSHIFT, KC_O}},
+    {U'ō', {LSHIFT | ALT_GR, KC_RIGHT_BRACKET, 0, KC_O}},
+    {U'Ŏ', {LSHIFT | ALT_GR, KC_BACKSLASH, LSHIFT, KC_O}},
+    {U'ŏ', {LSHIFT | ALT_GR, KC_BACKSLASH, 0, KC_O}},
+    {U'Ő', {LSHIFT | ALT_GR, KC_SEMICOLON, LSHIFT, KC_O}},
+    {U'ő', {LSHIFT | ALT_GR, KC_SEMICOLON, 0, KC_O}},
+    {U'Œ', {LSHIFT | ALT_GR, KC_O, 0, 0}},
+    {U'œ', {ALT_GR, KC_O, 0, 0}},
+    {U'Ŕ', {ALT_GR, KC_MINUS, LSHIFT, KC_R}},
+    {U'ŕ', {ALT_GR, KC_MINUS, 0, KC_R}},
+    {U'Ř', {LSHIFT | ALT_GR, KC_QUOTE, LSHIFT, KC_R}},
+    {U'ř', {LSHIFT | ALT_GR, KC_QUOTE, 0, KC_R}},
+    {U'Ś', {ALT_GR, KC_MINUS, LSHIFT, KC_S}},
+    {U'ś', {ALT_GR, KC_MINUS, 0, KC_S}},
+    {U'Ŝ', {0, KC_EQUAL, LSHIFT, KC_S}},
+    {U'ŝ', {0, KC_EQUAL, 0, KC_S}},
+    {U'Š', {LSHIFT | ALT_GR, KC_QUOTE, LSHIFT, KC_S}},
+    {U'š', {LSHIFT | ALT_GR, KC_QUOTE, 0, KC_S}},
+    {U'Ť', {LSHIFT | ALT_GR, KC_QUOTE, LSHIFT, KC_T}},
+    {U'ť', {LSHIFT | ALT_GR, KC_QUOTE, 0, KC_T}},
+    {U'Ŧ', {LSHIFT | ALT_GR, KC_T, 0, 0}},
+    {U'ŧ', {ALT_GR, KC_T, 0, 0}},
+    {U'Ũ', {ALT_GR, KC_EQUAL, LSHIFT, KC_U}},
+    {U'ũ', {ALT_GR, KC_EQUAL, 0, KC_U}},
+    {U'Ū', {LSHIFT | ALT_GR, KC_RIGHT_BRACKET, LSHIFT, KC_U}},
+    {U'ū', {LSHIFT | ALT_GR, KC_RIGHT_BRACKET, 0, KC_U}},
+    {U'Ŭ', {LSHIFT | ALT_GR, KC_BACKSLASH, LSHIFT, KC_U}},
+    {U'ŭ', {LSHIFT | ALT_GR, KC_BACKSLASH, 0, KC_U}},
+    {U'Ů', {LSHIFT | ALT_GR, KC_LEFT_BRACKET, LSHIFT, KC_U}},
+    {U'ů', {LSHIFT | ALT_GR, KC_LEFT_BRACKET, 0, KC_U}},
+    {U'Ű', {LSHIFT | ALT_GR, KC_SEMICOLON, LSHIFT, KC_U}},
+    {U'ű', {LSHIFT | ALT_GR, KC_SEMICOLON, 0, KC_U}},
+    {U'Ų', {LSHIFT | ALT_GR, KC_EQUAL, LSHIFT, KC_U}},
+    {U'ų', {LSHIFT | ALT_GR, KC_EQUAL, 0, KC_U}},
+    {U'Ŵ', {0, KC_EQUAL, LSHIFT, KC_W}},
+    {U'ŵ', {0, KC_EQUAL, 0, KC_W}},
+    {U'Ŷ', {0, KC_EQUAL, LSHIFT, KC_Z}},
+    {U'ŷ', {0, KC_EQUAL, 0, KC_Z}},
+    {U'Ÿ', {0, KC_RIGHT_BRACKET, LSHIFT, KC_Z}},
+    {U'Ź', {ALT_GR, KC_MINUS, LSHIFT, KC_Y}},
+    {U'ź', {ALT_GR, KC_MINUS, 0, KC_Y}},
+    {U'Ż', {LSHIFT | ALT_GR, KC_SLASH, LSHIFT, KC_Y}},
+    {U'ż', {LSHIFT | ALT_GR, KC_SLASH, 0, KC_Y}},
+    {U'Ž', {LSHIFT | ALT_GR, KC_QUOTE, LSHIFT, KC_Y}},
+    {U'ž', {LSHIFT | ALT_GR, KC_QUOTE, 0, KC_Y}},
+    {U'ſ', {ALT_GR, KC_W, 0, 0}},
+    {U'ẞ', {LSHIFT | ALT_GR, KC_S, 0, 0}},
+    {U'‘', {LSHIFT | ALT_GR, KC_B, 0, 0}},
+    {U'’', {LSHIFT | ALT_GR, KC_N, 0, 0}},
+    {U'‚', {LSHIFT | ALT_GR, KC_V, 0, 0}},
+    {U'“', {ALT_GR, KC_B, 0, 0}},
+    {U'”', {ALT_GR, KC_N, 0, 0}},
+    {U'„', {ALT_GR, KC_V, 0, 0}},
+    {U'•', {ALT_GR, KC_COMMA, 0, 0}},
+    {U'€', {ALT_GR, KC_E, 0, 0}},
+    {U'™', {LSHIFT | ALT_GR, KC_8, 0, 0}},
+};
+
+inline constexpr DeadKey chQwertzDeadKeys[] = {
+    {U'^', 0, KC_EQUAL}, // dead_circumflex
+    {U'¨', 0, KC_RIGHT_BRACKET}, // dead_diaeresis
+    {U'`', LSHIFT, KC_EQUAL}, // dead_grave
+    {U'´', ALT_GR, KC_MINUS}, // dead_acute
+    {U'~', ALT_GR, KC_EQUAL}, // dead_tilde
+    {U'˛', LSHIFT | ALT_GR, KC_EQUAL}, // dead_ogonek
+    {U'˚', LSHIFT | ALT_GR, KC_LEFT_BRACKET}, // dead_abovering
+    {U'¯', LSHIFT | ALT_GR, KC_RIGHT_BRACKET}, // dead_macron
+    {U'˝', LSHIFT | ALT_GR, KC_SEMICOLON}, // dead_doubleacute
+    {U'ˇ', LSHIFT | ALT_GR, KC_QUOTE}, // dead_caron
+    {U'˘', LSHIFT | ALT_GR, KC_BACKSLASH}, // dead_breve
+    {U'˙', LSHIFT | ALT_GR, KC_SLASH}, // dead_abovedot
+};
+
+static_assert(!keymapHasDuplicates(chQwertzKeymap), "chQwertzKeymap contains the same codepoint twice");
+
+inline constexpr auto chQwertzIndex = buildKeymapIndex<512>(chQwertzKeymap);
+inline constexpr KeyboardLayout LayoutChQwertz = makeKeyboardLayout("ChQwertz", chQwertzKeymap, chQwertzIndex, chQwertzDeadKeys);
+
+#endif // ESP32_BLE_KEYBOARD_LAYOUT_CHQWERTZ_H
@@ -0,0 +1,236 @@
+#ifndef ESP32_BLE_KEYBOARD_LAYOUT_FRAZERTY_H
+#define ESP32_BLE_KEYBOARD_LAYOUT_FRAZERTY_H
+
+#include "../KeyboardLayout.h"
+
+// FR AZERTY keymap
+inline constexpr KeymapEntry frAzertyKeymap[] = {
+    {U'a', {0, KC_Q, 0, 0}},
+    {U'b', {0, KC_B, 0, 0}},
+    {U'c', {0, KC_C, 0, 0}},
+    {U'd', {0, KC_D, 0, 0}},
+    {U'e', {0, KC_E, 0, 0}},
+    {U'f', {0, KC_F, 0, 0}},
+    {U'g', {0, KC_G, 0, 0}},
+    {U'h', {0, KC_H, 0, 0}},
+    {U'i', {0, KC_I, 0, 0}},
+    {U'j', {0, KC_J, 0, 0}},
+    {U'k', {0, KC_K, 0, 0}},
+    {U'l', {0, KC_L, 0, 0}},
+    {U'm', {0, KC_SEMICOLON, 0, 0}},
+    {U'n', {0, KC_N, 0, 0}},
+    {U'o', {0, KC_O, 0, 0}},
+    {U'p', {0, KC_P, 0, 0}},
+    {U'q', {0, KC_A, 0, 0}},
+    {U'r', {0, KC_R, 0, 0}},
+    {U's', {0, KC_S, 0, 0}},
+    {U't', {0, KC_T, 0, 0}},
+    {U'u', {0, KC_U, 0, 0}},
+    {U'v', {0, KC_V, 0, 0}},
+    {U'w', {0, KC_Z, 0, 0}},
+    {U'x', {0, KC_X, 0, 0}},
+    {U'y', {0, KC_Y, 0, 0}},
+    {U'z', {0, KC_W, 0, 0}},
+    {U'A', {LSHIFT, KC_Q, 0, 0}},
+    {U'B', {LSHIFT, KC_B, 0, 0}},
+    {U'C', {LSHIFT, KC_C, 0, 0}},
+    {U'D', {LSHIFT, KC_D, 0, 0}},
+    {U'E', {LSHIFT, KC_E, 0, 0}},
+    {U'F', {LSHIFT, KC_F, 0, 0}},
+    {U'G', {LSHIFT, KC_G, 0, 0}},
+    {U'H', {LSHIFT, KC_H, 0, 0}},
+    {U'I', {LSHIFT, KC_I, 0, 0}},
+    {U'J', {LSHIFT, KC_J, 0, 0}},
+    {U'K', {LSHIFT, KC_K, 0, 0}},
+    {U'L', {LSHIFT, KC_L, 0, 0}},
+    {U'M', {LSHIFT, KC_SEMICOLON, 0, 0}},
+    {U'N', {LSHIFT, KC_N, 0, 0}},
+    {U'O', {LSHIFT, KC_O, 0, 0}},
+    {U'P', {LSHIFT, KC_P, 0, 0}},
+    {U'Q', {LSHIFT, KC_A, 0, 0}},
+    {U'R', {LSHIFT, KC_R, 0, 0}},
+    {U'S', {LSHIFT, KC_S, 0, 0}},
+    {U'T', {LSHIFT, KC_T, 0, 0}},
+    {U'U', {LSHIFT, KC_U, 0, 0}},
+    {U'V', {LSHIFT, KC_V, 0, 0}},
+    {U'W', {LSHIFT, KC_Z, 0, 0}},
+    {U'X', {LSHIFT, KC_X, 0, 0}},
+    {U'Y', {LSHIFT, KC_Y, 0, 0}},
+    {U'Z', {LSHIFT, KC_W, 0, 0}},
+    {U'1', {LSHIFT, KC_1, 0, 0}},
+    {U'2', {LSHIFT, KC_2, 0, 0}},
+    {U'3', {LSHIFT, KC_3, 0, 0}},
+    {U'4', {LSHIFT, KC_4, 0, 0}},
+    {U'5', {LSHIFT, KC_5, 0, 0}},
+    {U'6', {LSHIFT, KC_6, 0, 0}},
+    {U'7', {LSHIFT, KC_7, 0, 0}},
+    {U'8', {LSHIFT, KC_8, 0, 0}},
+    {U'9', {LSHIFT, KC_9, 0, 0}},
+    {U'0', {LSHIFT, KC_0, 0, 0}},
+    {U' ', {0, KC_SPACE, 0, 0}},
+    {U'!', {0, KC_SLASH, 0, 0}},
+    {U'"', {0, KC_3, 0, 0}},
+    {U'#', {ALT_GR, KC_3, 0, 0}},
+    {U'$', {0, KC_RIGHT_BRACKET, 0, 0}},
+    {U'%', {LSHIFT, KC_QUOTE, 0, 0}},
+    {U'&', {0, KC_1, 0, 0}},
+    {U'\'', {0, KC_4, 0, 0}},
+    {U'(', {0, KC_5, 0, 0}},
+    {U')', {0, KC_MINUS, 0, 0}},
+    {U'*', {0, KC_BACKSLASH, 0, 0}},
+    {U'+', {LSHIFT, KC_EQUAL, 0, 0}},
+    {U',', {0, KC_M, 0, 0}},
+    {U'-', {0, KC_6, 0, 0}},
+    {U'.', {LSHIFT, KC_COMMA, 0, 0}},
+    {U'/', {LSHIFT, KC_PERIOD, 0, 0}},
+    {U':', {0, KC_PERIOD, 0, 0}},
+    {U';', {0, KC_COMMA, 0, 0}},
+    {U'<', {0, KC_NON_US_BACKSLASH, 0, 0}},
+    {U'=', {0, KC_EQUAL, 0, 0}},
+    {U'>', {LSHIFT, KC_NON_US_BACKSLASH, 0, 0}},
+    {U'?', {LSHIFT, KC_M, 0, 0}},
+    {U'@', {ALT_GR, KC_0, 0, 0}},
+    {U'[', {ALT_GR, KC_5, 0, 0}},
+    {U'\\', {ALT_GR, KC_8, 0, 0}},
+    {U']', {ALT_GR, KC_MINUS, 0, 0}},
+    {U'^', {ALT_GR, KC_9, 0, 0}},
+    {U'_', {0, KC_8, 0, 0}},
+    {U'`', {ALT_GR, KC_7, 0, KC_SPACE}},
+    {U'{', {ALT_GR, KC_4, 0, 0}},
+    {U'|', {ALT_GR, KC_6, 0, 0}},
+    {U'}', {ALT_GR, KC_EQUAL, 0, 0}},
+    {U'~', {ALT_GR, KC_2, 0, KC_SPACE}},
+    {U'\n', {0, KC_RETURN, 0, 0}},
+    {U'\t', {0, KC_TAB, 0, 0}},
+    {U'é', {0, KC_2, 0, 0}},
+    {U'€', {ALT_GR, KC_E, 0, 0}},
+    {U'£', {LSHIFT, KC_RIGHT_BRACKET, 0, 0}},
+    {U'è', {0, KC_7, 0, 0}},
+    {U'à', {0, KC_0, 0, 0}},
+    {U'ù', {0, KC_QUOTE, 0, 0}},
+    {U'ç', {0, KC_9, 0, 0}},
+
+    // Accented characters (dead keys)
+    {U'â', {0, KC_LEFT_BRACKET, 0, KC_Q}},
+    {U'ê', {0, KC_LEFT_BRACKET, 0, KC_E}},
+    {U'î', {0, KC_LEFT_BRACKET, 0, KC_I}},
+    {U'ô', {0, KC_LEFT_BRACKET, 0, KC_O}},
+    {U'û', {0, KC_LEFT_BRACKET, 0, KC_U}},
+    
+    {U'ä', {LSHIFT, KC_LEFT_BRACKET, 0, KC_Q}},
+    {U'ë', {LSHIFT, KC_LEFT_BRACKET, 0, KC_E}},
+    {U'ï', {LSHIFT, KC_LEFT_BRACKET, 0, KC_I}},
+    {U'ö', {LSHIFT, KC_LEFT_BRACKET, 0, KC_O}},
+    {U'ü', {LSHIFT, KC_LEFT_BRACKET, 0, KC_U}},
+	
+    {U'ì', {ALT_GR, KC_7, 0, KC_I}},
+    {U'ò', {ALT_GR, KC_7, 0, KC_O}},
+
+	{U'ã', {ALT_GR, KC_2, 0, KC_Q}},
+    {U'õ', {ALT_GR, KC_2, 0, KC_O}},
+	{U'ñ', {ALT_GR, KC_2, 0, KC_N}},
+
+    {U'Â', {0, KC_LEFT_BRACKET, LSHIFT, KC_Q}},
+    {U'Ê', {0, KC_LEFT_BRACKET, LSHIFT, KC_E}},
+    {U'Î', {0, KC_LEFT_BRACKET, LSHIFT, KC_I}},
+    {U'Ô', {0, KC_LEFT_BRACKET, LSHIFT, KC_O}},
+    {U'Û', {0, KC_LEFT_BRACKET, LSHIFT, KC_U}},
+
+    {U'Ä', {LSHIFT, KC_LEFT_BRACKET, LSHIFT, KC_Q}},
+    {U'Ë', {LSHIFT, KC_LEFT_BRACKET, LSHIFT, KC_E}},
+    {U'Ï', {LSHIFT, KC_LEFT_BRACKET, LSHIFT, KC_I}},
+    {U'Ö', {LSHIFT, KC_LEFT_BRACKET, LSHIFT, KC_O}},
+    {U'Ü', {LSHIFT, KC_LEFT_BRACKET, LSHIFT, KC_U}},
+
+	{U'À', {ALT_GR, KC_7, LSHIFT, KC_Q}},
+    {U'È', {ALT_GR, KC_7, LSHIFT, KC_E}},
+    {U'Ì', {ALT_GR, KC_7, LSHIFT, KC_I}},
+    {U'Ò', {ALT_GR, KC_7, LSHIFT, KC_O}},
+    {U'Ù', {ALT_GR, KC_7, LSHIFT, KC_U}},
+
+	{U'Ã', {ALT_GR, KC_2, LSHIFT, KC_Q}},
+    {U'Õ', {ALT_GR, KC_2, LSHIFT, KC_O}},
+	{U'Ñ', {ALT_GR, KC_2, LSHIFT, KC_N}},
+    
+    // Other special characters
+    {U'¤', {ALT_GR, KC_RIGHT_BRACKET, 0, 0}},
+    {U'µ', {LSHIFT, KC_BACKSLASH, 0, 0}},
+    {U'²', {0, KC_GRAVE, 0, 0}},
+    {U'§', {LSHIFT, KC_SLASH, 0, 0}},
+    {U'°', {LSHIFT, KC_MINUS, 0, 0}},
+	
+	// Substitued characters
+	{U'“', {0, KC_3, 0, 0}, KEYMAP_SUBSTITUTE},
+	{U'”', {0, KC_3, 0, 0}, KEYMAP_SUBSTITUTE},
+	{U'«', {0, KC_3, 0, 0}, KEYMAP_SUBSTITUTE},
+	{U'»', {0, KC_3, 0, 0}, KEYMAP_SUBSTITUTE},
+	{U'¨', {LSHIFT, KC_LEFT_BRACKET, 0, KC_SPACE}},
+	
+	{U'’', {0, KC_4, 0, 0}, KEYMAP_SUBSTITUTE},
+    {U'‘', {0, KC_4, 0, 0}, KEYMAP_SUBSTITUTE},
+	{U'´', {0, KC_4, 0, 0}, KEYMAP_SUBSTITUTE},
+	
+	{U'‚', {0, KC_M, 0, 0}, KEYMAP_SUBSTITUTE},
+	{U'¸', {0, KC_M, 0, 0}, KEYMAP_SUBSTITUTE},
+	{U'„', {0, KC_M, 0, KC_M}, KEYMAP_SUBSTITUTE}, 
+	
+	{U'›', {LSHIFT, KC_NON_US_BACKSLASH, 0, 0}, KEYMAP_SUBSTITUTE},
+	{U'‹', {0, KC_NON_US_BACKSLASH, 0, 0}, KEYMAP_SUBSTITUTE}, 
+	
+	{U'•', {0, KC_BACKSLASH, 0, 0}, KEYMAP_SUBSTITUTE},
+	{U'–', {0, KC_6, 0, 0}, KEYMAP_SUBSTITUTE}, 
+	{U'—', {0, KC_6, 0, 0}, KEYMAP_SUBSTITUTE}, 
+	
+	{U'œ', {0, KC_O, 0, KC_E}, KEYMAP_SUBSTITUTE}, 
+	{U'Œ', {LSHIFT, KC_O, LSHIFT, KC_E}, KEYMAP_SUBSTITUTE}, 
+	{U'Æ', {LSHIFT, KC_Q, LSHIFT, KC_E}, KEYMAP_SUBSTITUTE},
+	{U'æ', {0, KC_Q, 0, KC_E}, KEYMAP_SUBSTITUTE},
+	
+	{U'×', {0, KC_X, 0, 0}, KEYMAP_SUBSTITUTE},
+	
+	{U'Á', {LSHIFT, KC_Q, 0, 0}, KEYMAP_SUBSTITUTE},
+	{U'Å', {LSHIFT, KC_Q, 0, 0}, KEYMAP_SUBSTITUTE},
+	{U'É', {LSHIFT, KC_E, 0, 0}, KEYMAP_SUBSTITUTE},
+	{U'Í', {LSHIFT, KC_I, 0, 0}, KEYMAP_SUBSTITUTE},
+	{U'Ð', {LSHIFT, KC_D, 0, 0}, KEYMAP_SUBSTITUTE},
+	{U'Ó', {LSHIFT, KC_O, 0, 0}, KEYMAP_SUBSTITUTE},
+	{U'Ø', {LSHIFT, KC_0, 0, 0}, KEYMAP_SUBSTITUTE},
+	{U'Þ', {LSHIFT, KC_T, LSHIFT, KC_H}, KEYMAP_SUBSTITUTE},
+	{U'ß', {0, KC_S, 0, KC_S}, KEYMAP_SUBSTITUTE},
+	{U'á', {0, KC_Q, 0, 0}, KEYMAP_SUBSTITUTE},
+	{U'í', {0, KC_I, 0, 0}, KEYMAP_SUBSTITUTE},
+	{U'ð', {0, KC_D, 0, 0}, KEYMAP_SUBSTITUTE},
+	{U'ó', {0, KC_O, 0, 0}, KEYMAP_SUBSTITUTE},
+	{U'ø', {0, KC_0, 0, 0}, KEYMAP_SUBSTITUTE},
+	{U'ý', {0, KC_Y, 0, 0}, KEYMAP_SUBSTITUTE},
+	{U'ÿ', {LSHIFT, KC_LEFT_BRACKET, 0, KC_Y}},
+	{U'þ', {0, KC_T, 0, KC_H}, KEYMAP_SUBSTITUTE},
+	{U'Ý', {0, KC_Y, 0, 0}, KEYMAP_SUBSTITUTE},
+	{U'å', {0, KC_Q, 0, 0}, KEYMAP_SUBSTITUTE},
+	{U'÷', {LSHIFT, KC_PERIOD, 0, 0}, KEYMAP_SUBSTITUTE},
+	{U'³', {0, KC_LEFT_BRACKET, 0, KC_3}, KEYMAP_SUBSTITUTE},
+	{U'ª', {0, KC_LEFT_BRACKET, 0, KC_Q}, KEYMAP_SUBSTITUTE},
+	{U'¦', {ALT_GR, KC_6, 0, 0}, KEYMAP_SUBSTITUTE},
+	{U'¥', {LSHIFT, KC_Y, 0, 0}, KEYMAP_SUBSTITUTE},
+	{U'¢', {0, KC_C, 0, KC_T}, KEYMAP_SUBSTITUTE},
+	{U'¡', {0, KC_SLASH, 0, 0}, KEYMAP_SUBSTITUTE},
+	{U'Ÿ', {LSHIFT, KC_LEFT_BRACKET, LSHIFT, KC_Y}},
+	{U'ž', {0, KC_W, 0, 0}, KEYMAP_SUBSTITUTE},
+	{U'š', {0, KC_S, 0, 0}, KEYMAP_SUBSTITUTE},
+	{U'™', {LSHIFT, KC_T, LSHIFT, KC_SEMICOLON}, KEYMAP_SUBSTITUTE},
+	{0x00A0, {0, KC_SPACE, 0, 0}, KEYMAP_SUBSTITUTE}, // NBSP U+00A0 160
+};
+
+inline constexpr DeadKey frAzertyDeadKeys[] = {
+    {U'^', 0, KC_LEFT_BRACKET},
+    {U'¨', LSHIFT, KC_LEFT_BRACKET},
+    {U'`', ALT_GR, KC_7},
+    {U'~', ALT_GR, KC_2},
+};
+
+static_assert(!keymapHasDuplicates(frAzertyKeymap), "frAzertyKeymap contains the same codepoint twice");
+
+inline constexpr auto frAzertyIndex = buildKeymapIndex<256>(frAzertyKeymap);
+inline constexpr KeyboardLayout LayoutFrAzerty = makeKeyboardLayout("FrAzerty", frAzertyKeymap, frAzertyIndex, frAzertyDeadKeys, true);
+
+#endif // ESP32_BLE_KEYBOARD_LAYOUT_FRAZERTY_H
@@ -0,0 +1,33 @@
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+// Assertions for the host tests: the first one to fail ends the test
+
+#include "HostSim.h"
+
+#define CHECK(condition)                                                               \
+  do {                                                                                 \
+    if (!(condition)) {                                                                \
+      hostsim::fail("%s:%d: CHECK(%s)", __FILE__, __LINE__, #condition);               \
+    }                                                                                  \
+  } while (0)
+
+#define CHECK_EQ(actual, expected)                                                     \
+  do {                                                                                 \
+    long long actualValue = (long long)(actual);                                       \
+    long long expectedValue = (long long)(expected);                                   \
+    if (actualValue != expectedValue) {                                                \
+      hostsim::fail("%s:%d: %s is %lld, expected %lld", __FILE__, __LINE__, #actual,   \
+                    actualValue, expectedValue);                                       \
+    }                                                                                  \
+  } while (0)
+
+#define TEST(name) static void name(void)
+
+#define RUN(name)                                                                      \
+  do {                                                                                 \
+    printf("%s\n", #name);                                                             \
+    name();                                                                            \
+  } while (0)
+
+#endif // TEST_CHECK_H
@@ -0,0 +1,121 @@
+// Arduino core and ESP-IDF odds and ends on the host
+
+#include "Arduino.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+
+#include <algorithm>
+#include <stdarg.h>
+#include <stdio.h>
+
+HardwareSerial Serial;
+
+void delay(uint32_t ms)
+{
+  vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+unsigned long millis(void)
+{
+  return esp_timer_get_time() / 1000;
+}
+
+unsigned long micros(void)
+{
+  return esp_timer_get_time();
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+  return fwrite(&c, 1, 1, stdout);
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size)
+{
+  return fwrite(buffer, 1, size, stdout);
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size)
+{
+  size_t written = 0;
+  while (written < size && write(buffer[written]) == 1) {
+    written++;
+  }
+  return written;
+}
+
+size_t Print::print(int value)
+{
+  return printf("%d", value);
+}
+
+size_t Print::print(unsigned int value)
+{
+  return printf("%u", value);
+}
+
+size_t Print::print(long value)
+{
+  return printf("%ld", value);
+}
+
+size_t Print::print(unsigned long value)
+{
+  return printf("%lu", value);
+}
+
+size_t Print::printf(const char* format, ...)
+{
+  char buffer[256];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  if (length < 0) {
+    return 0;
+  }
+  return write((const uint8_t*)buffer, std::min<size_t>(length, sizeof(buffer) - 1));
+}
+
+size_t Stream::readBytes(uint8_t* buffer, size_t length)
+{
+  size_t count = 0;
+  while (count < length && available() > 0) {
+    int c = read();
+    if (c < 0) {
+      break;
+    }
+    buffer[count++] = c;
+  }
+  return count;
+}
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char* label)
+{
+  return nullptr;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t* partition, size_t offset, size_t size,
+                             esp_partition_mmap_memory_t memory, const void** out, esp_partition_mmap_handle_t* handle)
+{
+  return ESP_ERR_NOT_FOUND;
+}
+
+void esp_partition_munmap(esp_partition_mmap_handle_t handle)
+{
+}
+
+// Same result as the ROM routine: reflected CRC-32, with the caller's
+// initial value and the final inversion handled like esp_rom_crc32_le()
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buffer, uint32_t length)
+{
+  crc = ~crc;
+  for (uint32_t i = 0; i < length; i++) {
+    crc ^= buffer[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+  }
+  return ~crc;
+}
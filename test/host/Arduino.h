@@ -0,0 +1,35 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "Print.h"
+#include "Stream.h"
+
+void delay(uint32_t ms);
+unsigned long millis(void);
+unsigned long micros(void);
+
+// Serial writes to stdout and never has anything to read
+class HardwareSerial : public Stream
+{
+public:
+  void begin(unsigned long baud) {}
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+#endif // HOST_ARDUINO_H
@@ -0,0 +1,23 @@
+#ifndef HOST_HIDTYPES_H
+#define HOST_HIDTYPES_H
+
+// HID report descriptor items, as in NimBLE-Arduino
+
+#define HIDINPUT(size)        (0x80 | size)
+#define HIDOUTPUT(size)       (0x90 | size)
+#define FEATURE(size)         (0xb0 | size)
+#define COLLECTION(size)      (0xa0 | size)
+#define END_COLLECTION(size)  (0xc0 | size)
+
+#define USAGE_PAGE(size)      (0x04 | size)
+#define LOGICAL_MINIMUM(size) (0x14 | size)
+#define LOGICAL_MAXIMUM(size) (0x24 | size)
+#define REPORT_SIZE(size)     (0x74 | size)
+#define REPORT_ID(size)       (0x84 | size)
+#define REPORT_COUNT(size)    (0x94 | size)
+
+#define USAGE(size)           (0x08 | size)
+#define USAGE_MINIMUM(size)   (0x18 | size)
+#define USAGE_MAXIMUM(size)   (0x28 | size)
+
+#endif // HOST_HIDTYPES_H
@@ -0,0 +1,765 @@
+// Emulation of FreeRTOS and esp_timer on the virtual clock, see HostSim.h
+
+#include "HostSim.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/stream_buffer.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <stdarg.h>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_TASKS  32
+#define MAX_TIMERS 32
+#define MAX_HELD_MUTEXES 8
+#define ESP_TIMER_TASK_PRIORITY 22
+#define LOOP_TASK_PRIORITY 1
+
+// Waits on a mutex longer than this are taken for a deadlock
+#define MUTEX_WAIT_LIMIT_MICROS (10 * 1000000LL)
+
+struct QueueDefinition
+{
+  enum class Kind : uint8_t { Binary, Counting, Mutex };
+  Kind kind;
+  bool isStatic;
+  UBaseType_t count;
+  UBaseType_t max;
+  tskTaskControlBlock* holder;
+};
+static_assert(sizeof(QueueDefinition) <= sizeof(StaticSemaphore_t), "StaticSemaphore_t is too small");
+
+struct tskTaskControlBlock
+{
+  char name[16];
+  UBaseType_t priority;
+  BaseType_t core;
+  TaskFunction_t function;
+  void* arg;
+  std::condition_variable turn;
+  bool ready = true;
+  bool deleted = false;
+  bool finished = false;
+  uint64_t readySince = 0;  // Orders ready tasks of the same priority
+  int64_t wakeAt = hostsim::NEVER;
+  const void* waitingOn = nullptr;
+  uint32_t notifyValue = 0;
+  QueueDefinition* held[MAX_HELD_MUTEXES] = {};
+};
+
+struct StreamBufferDef_t
+{
+  uint8_t* data;
+  size_t size;
+  size_t head;
+  size_t count;
+  size_t triggerLevel;
+};
+
+struct esp_timer
+{
+  esp_timer_cb_t callback;
+  void* arg;
+  const char* name;
+  int64_t expiry; // NEVER while stopped
+  int64_t period; // 0 for one-shot
+  bool pending;   // Expired, callback not run yet
+  uint64_t firedSeq;
+};
+
+namespace {
+
+struct TaskExit {};
+
+std::mutex kernelLock;
+tskTaskControlBlock* tasks[MAX_TASKS];
+size_t taskCount = 0;
+tskTaskControlBlock* running = nullptr;
+thread_local tskTaskControlBlock* self = nullptr;
+esp_timer* timers[MAX_TIMERS];
+size_t timerCount = 0;
+tskTaskControlBlock* timerTask = nullptr;
+int64_t clockMicros = 0;
+int64_t timeLimit = 3600 * 1000000LL;
+uint64_t sequence = 0;
+const char timersReady = 0; // What the esp_timer task waits on
+
+void timerTaskMain(void*);
+
+tskTaskControlBlock* newTask(const char* name, UBaseType_t priority, BaseType_t core, TaskFunction_t function,
+                             void* arg)
+{
+  if (taskCount == MAX_TASKS) {
+    hostsim::fail("too many tasks");
+  }
+  tskTaskControlBlock* task = new tskTaskControlBlock;
+  strncpy(task->name, name, sizeof(task->name) - 1);
+  task->name[sizeof(task->name) - 1] = 0;
+  task->priority = priority;
+  task->core = core;
+  task->function = function;
+  task->arg = arg;
+  task->readySince = ++sequence;
+  tasks[taskCount++] = task;
+  return task;
+}
+
+void taskEntry(tskTaskControlBlock* task);
+
+// The main thread is the Arduino loop task; the esp_timer task starts with it
+tskTaskControlBlock* current(std::unique_lock<std::mutex>&)
+{
+  if (self == nullptr) {
+    if (running != nullptr) {
+      fprintf(stderr, "hostsim: FreeRTOS called from a thread that is not a task\n");
+      abort();
+    }
+    self = newTask("loopTask", LOOP_TASK_PRIORITY, 1, nullptr, nullptr);
+    running = self;
+    timerTask = newTask("esp_timer", ESP_TIMER_TASK_PRIORITY, 0, timerTaskMain, nullptr);
+    timerTask->ready = false;
+    timerTask->waitingOn = &timersReady;
+    std::thread(taskEntry, timerTask).detach();
+  }
+  return self;
+}
+
+void makeReady(tskTaskControlBlock* task)
+{
+  task->ready = true;
+  task->wakeAt = hostsim::NEVER;
+  task->waitingOn = nullptr;
+  task->readySince = ++sequence;
+}
+
+void wakeWaiters(const void* object)
+{
+  for (size_t i = 0; i < taskCount; i++) {
+    tskTaskControlBlock* task = tasks[i];
+    if (!task->ready && !task->finished && task->waitingOn == object) {
+      makeReady(task);
+    }
+  }
+}
+
+// Runs expired timers' callbacks on the esp_timer task, in expiry order
+void expireTimers(void)
+{
+  bool expired = false;
+  for (size_t i = 0; i < timerCount; i++) {
+    esp_timer* timer = timers[i];
+    if (timer->expiry > clockMicros) {
+      continue;
+    }
+    timer->pending = true;
+    timer->firedSeq = ++sequence;
+    timer->expiry = timer->period > 0 ? timer->expiry + timer->period : hostsim::NEVER;
+    expired = true;
+  }
+  if (expired) {
+    wakeWaiters(&timersReady);
+  }
+}
+
+tskTaskControlBlock* nextReady(void)
+{
+  tskTaskControlBlock* next = nullptr;
+  for (size_t i = 0; i < taskCount; i++) {
+    tskTaskControlBlock* task = tasks[i];
+    if (!task->ready || task->finished) {
+      continue;
+    }
+    if (next == nullptr || task->priority > next->priority ||
+        (task->priority == next->priority && task->readySince < next->readySince)) {
+      next = task;
+    }
+  }
+  return next;
+}
+
+void describeTasks(void)
+{
+  for (size_t i = 0; i < taskCount; i++) {
+    tskTaskControlBlock* task = tasks[i];
+    if (!task->finished) {
+      fprintf(stderr, "  task %-16s priority %2u %s\n", task->name, task->priority,
+              task->ready ? "ready" : task->wakeAt == hostsim::NEVER ? "blocked for good" : "blocked");
+    }
+  }
+}
+
+// Nothing can run: moves the clock to the next timeout or timer
+void advanceClock(void)
+{
+  int64_t next = hostsim::NEVER;
+  for (size_t i = 0; i < taskCount; i++) {
+    tskTaskControlBlock* task = tasks[i];
+    if (!task->ready && !task->finished && task->wakeAt < next) {
+      next = task->wakeAt;
+    }
+  }
+  for (size_t i = 0; i < timerCount; i++) {
+    if (timers[i]->expiry < next) {
+      next = timers[i]->expiry;
+    }
+  }
+  if (next == hostsim::NEVER) {
+    fprintf(stderr, "hostsim: deadlock at %.3f ms, every task is blocked for good\n", clockMicros / 1000.0);
+    describeTasks();
+    abort();
+  }
+  if (next > timeLimit) {
+    fprintf(stderr, "hostsim: time limit of %.3f s reached\n", timeLimit / 1e6);
+    describeTasks();
+    abort();
+  }
+  clockMicros = std::max(clockMicros, next);
+  for (size_t i = 0; i < taskCount; i++) {
+    tskTaskControlBlock* task = tasks[i];
+    if (!task->ready && !task->finished && task->wakeAt <= clockMicros) {
+      makeReady(task);
+    }
+  }
+  expireTimers();
+}
+
+// Hands the CPU to the task that should run, which may be me again, and
+// returns once I am running
+void reschedule(std::unique_lock<std::mutex>& lock, tskTaskControlBlock* me)
+{
+  expireTimers();
+  tskTaskControlBlock* next;
+  while ((next = nextReady()) == nullptr) {
+    advanceClock();
+  }
+  running = next;
+  if (next != me) {
+    next->turn.notify_one();
+  }
+  if (me->finished) {
+    return;
+  }
+  me->turn.wait(lock, [me] { return running == me; });
+  if (me->deleted) {
+    throw TaskExit();
+  }
+}
+
+// A task of higher priority made ready by me runs at once
+void preempt(std::unique_lock<std::mutex>& lock, tskTaskControlBlock* me)
+{
+  tskTaskControlBlock* next = nextReady();
+  if (next != nullptr && next->priority > me->priority) {
+    reschedule(lock, me);
+  }
+}
+
+void block(std::unique_lock<std::mutex>& lock, tskTaskControlBlock* me, const void* object, int64_t deadline)
+{
+  me->ready = false;
+  me->waitingOn = object;
+  me->wakeAt = deadline;
+  reschedule(lock, me);
+}
+
+// FreeRTOS wakes a task on a tick
+int64_t tickDeadline(TickType_t ticks)
+{
+  if (ticks == portMAX_DELAY) {
+    return hostsim::NEVER;
+  }
+  return (clockMicros / 1000 + ticks) * 1000;
+}
+
+void taskEntry(tskTaskControlBlock* task)
+{
+  self = task;
+  {
+    std::unique_lock<std::mutex> lock(kernelLock);
+    task->turn.wait(lock, [task] { return running == task; });
+  }
+  try {
+    if (!task->deleted) {
+      task->function(task->arg);
+      hostsim::fail("task %s returned from its function", task->name);
+    }
+  } catch (TaskExit&) {
+  }
+  std::unique_lock<std::mutex> lock(kernelLock);
+  for (QueueDefinition* mutex : task->held) {
+    if (mutex != nullptr) {
+      fprintf(stderr, "hostsim: task %s deleted while holding a mutex\n", task->name);
+      abort();
+    }
+  }
+  task->finished = true;
+  task->ready = false;
+  reschedule(lock, task);
+}
+
+void timerTaskMain(void*)
+{
+  for (;;) {
+    esp_timer* due = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(kernelLock);
+      tskTaskControlBlock* me = current(lock);
+      for (;;) {
+        for (size_t i = 0; i < timerCount; i++) {
+          if (timers[i]->pending && (due == nullptr || timers[i]->firedSeq < due->firedSeq)) {
+            due = timers[i];
+          }
+        }
+        if (due != nullptr) {
+          break;
+        }
+        block(lock, me, &timersReady, hostsim::NEVER);
+      }
+      due->pending = false;
+    }
+    due->callback(due->arg);
+  }
+}
+
+void noteHeld(tskTaskControlBlock* task, QueueDefinition* mutex, bool held)
+{
+  for (QueueDefinition*& slot : task->held) {
+    if (held ? slot == nullptr : slot == mutex) {
+      slot = held ? mutex : nullptr;
+      return;
+    }
+  }
+  hostsim::fail("task %s holds too many mutexes", task->name);
+}
+
+} // namespace
+
+// --- hostsim ---
+
+int64_t hostsim::now(void)
+{
+  std::unique_lock<std::mutex> lock(kernelLock);
+  return clockMicros;
+}
+
+void hostsim::sleepFor(int64_t micros)
+{
+  std::unique_lock<std::mutex> lock(kernelLock);
+  tskTaskControlBlock* me = current(lock);
+  int64_t deadline = clockMicros + micros;
+  while (clockMicros < deadline) {
+    block(lock, me, nullptr, deadline);
+  }
+}
+
+void hostsim::setTimeLimit(int64_t micros)
+{
+  std::unique_lock<std::mutex> lock(kernelLock);
+  timeLimit = micros;
+}
+
+void hostsim::fail(const char* format, ...)
+{
+  fflush(stdout);
+  va_list args;
+  va_start(args, format);
+  fprintf(stderr, "FAIL at %.3f ms: ", clockMicros / 1000.0);
+  vfprintf(stderr, format, args);
+  fprintf(stderr, "\n");
+  va_end(args);
+  _Exit(1);
+}
+
+void hostsim_log(char level, const char* tag, const char* format, ...)
+{
+  static const bool enabled = getenv("BLE_KEYBOARD_LOG") != nullptr;
+  if (!enabled) {
+    return;
+  }
+  va_list args;
+  va_start(args, format);
+  fprintf(stderr, "%c (%.3f) %s: ", level, clockMicros / 1000.0, tag);
+  vfprintf(stderr, format, args);
+  fprintf(stderr, "\n");
+  va_end(args);
+}
+
+// --- Tasks ---
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackDepth, void* arg,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core)
+{
+  std::unique_lock<std::mutex> lock(kernelLock);
+  tskTaskControlBlock* me = current(lock);
+  tskTaskControlBlock* task = newTask(name, priority, core, function, arg);
+  std::thread(taskEntry, task).detach();
+  if (handle != nullptr) {
+    *handle = task;
+  }
+  preempt(lock, me);
+  return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stackDepth, void* arg,
+                       UBaseType_t priority, TaskHandle_t* handle)
+{
+  return xTaskCreatePinnedToCore(function, name, stackDepth, arg, priority, handle, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+  std::unique_lock<std::mutex> lock(kernelLock);
+  tskTaskControlBlock* me = current(lock);
+  if (task == nullptr || task == me) {
+    throw TaskExit();
+  }
+  // Ends where it stands the next time it runs, whatever it holds
+  task->deleted = true;
+  if (!task->ready) {
+    makeReady(task);
+  }
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+  std::unique_lock<std::mutex> lock(kernelLock);
+  tskTaskControlBlock* me = current(lock);
+  if (ticks == 0) {
+    me->readySince = ++sequence;
+    reschedule(lock, me);
+    return;
+  }
+  block(lock, me, nullptr, tickDeadline(ticks));
+}
+
+void vTaskYield(void)
+{
+  vTaskDelay(0);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+  std::unique_lock<std::mutex> lock(kernelLock);
+  return clockMicros / 1000;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+  std::unique_lock<std::mutex> lock(kernelLock);
+  return current(lock);
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task)
+{
+  std::unique_lock<std::mutex> lock(kernelLock);
+  return (task != nullptr ? task : current(lock))->priority;
+}
+
+const char* pcTaskGetName(TaskHandle_t task)
+{
+  std::unique_lock<std::mutex> lock(kernelLock);
+  return (task != nullptr ? task : current(lock))->name;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks)
+{
+  std::unique_lock<std::mutex> lock(kernelLock);
+  tskTaskControlBlock* me = current(lock);
+  int64_t deadline = tickDeadline(ticks);
+  while (me->notifyValue == 0 && clockMicros < deadline) {
+    block(lock, me, &me->notifyValue, deadline);
+  }
+  uint32_t value = me->notifyValue;
+  if (value > 0) {
+    me->notifyValue = clearOnExit ? 0 : value - 1;
+  }
+  return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+  std::unique_lock<std::mutex> lock(kernelLock);
+  tskTaskControlBlock* me = current(lock);
+  task->notifyValue++;
+  wakeWaiters(&task->notifyValue);
+  preempt(lock, me);
+  return pdPASS;
+}
+
+// --- Semaphores ---
+
+static SemaphoreHandle_t createSemaphore(void* storage, QueueDefinition::Kind kind, UBaseType_t max,
+                                         UBaseType_t initial)
+{
+  QueueDefinition* semaphore = storage != nullptr ? new (storage) QueueDefinition : new QueueDefinition;
+  semaphore->kind = kind;
+  semaphore->isStatic = storage != nullptr;
+  semaphore->count = initial;
+  semaphore->max = max;
+  semaphore->holder = nullptr;
+  return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+  return createSemaphore(nullptr, QueueDefinition::Kind::Binary, 1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t* buffer)
+{
+  return createSemaphore(buffer, QueueDefinition::Kind::Binary, 1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial)
+{
+  return createSemaphore(nullptr, QueueDefinition::Kind::Counting, max, initial);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+  return createSemaphore(nullptr, QueueDefinition::Kind::Mutex, 1, 1);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+  std::unique_lock<std::mutex> lock(kernelLock);
+  tskTaskControlBlock* me = current(lock);
+  bool mutex = semaphore->kind == QueueDefinition::Kind::Mutex;
+  if (mutex && semaphore->holder == me) {
+    fprintf(stderr, "hostsim: deadlock, task %s takes a mutex it already holds\n", me->name);
+    abort();
+  }
+  int64_t deadline = tickDeadline(ticks);
+  int64_t since = clockMicros;
+  while (semaphore->count == 0) {
+    if (clockMicros >= deadline) {
+      return pdFALSE;
+    }
+    if (mutex && clockMicros - since > MUTEX_WAIT_LIMIT_MICROS) {
+      fprintf(stderr, "hostsim: deadlock, task %s waits on a mutex held by %s\n", me->name,
+              semaphore->holder->name);
+      describeTasks();
+      abort();
+    }
+    block(lock, me, semaphore, mutex ? std::min<int64_t>(deadline, clockMicros + MUTEX_WAIT_LIMIT_MICROS + 1) : deadline);
+  }
+  semaphore->count--;
+  if (mutex) {
+    semaphore->holder = me;
+    noteHeld(me, semaphore, true);
+  }
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+  std::unique_lock<std::mutex> lock(kernelLock);
+  tskTaskControlBlock* me = current(lock);
+  if (semaphore->kind == QueueDefinition::Kind::Mutex) {
+    if (semaphore->holder != me) {
+      return pdFALSE;
+    }
+    semaphore->holder = nullptr;
+    noteHeld(me, semaphore, false);
+  }
+  if (semaphore->count >= semaphore->max) {
+    return pdFALSE;
+  }
+  semaphore->count++;
+  wakeWaiters(semaphore);
+  preempt(lock, me);
+  return pdTRUE;
+}
+
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t semaphore)
+{
+  std::unique_lock<std::mutex> lock(kernelLock);
+  return semaphore->count;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+  if (!semaphore->isStatic) {
+    delete semaphore;
+  }
+}
+
+// --- Stream buffers ---
+
+StreamBufferHandle_t xStreamBufferCreate(size_t size, size_t triggerLevel)
+{
+  StreamBufferDef_t* buffer = new StreamBufferDef_t;
+  buffer->data = new uint8_t[size];
+  buffer->size = size;
+  buffer->head = 0;
+  buffer->count = 0;
+  buffer->triggerLevel = triggerLevel != 0 ? triggerLevel : 1;
+  return buffer;
+}
+
+size_t xStreamBufferSend(StreamBufferHandle_t buffer, const void* data, size_t length, TickType_t ticks)
+{
+  std::unique_lock<std::mutex> lock(kernelLock);
+  tskTaskControlBlock* me = current(lock);
+  int64_t deadline = tickDeadline(ticks);
+  while (buffer->count == buffer->size && clockMicros < deadline) {
+    block(lock, me, buffer, deadline);
+  }
+  size_t sent = std::min(length, buffer->size - buffer->count);
+  for (size_t i = 0; i < sent; i++) {
+    buffer->data[(buffer->head + buffer->count + i) % buffer->size] = static_cast<const uint8_t*>(data)[i];
+  }
+  buffer->count += sent;
+  if (sent > 0) {
+    wakeWaiters(buffer);
+    preempt(lock, me);
+  }
+  return sent;
+}
+
+size_t xStreamBufferReceive(StreamBufferHandle_t buffer, void* data, size_t length, TickType_t ticks)
+{
+  std::unique_lock<std::mutex> lock(kernelLock);
+  tskTaskControlBlock* me = current(lock);
+  int64_t deadline = tickDeadline(ticks);
+  while (buffer->count < std::min(buffer->triggerLevel, length) && clockMicros < deadline) {
+    block(lock, me, buffer, deadline);
+  }
+  size_t received = std::min(length, buffer->count);
+  for (size_t i = 0; i < received; i++) {
+    static_cast<uint8_t*>(data)[i] = buffer->data[(buffer->head + i) % buffer->size];
+  }
+  buffer->head = (buffer->head + received) % buffer->size;
+  buffer->count -= received;
+  if (received > 0) {
+    wakeWaiters(buffer);
+    preempt(lock, me);
+  }
+  return received;
+}
+
+size_t xStreamBufferSpacesAvailable(StreamBufferHandle_t buffer)
+{
+  std::unique_lock<std::mutex> lock(kernelLock);
+  return buffer->size - buffer->count;
+}
+
+size_t xStreamBufferBytesAvailable(StreamBufferHandle_t buffer)
+{
+  std::unique_lock<std::mutex> lock(kernelLock);
+  return buffer->count;
+}
+
+BaseType_t xStreamBufferIsEmpty(StreamBufferHandle_t buffer)
+{
+  return xStreamBufferBytesAvailable(buffer) == 0 ? pdTRUE : pdFALSE;
+}
+
+void vStreamBufferDelete(StreamBufferHandle_t buffer)
+{
+  std::unique_lock<std::mutex> lock(kernelLock);
+  for (size_t i = 0; i < taskCount; i++) {
+    if (!tasks[i]->finished && tasks[i]->waitingOn == buffer) {
+      fprintf(stderr, "hostsim: stream buffer deleted while task %s waits on it\n", tasks[i]->name);
+      abort();
+    }
+  }
+  delete[] buffer->data;
+  delete buffer;
+}
+
+// --- esp_timer ---
+
+int64_t esp_timer_get_time(void)
+{
+  return hostsim::now();
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* handle)
+{
+  std::unique_lock<std::mutex> lock(kernelLock);
+  current(lock);
+  if (timerCount == MAX_TIMERS) {
+    return ESP_ERR_NO_MEM;
+  }
+  esp_timer* timer = new esp_timer;
+  timer->callback = args->callback;
+  timer->arg = args->arg;
+  timer->name = args->name;
+  timer->expiry = hostsim::NEVER;
+  timer->period = 0;
+  timer->pending = false;
+  timer->firedSeq = 0;
+  timers[timerCount++] = timer;
+  *handle = timer;
+  return ESP_OK;
+}
+
+static esp_err_t startTimer(esp_timer_handle_t timer, uint64_t micros, bool periodic)
+{
+  std::unique_lock<std::mutex> lock(kernelLock);
+  tskTaskControlBlock* me = current(lock);
+  if (timer->expiry != hostsim::NEVER) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->expiry = clockMicros + micros;
+  timer->period = periodic ? micros : 0;
+  if (micros == 0) {
+    expireTimers();
+    preempt(lock, me);
+  }
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeoutMicros)
+{
+  return startTimer(timer, timeoutMicros, false);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t periodMicros)
+{
+  return startTimer(timer, periodMicros, true);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+  std::unique_lock<std::mutex> lock(kernelLock);
+  if (timer->expiry == hostsim::NEVER) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->expiry = hostsim::NEVER;
+  timer->pending = false;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+  std::unique_lock<std::mutex> lock(kernelLock);
+  if (timer->expiry != hostsim::NEVER) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  for (size_t i = 0; i < timerCount; i++) {
+    if (timers[i] == timer) {
+      timers[i] = timers[--timerCount];
+      break;
+    }
+  }
+  delete timer;
+  return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+  std::unique_lock<std::mutex> lock(kernelLock);
+  return timer->expiry != hostsim::NEVER;
+}
@@ -0,0 +1,94 @@
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+// Host simulation of the ESP32 environment the library runs in, for tests.
+//
+// FreeRTOS tasks are threads of which only one runs at a time, as on a single
+// core: a task runs until it blocks, yields, or makes a task of higher priority
+// ready. Time is a virtual clock in microseconds that only moves when every
+// task is blocked, straight to the next timeout or esp_timer, so a test runs
+// as fast as the CPU allows and always the same way. A task that blocks for
+// good with nothing left to wake it, or takes a mutex it holds, fails the test.
+//
+// The BLE side is a fake NimBLE stack and controller: centrals connect and
+// subscribe when a test says so, notifications take an mbuf from a small pool
+// until a connection event carries them to the central, whose HID stack echoes
+// CapsLock, NumLock and ScrollLock in its LED output report.
+
+#include <stdint.h>
+#include <stddef.h>
+#include "NimBLEAddress.h"
+
+namespace hostsim {
+
+const int64_t NEVER = INT64_MAX;
+
+// Virtual time in microseconds since start-up
+int64_t now(void);
+
+// Blocks the calling task for the given virtual time
+void sleepFor(int64_t micros);
+
+// Fails the test once virtual time gets this far, in case a bug keeps timers
+// going with no progress (default: one hour)
+void setTimeLimit(int64_t micros);
+
+[[noreturn]] void fail(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+// --- Fake BLE controller and centrals ---
+
+struct CapturedReport
+{
+  int64_t micros;  // When the central received it
+  uint8_t length;
+  uint8_t data[17];
+};
+
+struct AdvertisingState
+{
+  bool active;
+  bool directed;
+  NimBLEAddress peer; // Of directed advertising
+  uint32_t durationMs; // 0: until stopped
+  int64_t started;
+};
+
+struct CentralOptions
+{
+  bool bonded = false;
+  uint16_t interval = 12; // Connection interval, units of 1.25 ms
+  uint16_t latency = 0;
+  uint8_t leds = 0;       // LED state the central reports once subscribed
+  bool echoLeds = true;   // Toggles its lock LEDs when it sees the lock keys pressed
+};
+
+// Connects a central while the keyboard advertises (to that central, for
+// directed advertising). Returns its connection handle, or
+// BLE_HS_CONN_HANDLE_NONE if the keyboard is not advertising to it.
+uint16_t connect(const NimBLEAddress& address, const CentralOptions& options = CentralOptions());
+// Enables notifications on the input report and sends the central's LED state
+void subscribe(uint16_t connHandle);
+void disconnect(uint16_t connHandle, int reason = 0x08); // Supervision timeout by default
+void setLeds(uint16_t connHandle, uint8_t leds); // Writes the LED output report
+uint8_t getLeds(uint16_t connHandle);
+// A stalled link carries nothing, as when the central is out of range
+void setStalled(uint16_t connHandle, bool stalled);
+// Notifications a connection event carries, per link (default 6)
+void setPacketsPerEvent(size_t packets);
+uint16_t getConnInterval(uint16_t connHandle);
+void addBond(const NimBLEAddress& address);
+
+size_t reportCount(uint16_t connHandle);
+const CapturedReport& report(uint16_t connHandle, size_t index);
+void clearReports(uint16_t connHandle);
+
+void setMbufCount(int count); // Size of the mbuf pool, before the first notification (default 12)
+int freeMbufs(void);
+size_t notifyTxEvents(void); // BLE_GAP_EVENT_NOTIFY_TX events delivered so far
+
+AdvertisingState advertising(void);
+const uint8_t* reportMap(size_t* size);
+
+} // namespace hostsim
+
+#endif // HOST_SIM_H
@@ -0,0 +1,24 @@
+#ifndef HOST_NIMBLE_ADDRESS_H
+#define HOST_NIMBLE_ADDRESS_H
+
+#include <stdint.h>
+#include <string>
+
+class NimBLEAddress
+{
+public:
+  NimBLEAddress() = default;
+  NimBLEAddress(const std::string& address, uint8_t type = 0); // "aa:bb:cc:dd:ee:ff"
+
+  bool isNull() const;
+  uint8_t getType() const { return _type; }
+  std::string toString() const;
+  bool operator==(const NimBLEAddress& other) const;
+  bool operator!=(const NimBLEAddress& other) const { return !(*this == other); }
+
+private:
+  uint8_t _value[6] = {};
+  uint8_t _type = 0;
+};
+
+#endif // HOST_NIMBLE_ADDRESS_H
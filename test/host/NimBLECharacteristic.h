@@ -0,0 +1,81 @@
+#ifndef HOST_NIMBLE_CHARACTERISTIC_H
+#define HOST_NIMBLE_CHARACTERISTIC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include "NimBLEConnInfo.h"
+#include "NimBLEUUID.h"
+
+namespace NIMBLE_PROPERTY {
+enum : uint32_t {
+  READ = 0x0002,
+  WRITE_NR = 0x0004,
+  WRITE = 0x0008,
+  NOTIFY = 0x0010,
+  INDICATE = 0x0020,
+  READ_ENC = 0x0200,
+  WRITE_ENC = 0x1000
+};
+}
+
+class NimBLECharacteristic;
+
+class NimBLECharacteristicCallbacks
+{
+public:
+  virtual ~NimBLECharacteristicCallbacks() {}
+  virtual void onRead(NimBLECharacteristic* pCharacteristic, NimBLEConnInfo& connInfo) {}
+  virtual void onWrite(NimBLECharacteristic* pCharacteristic, NimBLEConnInfo& connInfo) {}
+  virtual void onStatus(NimBLECharacteristic* pCharacteristic, int code) {}
+  virtual void onSubscribe(NimBLECharacteristic* pCharacteristic, NimBLEConnInfo& connInfo, uint16_t subValue) {}
+};
+
+class NimBLECharacteristic
+{
+public:
+  static const size_t MAX_LENGTH = 64;
+
+  NimBLECharacteristic(const NimBLEUUID& uuid, uint32_t properties, uint16_t handle)
+      : _uuid(uuid), _properties(properties), _handle(handle) {}
+
+  void setValue(const uint8_t* data, size_t length)
+  {
+    _length = length < MAX_LENGTH ? length : MAX_LENGTH;
+    memcpy(_value, data, _length);
+  }
+
+  template <typename T>
+  void setValue(const T& value)
+  {
+    setValue((const uint8_t*)&value, sizeof(T));
+  }
+
+  template <typename T>
+  T getValue(time_t* timestamp = nullptr, bool skipSizeCheck = false) const
+  {
+    T value{};
+    if (skipSizeCheck || _length >= sizeof(T)) {
+      memcpy(&value, _value, _length < sizeof(T) ? _length : sizeof(T));
+    }
+    return value;
+  }
+
+  const uint8_t* getData() const { return _value; }
+  uint16_t getLength() const { return _length; }
+  uint16_t getHandle() const { return _handle; }
+  NimBLEUUID getUUID() const { return _uuid; }
+  void setCallbacks(NimBLECharacteristicCallbacks* callbacks) { _callbacks = callbacks; }
+  NimBLECharacteristicCallbacks* getCallbacks() const { return _callbacks; }
+
+private:
+  NimBLEUUID _uuid;
+  uint32_t _properties;
+  uint16_t _handle;
+  uint8_t _value[MAX_LENGTH] = {};
+  uint16_t _length = 0;
+  NimBLECharacteristicCallbacks* _callbacks = nullptr;
+};
+
+#endif // HOST_NIMBLE_CHARACTERISTIC_H
@@ -0,0 +1,35 @@
+#ifndef HOST_NIMBLE_CONN_INFO_H
+#define HOST_NIMBLE_CONN_INFO_H
+
+#include "NimBLEAddress.h"
+
+class NimBLEConnInfo
+{
+public:
+  NimBLEConnInfo() = default;
+  NimBLEConnInfo(uint16_t connHandle, const NimBLEAddress& idAddress, bool bonded, uint16_t interval,
+                 uint16_t latency, uint16_t timeout)
+      : _connHandle(connHandle), _idAddress(idAddress), _bonded(bonded), _interval(interval), _latency(latency),
+        _timeout(timeout) {}
+
+  NimBLEAddress getAddress() const { return _idAddress; }
+  NimBLEAddress getIdAddress() const { return _idAddress; }
+  uint16_t getConnHandle() const { return _connHandle; }
+  uint16_t getConnInterval() const { return _interval; }
+  uint16_t getConnTimeout() const { return _timeout; }
+  uint16_t getConnLatency() const { return _latency; }
+  uint16_t getMTU() const { return 23; }
+  bool isBonded() const { return _bonded; }
+  bool isEncrypted() const { return _bonded; }
+  bool isAuthenticated() const { return false; }
+
+private:
+  uint16_t _connHandle = 0xffff;
+  NimBLEAddress _idAddress;
+  bool _bonded = false;
+  uint16_t _interval = 0;
+  uint16_t _latency = 0;
+  uint16_t _timeout = 0;
+};
+
+#endif // HOST_NIMBLE_CONN_INFO_H
@@ -0,0 +1,27 @@
+#ifndef HOST_NIMBLE_DEVICE_H
+#define HOST_NIMBLE_DEVICE_H
+
+#include <string>
+#include "Arduino.h" // Pulled in by NimBLE-Arduino's logging on the device
+#include "NimBLEServer.h"
+#include "NimBLEHIDDevice.h"
+
+typedef int (*gap_event_handler)(ble_gap_event* event, void* arg);
+
+class NimBLEDevice
+{
+public:
+  static bool init(const std::string& deviceName);
+  static NimBLEServer* createServer();
+  static NimBLEServer* getServer();
+  static NimBLEAdvertising* getAdvertising();
+  static void setSecurityAuth(bool bonding, bool mitm, bool sc) {}
+  static int getNumBonds();
+  static NimBLEAddress getBondedAddress(int index);
+  static bool isBonded(const NimBLEAddress& address);
+  static bool setCustomGapHandler(gap_event_handler handler);
+};
+
+typedef NimBLEDevice BLEDevice;
+
+#endif // HOST_NIMBLE_DEVICE_H
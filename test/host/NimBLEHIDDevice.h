@@ -0,0 +1,30 @@
+#ifndef HOST_NIMBLE_HID_DEVICE_H
+#define HOST_NIMBLE_HID_DEVICE_H
+
+#include <stdint.h>
+#include <string>
+#include "NimBLEServer.h"
+#include "NimBLECharacteristic.h"
+
+#define HID_KEYBOARD 0x03C1
+
+class NimBLEHIDDevice
+{
+public:
+  explicit NimBLEHIDDevice(NimBLEServer* server);
+
+  NimBLECharacteristic* getInputReport(uint8_t reportId);
+  NimBLECharacteristic* getOutputReport(uint8_t reportId);
+  void setManufacturer(const std::string& name) {}
+  void setPnp(uint8_t sig, uint16_t vid, uint16_t pid, uint16_t version) {}
+  void setHidInfo(uint8_t country, uint8_t flags) {}
+  void setReportMap(uint8_t* map, uint16_t size);
+  void startServices() {}
+  void setBatteryLevel(uint8_t level, bool notify = false) {}
+  NimBLEService* getHidService();
+
+private:
+  NimBLEService _hidService;
+};
+
+#endif // HOST_NIMBLE_HID_DEVICE_H
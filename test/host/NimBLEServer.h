@@ -0,0 +1,66 @@
+#ifndef HOST_NIMBLE_SERVER_H
+#define HOST_NIMBLE_SERVER_H
+
+#include <stdint.h>
+#include <functional>
+#include <vector>
+#include "nimble/nimble/host/include/host/ble_hs.h"
+#include "NimBLEAddress.h"
+#include "NimBLEConnInfo.h"
+#include "NimBLEUUID.h"
+#include "NimBLECharacteristic.h"
+
+class NimBLEServer;
+
+class NimBLEServerCallbacks
+{
+public:
+  virtual ~NimBLEServerCallbacks() {}
+  virtual void onConnect(NimBLEServer* pServer, NimBLEConnInfo& connInfo) {}
+  virtual void onDisconnect(NimBLEServer* pServer, NimBLEConnInfo& connInfo, int reason) {}
+  virtual void onConnParamsUpdate(NimBLEConnInfo& connInfo) {}
+};
+
+class NimBLEService
+{
+public:
+  explicit NimBLEService(const NimBLEUUID& uuid) : _uuid(uuid) {}
+  NimBLECharacteristic* createCharacteristic(const NimBLEUUID& uuid, uint32_t properties, uint16_t maxLength = 20);
+  bool start() { return true; }
+  NimBLEUUID getUUID() const { return _uuid; }
+
+private:
+  NimBLEUUID _uuid;
+};
+
+class NimBLEAdvertising
+{
+public:
+  using advCompleteCB_t = std::function<void(NimBLEAdvertising*)>;
+
+  bool start(uint32_t duration = 0, const NimBLEAddress* dirAddr = nullptr);
+  bool stop();
+  bool isAdvertising();
+  void setAppearance(uint16_t appearance) {}
+  void addServiceUUID(const NimBLEUUID& uuid) {}
+  void setMinInterval(uint16_t interval);
+  void setMaxInterval(uint16_t interval) {}
+  bool setConnectableMode(uint8_t mode);
+  void setAdvertisingCompleteCallback(advCompleteCB_t callback);
+};
+
+class NimBLEServer
+{
+public:
+  void setCallbacks(NimBLEServerCallbacks* callbacks, bool deleteCallbacks = true);
+  NimBLEServerCallbacks* getCallbacks() const;
+  NimBLEAdvertising* getAdvertising();
+  void advertiseOnDisconnect(bool enabled) {}
+  NimBLEService* createService(const NimBLEUUID& uuid);
+  void updateConnParams(uint16_t connHandle, uint16_t minInterval, uint16_t maxInterval, uint16_t latency,
+                        uint16_t timeout) const;
+  bool disconnect(uint16_t connHandle, uint8_t reason = 0x13) const;
+  uint8_t getConnectedCount() const;
+};
+
+#endif // HOST_NIMBLE_SERVER_H
@@ -0,0 +1,687 @@
+// Fake NimBLE stack, controller and centrals, see HostSim.h
+
+#include "HostSim.h"
+
+#include "NimBLEDevice.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_LINKS 4
+#define MAX_MBUFS 64
+#define TX_QUEUE_SIZE MAX_MBUFS
+#define CAPTURE_SIZE 65536
+#define MAX_CHARACTERISTICS 16
+#define SUPERVISION_TIMEOUT 400 // Units of 10 ms
+
+#define LED_NUM_LOCK    0x01
+#define LED_CAPS_LOCK   0x02
+#define LED_SCROLL_LOCK 0x04
+
+#define USAGE_CAPS_LOCK   0x39
+#define USAGE_SCROLL_LOCK 0x47
+#define USAGE_NUM_LOCK    0x53
+
+struct os_mbuf
+{
+  uint8_t data[NimBLECharacteristic::MAX_LENGTH];
+  uint16_t length;
+  bool used;
+};
+
+namespace {
+
+struct Link
+{
+  bool connected;
+  uint16_t connHandle;
+  NimBLEAddress address;
+  hostsim::CentralOptions options;
+  bool subscribed;
+  bool stalled;
+  bool disconnectPending;
+  uint16_t interval;
+  uint16_t pendingInterval; // 0: no update requested
+  uint16_t pendingLatency;
+  uint8_t leds;
+  bool ledsChanged;         // Written at the next connection event
+  bool locksDown[3];        // CapsLock, ScrollLock, NumLock held in the last report
+  esp_timer_handle_t timer;
+  os_mbuf* tx[TX_QUEUE_SIZE];
+  size_t txHead;
+  size_t txCount;
+  size_t captured;
+  hostsim::CapturedReport* reports;
+};
+
+os_mbuf mbufs[MAX_MBUFS];
+int mbufCount = 12;
+size_t notifyTx = 0;
+size_t packetsPerEvent = 6;
+Link links[MAX_LINKS];
+
+NimBLEServer server;
+NimBLEServerCallbacks* serverCallbacks = nullptr;
+NimBLEAdvertising advertisingInstance;
+NimBLEAdvertising::advCompleteCB_t advertisingCompleteCallback;
+gap_event_handler gapHandler = nullptr;
+hostsim::AdvertisingState advertisingState = {};
+esp_timer_handle_t advertisingTimer = nullptr;
+esp_timer_handle_t disconnectTimer = nullptr;
+NimBLEHIDDevice* hidDevice = nullptr;
+NimBLECharacteristic* characteristics[MAX_CHARACTERISTICS];
+size_t characteristicCount = 0;
+const uint8_t* reportMapData = nullptr;
+size_t reportMapSize = 0;
+NimBLEAddress bonds[8];
+int bondCount = 0;
+
+Link* findLink(uint16_t connHandle)
+{
+  for (Link& link : links) {
+    if (link.connected && link.connHandle == connHandle) {
+      return &link;
+    }
+  }
+  return nullptr;
+}
+
+Link& requireLink(uint16_t connHandle)
+{
+  Link* link = findLink(connHandle);
+  if (link == nullptr) {
+    hostsim::fail("no connection with handle %u", connHandle);
+  }
+  return *link;
+}
+
+NimBLEConnInfo connInfo(const Link& link)
+{
+  return NimBLEConnInfo(link.connHandle, link.address, link.options.bonded, link.interval, link.options.latency,
+                        SUPERVISION_TIMEOUT);
+}
+
+NimBLECharacteristic* newCharacteristic(const NimBLEUUID& uuid, uint32_t properties)
+{
+  if (characteristicCount == MAX_CHARACTERISTICS) {
+    hostsim::fail("too many characteristics");
+  }
+  NimBLECharacteristic* characteristic = new NimBLECharacteristic(uuid, properties, 0x10 + characteristicCount);
+  characteristics[characteristicCount++] = characteristic;
+  return characteristic;
+}
+
+NimBLECharacteristic* findCharacteristic(uint16_t handle)
+{
+  for (size_t i = 0; i < characteristicCount; i++) {
+    if (characteristics[i]->getHandle() == handle) {
+      return characteristics[i];
+    }
+  }
+  return nullptr;
+}
+
+void freeMbuf(os_mbuf* om)
+{
+  om->used = false;
+}
+
+void stopAdvertising(int reason)
+{
+  if (!advertisingState.active) {
+    return;
+  }
+  advertisingState.active = false;
+  esp_timer_stop(advertisingTimer);
+  if (gapHandler != nullptr) {
+    ble_gap_event event = {};
+    event.type = BLE_GAP_EVENT_ADV_COMPLETE;
+    event.adv_complete.reason = reason;
+    gapHandler(&event, nullptr);
+  }
+  if (advertisingCompleteCallback) {
+    advertisingCompleteCallback(&advertisingInstance);
+  }
+}
+
+void advertisingTimeout(void*)
+{
+  stopAdvertising(BLE_HS_ETIMEOUT);
+}
+
+void writeLeds(Link& link)
+{
+  NimBLECharacteristic* output = hidDevice->getOutputReport(1);
+  output->setValue(&link.leds, 1);
+  NimBLEConnInfo info = connInfo(link);
+  if (output->getCallbacks() != nullptr) {
+    output->getCallbacks()->onWrite(output, info);
+  }
+}
+
+bool keyDown(const hostsim::CapturedReport& report, uint8_t usage)
+{
+  if (report.length == 8) { // Boot report: modifiers, reserved, 6 keys
+    return memchr(report.data + 2, usage, 6) != nullptr;
+  }
+  return (report.data[1 + usage / 8] >> (usage % 8)) & 1;
+}
+
+// The central's HID stack: a lock key going down toggles its LED, which it
+// writes back in the LED output report
+void receive(Link& link, const hostsim::CapturedReport& report)
+{
+  static const uint8_t usages[3] = {USAGE_CAPS_LOCK, USAGE_SCROLL_LOCK, USAGE_NUM_LOCK};
+  static const uint8_t leds[3] = {LED_CAPS_LOCK, LED_SCROLL_LOCK, LED_NUM_LOCK};
+  for (size_t i = 0; i < 3; i++) {
+    bool down = keyDown(report, usages[i]);
+    if (down && !link.locksDown[i] && link.options.echoLeds) {
+      link.leds ^= leds[i];
+      link.ledsChanged = true;
+    }
+    link.locksDown[i] = down;
+  }
+}
+
+void connectionEvent(void* arg)
+{
+  Link& link = *static_cast<Link*>(arg);
+  if (!link.connected || link.stalled) {
+    return;
+  }
+  if (link.ledsChanged) {
+    link.ledsChanged = false;
+    writeLeds(link);
+  }
+  for (size_t packets = 0; packets < packetsPerEvent && link.txCount > 0; packets++) {
+    os_mbuf* om = link.tx[link.txHead];
+    link.txHead = (link.txHead + 1) % TX_QUEUE_SIZE;
+    link.txCount--;
+    hostsim::CapturedReport report = {};
+    report.micros = esp_timer_get_time();
+    report.length = om->length;
+    memcpy(report.data, om->data, std::min<size_t>(om->length, sizeof(report.data)));
+    freeMbuf(om);
+    if (link.captured < CAPTURE_SIZE) {
+      link.reports[link.captured] = report;
+    }
+    link.captured++;
+    receive(link, report);
+  }
+  if (link.pendingInterval != 0) {
+    link.interval = link.pendingInterval;
+    link.options.latency = link.pendingLatency;
+    link.pendingInterval = 0;
+    esp_timer_stop(link.timer);
+    esp_timer_start_periodic(link.timer, link.interval * 1250);
+    NimBLEConnInfo info = connInfo(link);
+    serverCallbacks->onConnParamsUpdate(info);
+  }
+}
+
+void dropLink(Link& link, int reason)
+{
+  link.connected = false;
+  esp_timer_stop(link.timer);
+  while (link.txCount > 0) {
+    freeMbuf(link.tx[link.txHead]);
+    link.txHead = (link.txHead + 1) % TX_QUEUE_SIZE;
+    link.txCount--;
+  }
+  NimBLEConnInfo info = connInfo(link);
+  serverCallbacks->onDisconnect(&server, info, reason);
+}
+
+void deferredDisconnects(void*)
+{
+  for (Link& link : links) {
+    if (link.connected && link.disconnectPending) {
+      link.disconnectPending = false;
+      dropLink(link, 0x216); // BLE_HS_ERR_HCI_BASE + local host terminated
+    }
+  }
+}
+
+esp_timer_handle_t newTimer(esp_timer_cb_t callback, void* arg, const char* name)
+{
+  esp_timer_create_args_t args = {};
+  args.callback = callback;
+  args.arg = arg;
+  args.name = name;
+  esp_timer_handle_t timer;
+  esp_timer_create(&args, &timer);
+  return timer;
+}
+
+} // namespace
+
+// --- NimBLEAddress ---
+
+NimBLEAddress::NimBLEAddress(const std::string& address, uint8_t type) : _type(type)
+{
+  unsigned int bytes[6] = {};
+  sscanf(address.c_str(), "%x:%x:%x:%x:%x:%x", &bytes[5], &bytes[4], &bytes[3], &bytes[2], &bytes[1], &bytes[0]);
+  for (size_t i = 0; i < 6; i++) {
+    _value[i] = bytes[i];
+  }
+}
+
+bool NimBLEAddress::isNull() const
+{
+  static const uint8_t zero[6] = {};
+  return memcmp(_value, zero, sizeof(_value)) == 0;
+}
+
+std::string NimBLEAddress::toString() const
+{
+  char text[18];
+  snprintf(text, sizeof(text), "%02x:%02x:%02x:%02x:%02x:%02x", _value[5], _value[4], _value[3], _value[2],
+           _value[1], _value[0]);
+  return text;
+}
+
+bool NimBLEAddress::operator==(const NimBLEAddress& other) const
+{
+  return memcmp(_value, other._value, sizeof(_value)) == 0 && _type == other._type;
+}
+
+// --- Services and the HID device ---
+
+NimBLECharacteristic* NimBLEService::createCharacteristic(const NimBLEUUID& uuid, uint32_t properties,
+                                                         uint16_t maxLength)
+{
+  return newCharacteristic(uuid, properties);
+}
+
+NimBLEHIDDevice::NimBLEHIDDevice(NimBLEServer* server) : _hidService((uint16_t)0x1812)
+{
+  hidDevice = this;
+  newCharacteristic((uint16_t)0x2a4d, NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::NOTIFY);
+  newCharacteristic((uint16_t)0x2a4d, NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::WRITE_NR);
+}
+
+NimBLECharacteristic* NimBLEHIDDevice::getInputReport(uint8_t reportId)
+{
+  return characteristics[0];
+}
+
+NimBLECharacteristic* NimBLEHIDDevice::getOutputReport(uint8_t reportId)
+{
+  return characteristics[1];
+}
+
+void NimBLEHIDDevice::setReportMap(uint8_t* map, uint16_t size)
+{
+  reportMapData = map;
+  reportMapSize = size;
+}
+
+NimBLEService* NimBLEHIDDevice::getHidService()
+{
+  return &_hidService;
+}
+
+// --- Advertising ---
+
+bool NimBLEAdvertising::start(uint32_t duration, const NimBLEAddress* dirAddr)
+{
+  if (advertisingState.active) {
+    return false;
+  }
+  if (advertisingTimer == nullptr) {
+    advertisingTimer = newTimer(advertisingTimeout, nullptr, "advertising");
+  }
+  advertisingState.active = true;
+  advertisingState.directed = dirAddr != nullptr;
+  advertisingState.peer = dirAddr != nullptr ? *dirAddr : NimBLEAddress();
+  advertisingState.durationMs = duration;
+  advertisingState.started = esp_timer_get_time();
+  if (duration > 0) {
+    esp_timer_start_once(advertisingTimer, duration * 1000ULL);
+  }
+  return true;
+}
+
+bool NimBLEAdvertising::stop()
+{
+  // Stopped by the application: no ADV_COMPLETE event
+  advertisingState.active = false;
+  if (advertisingTimer != nullptr) {
+    esp_timer_stop(advertisingTimer);
+  }
+  return true;
+}
+
+bool NimBLEAdvertising::isAdvertising()
+{
+  return advertisingState.active;
+}
+
+void NimBLEAdvertising::setMinInterval(uint16_t interval) {}
+
+bool NimBLEAdvertising::setConnectableMode(uint8_t mode)
+{
+  return true;
+}
+
+void NimBLEAdvertising::setAdvertisingCompleteCallback(advCompleteCB_t callback)
+{
+  advertisingCompleteCallback = callback;
+}
+
+// --- Server ---
+
+void NimBLEServer::setCallbacks(NimBLEServerCallbacks* callbacks, bool deleteCallbacks)
+{
+  serverCallbacks = callbacks;
+}
+
+NimBLEServerCallbacks* NimBLEServer::getCallbacks() const
+{
+  return serverCallbacks;
+}
+
+NimBLEAdvertising* NimBLEServer::getAdvertising()
+{
+  return &advertisingInstance;
+}
+
+NimBLEService* NimBLEServer::createService(const NimBLEUUID& uuid)
+{
+  return new NimBLEService(uuid);
+}
+
+void NimBLEServer::updateConnParams(uint16_t connHandle, uint16_t minInterval, uint16_t maxInterval,
+                                    uint16_t latency, uint16_t timeout) const
+{
+  Link* link = findLink(connHandle);
+  if (link != nullptr) {
+    link->pendingInterval = minInterval;
+    link->pendingLatency = latency;
+  }
+}
+
+bool NimBLEServer::disconnect(uint16_t connHandle, uint8_t reason) const
+{
+  Link* link = findLink(connHandle);
+  if (link == nullptr) {
+    return false;
+  }
+  if (disconnectTimer == nullptr) {
+    disconnectTimer = newTimer(deferredDisconnects, nullptr, "disconnect");
+  }
+  link->disconnectPending = true;
+  esp_timer_start_once(disconnectTimer, 0); // Fails harmlessly while one is pending
+  return true;
+}
+
+uint8_t NimBLEServer::getConnectedCount() const
+{
+  uint8_t count = 0;
+  for (const Link& link : links) {
+    count += link.connected;
+  }
+  return count;
+}
+
+// --- Device ---
+
+bool NimBLEDevice::init(const std::string& deviceName)
+{
+  return true;
+}
+
+NimBLEServer* NimBLEDevice::createServer()
+{
+  return &server;
+}
+
+NimBLEServer* NimBLEDevice::getServer()
+{
+  return &server;
+}
+
+NimBLEAdvertising* NimBLEDevice::getAdvertising()
+{
+  return &advertisingInstance;
+}
+
+int NimBLEDevice::getNumBonds()
+{
+  return bondCount;
+}
+
+NimBLEAddress NimBLEDevice::getBondedAddress(int index)
+{
+  return index >= 0 && index < bondCount ? bonds[index] : NimBLEAddress();
+}
+
+bool NimBLEDevice::isBonded(const NimBLEAddress& address)
+{
+  for (int i = 0; i < bondCount; i++) {
+    if (bonds[i] == address) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool NimBLEDevice::setCustomGapHandler(gap_event_handler handler)
+{
+  gapHandler = handler;
+  return true;
+}
+
+// --- Host calls ---
+
+int os_msys_num_free(void)
+{
+  int free = 0;
+  for (int i = 0; i < mbufCount; i++) {
+    free += !mbufs[i].used;
+  }
+  return free;
+}
+
+os_mbuf* ble_hs_mbuf_from_flat(const void* buffer, uint16_t length)
+{
+  for (int i = 0; i < mbufCount; i++) {
+    if (!mbufs[i].used && length <= sizeof(mbufs[i].data)) {
+      mbufs[i].used = true;
+      mbufs[i].length = length;
+      memcpy(mbufs[i].data, buffer, length);
+      return &mbufs[i];
+    }
+  }
+  return nullptr;
+}
+
+// As in NimBLE, the NOTIFY_TX event for the notification reaches the
+// characteristic's onStatus() before this returns
+int ble_gatts_notify_custom(uint16_t connHandle, uint16_t attrHandle, os_mbuf* om)
+{
+  int rc = 0;
+  Link* link = findLink(connHandle);
+  if (om == nullptr) {
+    rc = BLE_HS_ENOMEM;
+  } else if (link == nullptr) {
+    rc = BLE_HS_ENOTCONN;
+    freeMbuf(om);
+  } else {
+    link->tx[(link->txHead + link->txCount) % TX_QUEUE_SIZE] = om;
+    link->txCount++;
+  }
+  NimBLECharacteristic* characteristic = findCharacteristic(attrHandle);
+  notifyTx++;
+  if (characteristic != nullptr && characteristic->getCallbacks() != nullptr) {
+    characteristic->getCallbacks()->onStatus(characteristic, rc);
+  }
+  return rc;
+}
+
+// --- Test control ---
+
+uint16_t hostsim::connect(const NimBLEAddress& address, const CentralOptions& options)
+{
+  if (!advertisingState.active || (advertisingState.directed && advertisingState.peer != address)) {
+    return BLE_HS_CONN_HANDLE_NONE;
+  }
+  uint16_t connHandle = 0;
+  while (findLink(connHandle) != nullptr) {
+    connHandle++;
+  }
+  Link* link = nullptr;
+  for (Link& candidate : links) {
+    if (!candidate.connected) {
+      link = &candidate;
+      break;
+    }
+  }
+  if (link == nullptr) {
+    return BLE_HS_CONN_HANDLE_NONE;
+  }
+  if (link->reports == nullptr) {
+    link->reports = new CapturedReport[CAPTURE_SIZE];
+    link->timer = newTimer(connectionEvent, link, "connection");
+  }
+  link->connected = true;
+  link->connHandle = connHandle;
+  link->address = address;
+  link->options = options;
+  link->subscribed = false;
+  link->stalled = false;
+  link->disconnectPending = false;
+  link->interval = options.interval;
+  link->pendingInterval = 0;
+  link->leds = options.leds;
+  link->ledsChanged = false;
+  memset(link->locksDown, 0, sizeof(link->locksDown));
+  link->txHead = 0;
+  link->txCount = 0;
+  link->captured = 0;
+  if (options.bonded) {
+    addBond(address);
+  }
+  esp_timer_start_periodic(link->timer, link->interval * 1250);
+  stopAdvertising(0);
+  NimBLEConnInfo info = connInfo(*link);
+  serverCallbacks->onConnect(&server, info);
+  return connHandle;
+}
+
+void hostsim::subscribe(uint16_t connHandle)
+{
+  Link& link = requireLink(connHandle);
+  link.subscribed = true;
+  NimBLECharacteristic* input = hidDevice->getInputReport(1);
+  NimBLEConnInfo info = connInfo(link);
+  input->getCallbacks()->onSubscribe(input, info, 1);
+  writeLeds(link);
+}
+
+void hostsim::disconnect(uint16_t connHandle, int reason)
+{
+  dropLink(requireLink(connHandle), reason);
+}
+
+void hostsim::setLeds(uint16_t connHandle, uint8_t leds)
+{
+  Link& link = requireLink(connHandle);
+  link.leds = leds;
+  writeLeds(link);
+}
+
+uint8_t hostsim::getLeds(uint16_t connHandle)
+{
+  return requireLink(connHandle).leds;
+}
+
+void hostsim::setStalled(uint16_t connHandle, bool stalled)
+{
+  requireLink(connHandle).stalled = stalled;
+}
+
+void hostsim::setPacketsPerEvent(size_t packets)
+{
+  packetsPerEvent = packets;
+}
+
+uint16_t hostsim::getConnInterval(uint16_t connHandle)
+{
+  return requireLink(connHandle).interval;
+}
+
+void hostsim::addBond(const NimBLEAddress& address)
+{
+  for (int i = 0; i < bondCount; i++) {
+    if (bonds[i] == address) {
+      return;
+    }
+  }
+  if (bondCount < (int)(sizeof(bonds) / sizeof(bonds[0]))) {
+    bonds[bondCount++] = address;
+  }
+}
+
+// Reports stay readable after the central disconnects, until it connects again
+static Link& capturedLink(uint16_t connHandle)
+{
+  Link* found = nullptr;
+  for (Link& link : links) {
+    if (link.reports != nullptr && link.connHandle == connHandle && (found == nullptr || link.connected)) {
+      found = &link;
+    }
+  }
+  if (found == nullptr) {
+    hostsim::fail("no reports for handle %u", connHandle);
+  }
+  return *found;
+}
+
+size_t hostsim::reportCount(uint16_t connHandle)
+{
+  return capturedLink(connHandle).captured;
+}
+
+const hostsim::CapturedReport& hostsim::report(uint16_t connHandle, size_t index)
+{
+  Link& link = capturedLink(connHandle);
+  if (index >= link.captured || index >= CAPTURE_SIZE) {
+    hostsim::fail("report %zu of handle %u was not captured", index, connHandle);
+  }
+  return link.reports[index];
+}
+
+void hostsim::clearReports(uint16_t connHandle)
+{
+  capturedLink(connHandle).captured = 0;
+}
+
+void hostsim::setMbufCount(int count)
+{
+  mbufCount = std::min(count, MAX_MBUFS);
+}
+
+int hostsim::freeMbufs(void)
+{
+  return os_msys_num_free();
+}
+
+size_t hostsim::notifyTxEvents(void)
+{
+  return notifyTx;
+}
+
+hostsim::AdvertisingState hostsim::advertising(void)
+{
+  return advertisingState;
+}
+
+const uint8_t* hostsim::reportMap(size_t* size)
+{
+  *size = reportMapSize;
+  return reportMapData;
+}
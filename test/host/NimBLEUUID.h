@@ -0,0 +1,18 @@
+#ifndef HOST_NIMBLE_UUID_H
+#define HOST_NIMBLE_UUID_H
+
+#include <string>
+
+class NimBLEUUID
+{
+public:
+  NimBLEUUID() = default;
+  NimBLEUUID(const char* uuid) : _uuid(uuid) {}
+  NimBLEUUID(uint16_t uuid) : _uuid(std::to_string(uuid)) {}
+  std::string toString() const { return _uuid; }
+
+private:
+  std::string _uuid;
+};
+
+#endif // HOST_NIMBLE_UUID_H
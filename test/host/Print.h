@@ -0,0 +1,42 @@
+#ifndef HOST_PRINT_H
+#define HOST_PRINT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// The part of Arduino's Print the library and its examples use
+class Print
+{
+public:
+  virtual ~Print() {}
+
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size);
+  size_t write(const char* str) { return str != nullptr ? write((const uint8_t*)str, strlen(str)) : 0; }
+  size_t write(const char* buffer, size_t size) { return write((const uint8_t*)buffer, size); }
+  virtual int availableForWrite() { return 0; }
+  virtual void flush() {}
+
+  size_t print(const char* str) { return write(str); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int value);
+  size_t print(unsigned int value);
+  size_t print(long value);
+  size_t print(unsigned long value);
+  size_t println(void) { return write("\r\n"); }
+  size_t println(const char* str) { return print(str) + println(); }
+  size_t println(int value) { return print(value) + println(); }
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+  int getWriteError() { return _writeError; }
+  void clearWriteError() { setWriteError(0); }
+
+protected:
+  void setWriteError(int error = 1) { _writeError = error; }
+
+private:
+  int _writeError = 0;
+};
+
+#endif // HOST_PRINT_H
@@ -0,0 +1,12 @@
+#ifndef HOST_ESP_LOG_H
+#define HOST_ESP_LOG_H
+
+// Printed to stderr when BLE_KEYBOARD_LOG is set in the environment
+void hostsim_log(char level, const char* tag, const char* format, ...);
+
+#define ESP_LOGE(tag, format, ...) hostsim_log('E', tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) hostsim_log('W', tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) hostsim_log('I', tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) hostsim_log('D', tag, format, ##__VA_ARGS__)
+
+#endif // HOST_ESP_LOG_H
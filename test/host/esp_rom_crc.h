@@ -0,0 +1,8 @@
+#ifndef HOST_ESP_ROM_CRC_H
+#define HOST_ESP_ROM_CRC_H
+
+#include <stdint.h>
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buffer, uint32_t length);
+
+#endif // HOST_ESP_ROM_CRC_H
@@ -0,0 +1,36 @@
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+// FreeRTOS as the library sees it on an ESP32, emulated by HostSim.cpp: tasks
+// are threads of which only one runs at a time, like on a single core, and
+// time is the virtual clock.
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdFALSE 0
+#define pdTRUE  1
+#define pdFAIL  0
+#define pdPASS  1
+
+#define configTICK_RATE_HZ 1000
+#define configMAX_PRIORITIES 25
+#define configTASK_NOTIFICATION_ARRAY_ENTRIES 1
+#define configSUPPORT_STATIC_ALLOCATION 1
+
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+// Room for the emulator's semaphore, see xSemaphoreCreateBinaryStatic()
+typedef struct
+{
+  alignas(8) uint8_t storage[64];
+} StaticSemaphore_t;
+
+#endif // HOST_FREERTOS_H
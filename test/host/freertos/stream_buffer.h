@@ -0,0 +1,16 @@
+#ifndef HOST_FREERTOS_STREAM_BUFFER_H
+#define HOST_FREERTOS_STREAM_BUFFER_H
+
+#include "FreeRTOS.h"
+
+typedef struct StreamBufferDef_t* StreamBufferHandle_t;
+
+StreamBufferHandle_t xStreamBufferCreate(size_t size, size_t triggerLevel);
+size_t xStreamBufferSend(StreamBufferHandle_t buffer, const void* data, size_t length, TickType_t ticks);
+size_t xStreamBufferReceive(StreamBufferHandle_t buffer, void* data, size_t length, TickType_t ticks);
+size_t xStreamBufferSpacesAvailable(StreamBufferHandle_t buffer);
+size_t xStreamBufferBytesAvailable(StreamBufferHandle_t buffer);
+BaseType_t xStreamBufferIsEmpty(StreamBufferHandle_t buffer);
+void vStreamBufferDelete(StreamBufferHandle_t buffer);
+
+#endif // HOST_FREERTOS_STREAM_BUFFER_H
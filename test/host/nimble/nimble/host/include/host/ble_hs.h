@@ -0,0 +1,46 @@
+#ifndef HOST_BLE_HS_H
+#define HOST_BLE_HS_H
+
+// The NimBLE host calls the library makes directly, served by the fake
+// controller in NimBLEStubs.cpp
+
+#include <stdint.h>
+
+#define BLE_HS_CONN_HANDLE_NONE 0xffff
+
+#define BLE_HS_ENOMEM   6
+#define BLE_HS_ENOTCONN 7
+#define BLE_HS_ETIMEOUT 13
+
+#define BLE_GAP_EVENT_CONNECT      0
+#define BLE_GAP_EVENT_DISCONNECT   1
+#define BLE_GAP_EVENT_ADV_COMPLETE 9
+#define BLE_GAP_EVENT_NOTIFY_TX    13
+
+#define BLE_GAP_CONN_MODE_NON 0
+#define BLE_GAP_CONN_MODE_DIR 1
+#define BLE_GAP_CONN_MODE_UND 2
+
+struct os_mbuf;
+
+struct ble_gap_event
+{
+  uint8_t type;
+  union {
+    struct {
+      int reason; // 0 when a connection ended it, BLE_HS_ETIMEOUT when its duration ran out
+    } adv_complete;
+    struct {
+      int status;
+      uint16_t conn_handle;
+      uint16_t attr_handle;
+      uint8_t indication;
+    } notify_tx;
+  };
+};
+
+int os_msys_num_free(void);
+struct os_mbuf* ble_hs_mbuf_from_flat(const void* buffer, uint16_t length);
+int ble_gatts_notify_custom(uint16_t connHandle, uint16_t attrHandle, struct os_mbuf* om);
+
+#endif // HOST_BLE_HS_H
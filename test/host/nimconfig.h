@@ -0,0 +1,8 @@
+#ifndef HOST_NIMCONFIG_H
+#define HOST_NIMCONFIG_H
+
+#include "sdkconfig.h"
+
+#define CONFIG_BT_NIMBLE_ROLE_PERIPHERAL 1
+
+#endif // HOST_NIMCONFIG_H
@@ -0,0 +1,11 @@
+#ifndef HOST_SDKCONFIG_H
+#define HOST_SDKCONFIG_H
+
+// The options of an ESP32 Arduino build the library depends on
+#define CONFIG_BT_ENABLED 1
+#define CONFIG_BT_NIMBLE_ENABLED 1
+#define CONFIG_BT_NIMBLE_MAX_CONNECTIONS 3
+#define CONFIG_BT_NIMBLE_PINNED_TO_CORE 0
+#define CONFIG_FREERTOS_HZ 1000
+
+#endif // HOST_SDKCONFIG_H
@@ -0,0 +1,247 @@
+// Types a corpus through BleKeyboard and prints the reports the central
+// received, for roundtrip.py to decode with tools/hidhost.py:
+//
+//   case <name>
+//   caps <CapsLock state of the host before the case, 0 or 1>
+//   expect <text, hex UTF-8>
+//   report <report, hex, boot layout>   (one per report)
+//   trace <dumpTrace() output, hex>     (traced cases only)
+//   end
+//
+// Run as "roundtrip boot" or "roundtrip nkro" for the report mode. In NKRO
+// mode it also checks F13 to F24 in the key bitmap.
+
+#include <Arduino.h>
+#include <BleKeyboard.h>
+#include <layouts/FrAzerty.h>
+#include <string.h>
+#include <string>
+
+#include "check.h"
+
+static const char* const CORPUS =
+    "Bonjour à tous, ça va ? L'été où j'ai vu Noël : 1 + 2 = 3 € ; 45 % de 6,7 = 8.9 !\n"
+    "Île, âme, forêt, maïs, aigüe, Ÿ ÿ, ñ õ ã, ò ì, ô û ê î â, ä ë ï ö ü.\n"
+    "\t#{[|`\\^@]} ~ ¤ £ $ µ * ù § / ° + ² < > _ - ( ) & \" '\n";
+
+static const char* const TOP_ROW = "&é\"'(-è_çà 1234567890 Ÿ ÿ Bonjour ABC";
+
+static const char* const MIXED_CASE = "HELLO WORLD, hello world. BONJOUR À TOUS, Ÿ ÿ ËTE 123 abc DEF";
+
+static const char* const LONG_MIXED_CASE =
+    "HELLO WORLD, hello world. BONJOUR À TOUS, Ÿ ÿ ËTE 123 abc DEF"
+    "HELLO WORLD, hello world. BONJOUR À TOUS, Ÿ ÿ ËTE 123 abc DEF"
+    "HELLO WORLD, hello world. BONJOUR À TOUS, Ÿ ÿ ËTE 123 abc DEF";
+
+static BleKeyboard keyboard("Round trip");
+static uint16_t central;
+
+static void printHex(const char* label, const uint8_t* data, size_t length)
+{
+  printf("%s", label);
+  for (size_t i = 0; i < length; i++) {
+    printf(" %02x", data[i]);
+  }
+  printf("\n");
+}
+
+// Boot layout of a captured report. NKRO reports keep their first six keys,
+// which is all a typing path ever holds.
+static void printReport(const hostsim::CapturedReport& report)
+{
+  uint8_t boot[8] = {report.data[0]};
+  if (report.length == sizeof(KeyReport)) {
+    memcpy(boot, report.data, sizeof(boot));
+  } else {
+    CHECK_EQ(report.length, sizeof(NkroReport));
+    size_t keys = 0;
+    for (int usage = 0; usage < NKRO_KEY_COUNT; usage++) {
+      if ((report.data[1 + usage / 8] >> (usage % 8)) & 1) {
+        CHECK(keys < 6);
+        boot[2 + keys++] = usage;
+      }
+    }
+  }
+  printHex("report", boot, sizeof(boot));
+}
+
+// Writes what it is given as hex, on the line it was started on
+class HexPrint : public Print
+{
+public:
+  size_t write(uint8_t c) override
+  {
+    ::printf(" %02x", c); // Not Print::printf, which would come back here
+    return 1;
+  }
+};
+
+// A case: the text, the reports the host got and, with trace, the trace of the
+// reports for roundtrip.py to decode with tools/tracereplay.py
+static void printCase(const char* name, uint16_t host, bool capsLock, const char* text, bool trace = false)
+{
+  printf("case %s\ncaps %d\n", name, capsLock);
+  printHex("expect", (const uint8_t*)text, strlen(text));
+  for (size_t i = 0; i < hostsim::reportCount(host); i++) {
+    printReport(hostsim::report(host, i));
+  }
+  if (trace) {
+    HexPrint dump;
+    printf("trace");
+    CHECK(keyboard.dumpTrace(dump) > 16);
+    printf("\n");
+  }
+  printf("end\n");
+}
+
+template <typename Type>
+static void runCase(const char* name, const char* text, bool capsLock, Type type)
+{
+  hostsim::setLeds(central, capsLock ? LED_CAPS_LOCK : 0);
+  hostsim::sleepFor(50000);
+  hostsim::clearReports(central);
+  type(text);
+  CHECK(keyboard.flush(5000)); // The host has processed every report
+  CHECK_EQ(keyboard.getMetrics().reportsDropped, 0);
+  printCase(name, central, capsLock, text);
+}
+
+// The same text typed to a second host that has CapsLock on while the first
+// has it off: each gets the text, with its own CapsLock compensation
+template <typename Type>
+static void runTwoHostCase(const char* name, const char* text, Type type)
+{
+  uint16_t second = hostsim::connect(NimBLEAddress("11:22:33:44:55:77"));
+  CHECK(second != BLE_HS_CONN_HANDLE_NONE);
+  hostsim::subscribe(second);
+  hostsim::setLeds(central, 0);
+  hostsim::setLeds(second, LED_CAPS_LOCK);
+  hostsim::sleepFor(50000);
+  hostsim::clearReports(central);
+  type(text);
+  CHECK(keyboard.flush(5000));
+  CHECK_EQ(keyboard.getMetrics().reportsDropped, 0);
+  std::string caps = std::string(name) + "-caps";
+  printCase(name, central, false, text);
+  printCase(caps.c_str(), second, true, text);
+  hostsim::disconnect(second);
+  hostsim::sleepFor(50000);
+}
+
+// A case traced from its first report
+static void runTraceCase(const char* name, const char* text)
+{
+  hostsim::setLeds(central, 0);
+  hostsim::sleepFor(50000);
+  hostsim::clearReports(central);
+  keyboard.clearTrace();
+  keyboard.print(text);
+  CHECK(keyboard.flush(5000));
+  printCase(name, central, false, text, true);
+}
+
+static void typeClassic(const char* text)
+{
+  keyboard.setTypingMode(TypingMode::Classic);
+  keyboard.print(text);
+}
+
+static void typeRollover(const char* text)
+{
+  keyboard.setTypingMode(TypingMode::Rollover);
+  keyboard.print(text);
+  keyboard.setTypingMode(TypingMode::Classic);
+}
+
+static void typeCompiled(const char* text)
+{
+  static CompactKeyReport reports[1024];
+  size_t count = compileText(LayoutFrAzerty, text, reports, 1024);
+  CHECK(count <= 1024);
+  CHECK_EQ(keyboard.send(reports, count), count);
+}
+
+static void typeAsync(const char* text)
+{
+  CHECK(keyboard.beginAsync());
+  keyboard.setTypingMode(TypingMode::Rollover);
+  size_t length = strlen(text);
+  for (size_t i = 0; i < length; i += 7) {
+    // Chunks cutting characters in two are put back together
+    size_t chunk = std::min<size_t>(7, length - i);
+    CHECK_EQ(keyboard.write((const uint8_t*)text + i, chunk), chunk);
+  }
+  keyboard.flush();
+  keyboard.setTypingMode(TypingMode::Classic);
+  keyboard.endAsync();
+}
+
+// One frame, longer than the chunks the typing task reads it in, typed with
+// rollover across them. The typing task was stopped by the previous case.
+static void typeAsyncFrame(const char* text)
+{
+  CHECK(keyboard.beginAsync());
+  keyboard.setTypingMode(TypingMode::Rollover);
+  CHECK_EQ(keyboard.print(text), strlen(text));
+  keyboard.flush();
+  keyboard.setTypingMode(TypingMode::Classic);
+  keyboard.endAsync();
+}
+
+// NKRO only: F13 to F24, above the boot report's 0x65, all held at once and
+// each at its own bit of the bitmap
+static void checkFunctionKeys()
+{
+  static const SpecialKey keys[] = {SpecialKey::F13, SpecialKey::F14, SpecialKey::F15, SpecialKey::F16,
+                                    SpecialKey::F17, SpecialKey::F18, SpecialKey::F19, SpecialKey::F20,
+                                    SpecialKey::F21, SpecialKey::F22, SpecialKey::F23, SpecialKey::F24};
+  hostsim::clearReports(central);
+  for (SpecialKey key : keys) {
+    CHECK_EQ(keyboard.press(key), 1);
+  }
+  hostsim::sleepFor(100000); // flush(timeout) would add its ScrollLock taps
+  CHECK_EQ(hostsim::reportCount(central), 12);
+  const hostsim::CapturedReport& held = hostsim::report(central, 11);
+  CHECK_EQ(held.length, sizeof(NkroReport));
+  for (int usage = 0; usage < NKRO_KEY_COUNT; usage++) {
+    bool set = (held.data[1 + usage / 8] >> (usage % 8)) & 1;
+    CHECK_EQ(set, usage >= 0x68 && usage <= 0x73);
+  }
+  keyboard.releaseAll();
+  hostsim::sleepFor(100000);
+  const hostsim::CapturedReport& released = hostsim::report(central, hostsim::reportCount(central) - 1);
+  for (size_t i = 0; i < released.length; i++) {
+    CHECK_EQ(released.data[i], 0);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  if (argc != 2 || (strcmp(argv[1], "boot") != 0 && strcmp(argv[1], "nkro") != 0)) {
+    fprintf(stderr, "usage: %s boot|nkro\n", argv[0]);
+    return 2;
+  }
+  keyboard.setReportMode(strcmp(argv[1], "nkro") == 0 ? ReportMode::Nkro : ReportMode::Boot);
+  keyboard.begin();
+  central = hostsim::connect(NimBLEAddress("11:22:33:44:55:66"));
+  CHECK(central != BLE_HS_CONN_HANDLE_NONE);
+  hostsim::subscribe(central);
+
+  runCase("classic", CORPUS, false, typeClassic);
+  runCase("rollover", CORPUS, false, typeRollover);
+  runCase("caps-classic", TOP_ROW, true, typeClassic);
+  runCase("caps-rollover", TOP_ROW, true, typeRollover);
+  runCase("mixed-case", MIXED_CASE, false, typeClassic);
+  runCase("caps-mixed-case", MIXED_CASE, true, typeClassic);
+  runCase("compiled", CORPUS, false, typeCompiled);
+  runCase("async", CORPUS, false, typeAsync);
+  runCase("async-frame", LONG_MIXED_CASE, true, typeAsyncFrame);
+  runTraceCase("trace", MIXED_CASE);
+  runTwoHostCase("two-hosts-classic", MIXED_CASE, typeClassic);
+  runTwoHostCase("two-hosts-rollover", TOP_ROW, typeRollover);
+  if (keyboard.getReportMode() == ReportMode::Nkro) {
+    checkFunctionKeys();
+  }
+  fflush(stdout);
+  return 0;
+}
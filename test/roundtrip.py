@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+"""Runs the roundtrip test program and checks that every case decodes, with
+tools/hidhost.py, to the text it typed. A case with a trace dump must also
+replay, with tools/tracereplay.py, to the same reports and text.
+
+    roundtrip.py <roundtrip program> boot|nkro
+"""
+
+import os
+import subprocess
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "tools"))
+import hidhost  # noqa: E402
+import tracereplay  # noqa: E402
+
+
+def parse_cases(output):
+    cases = []
+    case = None
+    for line in output.splitlines():
+        word, _, rest = line.partition(" ")
+        if word == "case":
+            case = {"name": rest, "caps": False, "expect": "", "reports": [], "trace": None}
+        elif case is None:
+            continue
+        elif word == "caps":
+            case["caps"] = rest == "1"
+        elif word == "expect":
+            case["expect"] = bytes.fromhex(rest).decode("utf-8")
+        elif word == "report":
+            case["reports"].append(bytes.fromhex(rest))
+        elif word == "trace":
+            case["trace"] = bytes.fromhex(rest)
+        elif word == "end":
+            cases.append(case)
+            case = None
+    return cases
+
+
+def check_trace(case):
+    """Returns what is wrong with the trace of a case, None when it matches."""
+    try:
+        entries, lost = tracereplay.parse_trace(case["trace"])
+    except tracereplay.TraceError as error:
+        return str(error)
+    if lost:
+        return f"{lost} entries lost"
+    handles = {e.conn_handle for e in entries if e.event == tracereplay.SENT}
+    if len(handles) != 1:
+        return f"reports sent to {len(handles)} hosts"
+    replay = tracereplay.Replay(handles.pop(), entries)
+    if replay.count(tracereplay.QUEUED) != len(replay.sent):
+        return f"{replay.count(tracereplay.QUEUED)} reports queued, {len(replay.sent)} sent"
+    if [e.report for e in replay.sent] != case["reports"]:
+        return "the sent reports differ from the ones the host got"
+    if replay.text != case["expect"]:
+        return f"replays to {replay.text[:40]!r}"
+    return None
+
+
+def main(argv):
+    if len(argv) != 3:
+        print(__doc__, file=sys.stderr)
+        return 2
+    run = subprocess.run(argv[1:], stdout=subprocess.PIPE, text=True)
+    if run.returncode != 0:
+        print(run.stdout[-2000:])
+        print(f"{argv[1]} exited with {run.returncode}", file=sys.stderr)
+        return 1
+    cases = parse_cases(run.stdout)
+    if not cases:
+        print("no cases in the output", file=sys.stderr)
+        return 1
+
+    failed = 0
+    for case in cases:
+        host = hidhost.VirtualHost(caps_lock=case["caps"])
+        for report in case["reports"]:
+            host.feed(report)
+        text = host.result()
+        if case["trace"] is not None:
+            error = check_trace(case)
+            if error:
+                failed += 1
+                print(f"{case['name']}: trace: {error}")
+                continue
+        if text == case["expect"]:
+            print(f"{case['name']}: {len(case['reports'])} reports, ok")
+            continue
+        failed += 1
+        i = next((i for i, (got, want) in enumerate(zip(text, case["expect"])) if got != want),
+                 min(len(text), len(case["expect"])))
+        print(f"{case['name']}: mismatch at character {i}: expected {case['expect'][i:i + 20]!r}, "
+              f"got {text[i:i + 20]!r}")
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
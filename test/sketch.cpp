@@ -0,0 +1,30 @@
+// Runs an example sketch on the host: setup() on the loop task, with a
+// central that connects and subscribes a second after start-up, as someone
+// pairing the keyboard would. SKETCH_FILE names the .ino to build.
+
+#include <Arduino.h>
+#include "HostSim.h"
+
+#include SKETCH_FILE
+
+static void connectCentral(void*)
+{
+  uint16_t central = hostsim::connect(NimBLEAddress("11:22:33:44:55:66"));
+  if (central == BLE_HS_CONN_HANDLE_NONE) {
+    hostsim::fail("the sketch is not advertising");
+  }
+  hostsim::subscribe(central);
+}
+
+int main()
+{
+  esp_timer_create_args_t args = {};
+  args.callback = connectCentral;
+  args.name = "central";
+  esp_timer_handle_t timer;
+  esp_timer_create(&args, &timer);
+  esp_timer_start_once(timer, 1000000);
+  setup();
+  fflush(stdout);
+  return 0;
+}
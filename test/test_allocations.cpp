@@ -0,0 +1,54 @@
+// Built with BLE_KEYBOARD_COUNT_ALLOCATIONS: once every typing path has run
+// once, typing again must not touch the heap.
+
+#include <Arduino.h>
+#include <BleKeyboard.h>
+#include <layouts/FrAzerty.h>
+
+#include "check.h"
+
+static BleKeyboard keyboard("Allocations");
+
+static const char* const TEXT = "Le cœur déçu mais l'âme plutôt naïve, Louÿs rêva de crapaüter en canoë. "
+                                "if (a[i] > b[j]) { x |= y; } ~/src\\main ÂÊÎÔÛ ãõñ\n";
+
+static void typeEverything(void)
+{
+  static CompactKeyReport reports[512];
+  keyboard.setTypingMode(TypingMode::Classic);
+  keyboard.print(TEXT);
+  keyboard.setTypingMode(TypingMode::Rollover);
+  keyboard.print(TEXT);
+  keyboard.print("HELLO WORLD hello world\n");
+  size_t count = compileText(LayoutFrAzerty, TEXT, reports, 512);
+  CHECK(count <= 512);
+  keyboard.send(reports, count);
+  keyboard.press(ModifierKey::LeftCtrl);
+  keyboard.press(U'c');
+  keyboard.releaseAll();
+  keyboard.write((const uint8_t*)TEXT, strlen(TEXT)); // Queued for the async task
+  keyboard.flush();
+  CHECK(keyboard.flush(5000));
+}
+
+TEST(noAllocationsOnceWarm)
+{
+  keyboard.resetMetrics();
+  CHECK(keyboard.beginAsync());
+  CHECK(keyboard.getMetrics().heapAllocations > 0); // The text buffer and task: the counter works
+  typeEverything();
+  keyboard.resetMetrics();
+  typeEverything();
+  KeyboardMetrics metrics = keyboard.getMetrics();
+  CHECK(metrics.charactersTyped > 0);
+  CHECK_EQ(metrics.heapAllocations, 0);
+}
+
+int main()
+{
+  keyboard.begin();
+  uint16_t central = hostsim::connect(NimBLEAddress("11:22:33:44:55:66"));
+  hostsim::subscribe(central);
+  RUN(noAllocationsOnceWarm);
+  return 0;
+}
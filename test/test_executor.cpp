@@ -0,0 +1,76 @@
+// Writers on several tasks, of different priorities, each get their text
+// typed whole and in one piece.
+
+#include <Arduino.h>
+#include <BleKeyboard.h>
+
+#include "check.h"
+
+#define WRITES 20
+
+static BleKeyboard keyboard("Executor");
+static uint16_t central;
+static const char* const WORDS[] = {"azer", "tyui", "qsdf"};
+static SemaphoreHandle_t finished;
+
+static void writer(void* arg)
+{
+  const char* word = static_cast<const char*>(arg);
+  for (int i = 0; i < WRITES; i++) {
+    CHECK_EQ(keyboard.print(word), 4);
+    vTaskDelay(i % 3); // Vary who finds the executor busy
+  }
+  xSemaphoreGive(finished);
+  vTaskDelete(nullptr);
+}
+
+TEST(writersDoNotInterleave)
+{
+  hostsim::clearReports(central);
+  finished = xSemaphoreCreateCounting(3, 0);
+  for (int i = 0; i < 3; i++) {
+    xTaskCreatePinnedToCore(writer, WORDS[i], 4096, (void*)WORDS[i], 3 + i, nullptr, 0);
+  }
+  for (int i = 0; i < 3; i++) {
+    CHECK(xSemaphoreTake(finished, pdMS_TO_TICKS(60000)));
+  }
+  CHECK(keyboard.flush(5000));
+
+  // Keys pressed, in order, with the ScrollLock taps of flush() left out
+  static uint8_t keys[3 * WRITES * 4];
+  size_t count = 0;
+  for (size_t i = 0; i < hostsim::reportCount(central); i++) {
+    uint8_t key = hostsim::report(central, i).data[2];
+    if (key != 0 && key != 0x47) {
+      CHECK(count < sizeof(keys));
+      keys[count++] = key;
+    }
+  }
+  CHECK_EQ(count, sizeof(keys));
+  int written[3] = {};
+  for (size_t i = 0; i < count; i += 4) {
+    int match = -1;
+    for (int w = 0; w < 3; w++) {
+      static const uint8_t usages[3][4] = {{0x14, 0x1A, 0x08, 0x15}, {0x17, 0x1C, 0x18, 0x0C}, {0x04, 0x16, 0x07, 0x09}};
+      if (memcmp(keys + i, usages[w], 4) == 0) {
+        match = w;
+      }
+    }
+    if (match < 0) {
+      hostsim::fail("keys %zu to %zu are not one word", i, i + 3);
+    }
+    written[match]++;
+  }
+  for (int w = 0; w < 3; w++) {
+    CHECK_EQ(written[w], WRITES);
+  }
+}
+
+int main()
+{
+  keyboard.begin();
+  central = hostsim::connect(NimBLEAddress("11:22:33:44:55:66"));
+  hostsim::subscribe(central);
+  RUN(writersDoNotInterleave);
+  return 0;
+}
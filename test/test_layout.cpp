@@ -0,0 +1,105 @@
+// Layout blobs written by tools/layoutblob.py, loaded with loadKeyboardLayout():
+// the FR AZERTY blob maps every character as the compiled layout does, and
+// damaged or hostile blobs are refused.
+
+#include <Arduino.h>
+#include <LayoutBlob.h>
+#include <layouts/FrAzerty.h>
+#include <esp_rom_crc.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "check.h"
+
+// Word-aligned, as a memory-mapped partition is
+static std::vector<uint32_t> readBlob(size_t* size)
+{
+  FILE* file = fopen(LAYOUT_BLOB_FILE, "rb");
+  CHECK(file != nullptr);
+  std::vector<uint32_t> blob(16384);
+  *size = fread(blob.data(), 1, blob.size() * sizeof(uint32_t), file);
+  fclose(file);
+  CHECK(*size > sizeof(LayoutBlobHeader));
+  return blob;
+}
+
+static void updateCrc(std::vector<uint32_t>& blob)
+{
+  LayoutBlobHeader* header = reinterpret_cast<LayoutBlobHeader*>(blob.data());
+  const uint8_t* base = reinterpret_cast<const uint8_t*>(blob.data());
+  header->crc32 = esp_rom_crc32_le(0, base + header->headerSize, header->totalSize - header->headerSize);
+}
+
+TEST(roundTripsAgainstCompiledLayout)
+{
+  size_t size;
+  std::vector<uint32_t> blob = readBlob(&size);
+  KeyboardLayout layout = {};
+  CHECK(loadKeyboardLayout(blob.data(), size, layout));
+  CHECK(strcmp(layout.name, LayoutFrAzerty.name) == 0);
+  CHECK_EQ(layout.entryCount, LayoutFrAzerty.entryCount);
+  CHECK_EQ(layout.deadKeyCount, LayoutFrAzerty.deadKeyCount);
+  CHECK_EQ(layout.capsLockShiftsTopRow, LayoutFrAzerty.capsLockShiftsTopRow);
+  for (size_t i = 0; i < LayoutFrAzerty.entryCount; i++) {
+    const KeymapEntry& expected = LayoutFrAzerty.entries[i];
+    const KeymapEntry* entry = layout.find(expected.unicode);
+    CHECK(entry != nullptr);
+    CHECK(memcmp(&entry->sequence, &expected.sequence, sizeof(KeyPressSequence)) == 0);
+    CHECK_EQ(entry->flags, expected.flags);
+  }
+  for (size_t i = 0; i < LayoutFrAzerty.deadKeyCount; i++) {
+    const DeadKey& deadKey = LayoutFrAzerty.deadKeys[i];
+    CHECK(layout.isDeadKey(deadKey.modifiers, deadKey.key));
+  }
+  CHECK(layout.find(U'☃') == nullptr);
+}
+
+TEST(rejectsBadCrc)
+{
+  size_t size;
+  std::vector<uint32_t> blob = readBlob(&size);
+  reinterpret_cast<uint8_t*>(blob.data())[sizeof(LayoutBlobHeader) + 5] ^= 0x01;
+  KeyboardLayout layout = {};
+  CHECK(!loadKeyboardLayout(blob.data(), size, layout));
+}
+
+TEST(rejectsTruncatedBlob)
+{
+  size_t size;
+  std::vector<uint32_t> blob = readBlob(&size);
+  KeyboardLayout layout = {};
+  CHECK(!loadKeyboardLayout(blob.data(), size - 1, layout));
+  CHECK(!loadKeyboardLayout(blob.data(), sizeof(LayoutBlobHeader) - 1, layout));
+}
+
+// The CRC is valid, but 'a' is sent as LeftShift (0xE1): the blob is refused
+// before the usage can index a per-key table
+TEST(rejectsOutOfRangeUsage)
+{
+  size_t size;
+  std::vector<uint32_t> blob = readBlob(&size);
+  const LayoutBlobHeader* header = reinterpret_cast<const LayoutBlobHeader*>(blob.data());
+  KeymapEntry* entries = reinterpret_cast<KeymapEntry*>(reinterpret_cast<uint8_t*>(blob.data()) + header->entriesOffset);
+  KeyboardLayout layout = {};
+  CHECK(loadKeyboardLayout(blob.data(), size, layout));
+  KeymapEntry* a = const_cast<KeymapEntry*>(layout.find(U'a'));
+  CHECK(a >= entries && a < entries + header->entryCount);
+  a->sequence.key1 = 0xE1;
+  updateCrc(blob);
+  CHECK(!loadKeyboardLayout(blob.data(), size, layout));
+
+  a->sequence.key1 = KC_Q;
+  a->sequence.key2 = 0x80;
+  updateCrc(blob);
+  CHECK(!loadKeyboardLayout(blob.data(), size, layout));
+}
+
+int main()
+{
+  RUN(roundTripsAgainstCompiledLayout);
+  RUN(rejectsBadCrc);
+  RUN(rejectsTruncatedBlob);
+  RUN(rejectsOutOfRangeUsage);
+  return 0;
+}
@@ -0,0 +1,142 @@
+// Macros played by playMacro() on their own task: the reports each step makes,
+// one macro at a time, stopMacro() and WaitLed timing out.
+
+#include <Arduino.h>
+#include <BleKeyboard.h>
+
+#include "check.h"
+
+#define MS 1000LL
+#define HEADER 'K', 'M', KEY_MACRO_VERSION, 0
+#define OP(op) static_cast<uint8_t>(KeyMacroOp::op)
+#define U16(value) (value) & 0xFF, (value) >> 8
+
+static BleKeyboard keyboard("Macro");
+static uint16_t central;
+
+static void checkReport(size_t index, uint8_t modifiers, uint8_t key)
+{
+  CHECK(index < hostsim::reportCount(central));
+  const hostsim::CapturedReport& report = hostsim::report(central, index);
+  CHECK_EQ(report.data[0], modifiers);
+  CHECK_EQ(report.data[2], key);
+  CHECK_EQ(report.data[3], 0);
+}
+
+static void waitWhilePlaying(int64_t limit)
+{
+  for (int64_t waited = 0; keyboard.getMacroState() == MacroState::Playing && waited < limit; waited += 10 * MS) {
+    hostsim::sleepFor(10 * MS);
+  }
+}
+
+TEST(stepsMakeTheirReports)
+{
+  static const uint8_t macro[] = {
+      HEADER,
+      OP(Press), 0x01, KC_C,         // Ctrl+C down
+      OP(Release), 0x01, KC_C,       // and up
+      OP(Chord), 0x00, KC_A,         // Down and up
+      OP(Hold), 0x02, KC_B, U16(50), // Shift+B, released 50 ms later
+      OP(Wait), U16(20),
+      OP(Type), 1, 'a',              // KC_Q on FR AZERTY
+      OP(End),
+  };
+  hostsim::clearReports(central);
+  CHECK(keyboard.playMacro(macro, sizeof(macro)));
+  CHECK(keyboard.getMacroState() == MacroState::Playing);
+  waitWhilePlaying(1000 * MS);
+  CHECK(keyboard.getMacroState() == MacroState::Done);
+  hostsim::sleepFor(50 * MS);
+
+  CHECK_EQ(hostsim::reportCount(central), 8);
+  checkReport(0, 0x01, KC_C);
+  checkReport(1, 0x00, 0);
+  checkReport(2, 0x00, KC_A);
+  checkReport(3, 0x00, 0);
+  checkReport(4, 0x02, KC_B);
+  checkReport(5, 0x00, 0);
+  checkReport(6, 0x00, KC_Q);
+  checkReport(7, 0x00, 0);
+  int64_t held = hostsim::report(central, 5).micros - hostsim::report(central, 4).micros;
+  CHECK(held >= 50 * MS - 15 * MS && held <= 50 * MS + 15 * MS); // Within a connection interval
+  int64_t waited = hostsim::report(central, 6).micros - hostsim::report(central, 5).micros;
+  CHECK(waited >= 20 * MS - 15 * MS);
+}
+
+TEST(oneMacroAtATime)
+{
+  static const uint8_t wait[] = {HEADER, OP(Wait), U16(200), OP(End)};
+  static const uint8_t chord[] = {HEADER, OP(Chord), 0x00, KC_A, OP(End)};
+  hostsim::clearReports(central);
+  CHECK(keyboard.playMacro(wait, sizeof(wait)));
+  CHECK(!keyboard.playMacro(chord, sizeof(chord)));
+  waitWhilePlaying(1000 * MS);
+  CHECK(keyboard.getMacroState() == MacroState::Done);
+  CHECK_EQ(hostsim::reportCount(central), 0); // The refused macro never ran
+
+  CHECK(keyboard.playMacro(chord, sizeof(chord))); // Free again once done
+  waitWhilePlaying(1000 * MS);
+  hostsim::sleepFor(50 * MS);
+  CHECK_EQ(hostsim::reportCount(central), 2);
+}
+
+TEST(stopReleasesEveryKey)
+{
+  static const uint8_t macro[] = {
+      HEADER,
+      OP(Press), 0x02, KC_A,
+      OP(Press), 0x00, KC_B,
+      OP(Wait), U16(5000),
+      OP(Release), 0x02, KC_A, // Never reached
+      OP(End),
+  };
+  hostsim::clearReports(central);
+  CHECK(keyboard.playMacro(macro, sizeof(macro)));
+  hostsim::sleepFor(100 * MS);
+  CHECK(keyboard.getMacroState() == MacroState::Playing);
+  keyboard.stopMacro();
+  waitWhilePlaying(100 * MS);
+  CHECK(keyboard.getMacroState() == MacroState::Stopped);
+  hostsim::sleepFor(50 * MS);
+  size_t count = hostsim::reportCount(central);
+  CHECK_EQ(count, 3);
+  CHECK_EQ(hostsim::report(central, 1).data[3], KC_B); // Both keys down
+  checkReport(count - 1, 0x00, 0);
+}
+
+TEST(waitLedTimesOut)
+{
+  static const uint8_t macro[] = {
+      HEADER,
+      OP(WaitLed), LED_NUM_LOCK, LED_NUM_LOCK, U16(200), // NumLock stays off
+      OP(Chord), 0x00, KC_A,                             // Never reached
+      OP(End),
+  };
+  hostsim::setLeds(central, 0);
+  hostsim::sleepFor(50 * MS);
+  hostsim::clearReports(central);
+  int64_t start = esp_timer_get_time();
+  CHECK(keyboard.playMacro(macro, sizeof(macro)));
+  waitWhilePlaying(1000 * MS);
+  CHECK(keyboard.getMacroState() == MacroState::TimedOut);
+  int64_t elapsed = esp_timer_get_time() - start;
+  CHECK(elapsed >= 200 * MS - 20 * MS && elapsed <= 200 * MS + 20 * MS);
+  hostsim::sleepFor(50 * MS);
+  for (size_t i = 0; i < hostsim::reportCount(central); i++) {
+    checkReport(i, 0x00, 0); // At most the release of a macro cut short
+  }
+}
+
+int main()
+{
+  keyboard.begin();
+  central = hostsim::connect(NimBLEAddress("11:22:33:44:55:66"));
+  hostsim::subscribe(central);
+  hostsim::sleepFor(50 * MS);
+  RUN(stepsMakeTheirReports);
+  RUN(oneMacroAtATime);
+  RUN(stopReleasesEveryKey);
+  RUN(waitLedTimesOut);
+  return 0;
+}
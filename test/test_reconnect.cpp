@@ -0,0 +1,116 @@
+// Advertising phases after a disconnect, who gets the text typed offline, and
+// the connection parameters asked for while typing and once idle
+
+#include <Arduino.h>
+#include <BleKeyboard.h>
+
+#include "check.h"
+
+#define MS 1000LL
+
+static BleKeyboard keyboard("Reconnect");
+static const NimBLEAddress laptop("aa:00:00:00:00:01");
+static const NimBLEAddress stranger("bb:00:00:00:00:02");
+
+static uint16_t connectLaptop(void)
+{
+  hostsim::CentralOptions bonded;
+  bonded.bonded = true;
+  uint16_t central = hostsim::connect(laptop, bonded);
+  CHECK(central != BLE_HS_CONN_HANDLE_NONE);
+  hostsim::subscribe(central);
+  return central;
+}
+
+TEST(phasesAdvanceOnTimeout)
+{
+  hostsim::AdvertisingState state = hostsim::advertising();
+  CHECK(state.active && !state.directed); // No bonds yet: fast
+  CHECK_EQ(state.durationMs, BLE_KEYBOARD_FAST_ADV_MS);
+  hostsim::sleepFor(BLE_KEYBOARD_FAST_ADV_MS * MS + 10 * MS);
+  state = hostsim::advertising();
+  CHECK(state.active && !state.directed);
+  CHECK_EQ(state.durationMs, 0); // Slow, for good
+
+  uint16_t central = connectLaptop();
+  hostsim::disconnect(central);
+  state = hostsim::advertising();
+  CHECK(state.active && state.directed && state.peer == laptop);
+  hostsim::sleepFor(BLE_KEYBOARD_DIRECTED_ADV_MS * MS + 10 * MS);
+  state = hostsim::advertising();
+  CHECK(state.active && !state.directed);
+  CHECK_EQ(state.durationMs, BLE_KEYBOARD_FAST_ADV_MS);
+}
+
+TEST(backlogGoesToTheHostThatLeft)
+{
+  uint16_t central = connectLaptop();
+  hostsim::disconnect(central);
+  keyboard.resetMetrics();
+  keyboard.print("azer"); // 8 reports into the backlog
+  central = connectLaptop();
+  hostsim::sleepFor(200 * MS);
+  CHECK_EQ(hostsim::reportCount(central), 8);
+  CHECK_EQ(keyboard.getMetrics().reportsReplayed, 8);
+  CHECK_EQ(keyboard.getMetrics().reportsDropped, 0);
+  hostsim::disconnect(central);
+}
+
+TEST(backlogNeverReachesAnotherHost)
+{
+  keyboard.resetMetrics();
+  keyboard.print("azer");
+  // Directed advertising to the laptop first, which the stranger cannot answer
+  CHECK_EQ(hostsim::connect(stranger), BLE_HS_CONN_HANDLE_NONE);
+  hostsim::sleepFor(BLE_KEYBOARD_DIRECTED_ADV_MS * MS + 10 * MS);
+  uint16_t central = hostsim::connect(stranger);
+  CHECK(central != BLE_HS_CONN_HANDLE_NONE);
+  hostsim::subscribe(central);
+  hostsim::sleepFor(200 * MS);
+  CHECK_EQ(hostsim::reportCount(central), 0);
+  CHECK_EQ(keyboard.getMetrics().reportsDropped, 8);
+  CHECK_EQ(keyboard.getMetrics().reportsReplayed, 0);
+  hostsim::disconnect(central);
+
+  // The stranger was not bonded: what is typed after it left is for nobody
+  keyboard.print("azer");
+  central = connectLaptop();
+  hostsim::sleepFor(200 * MS);
+  CHECK_EQ(hostsim::reportCount(central), 0);
+  CHECK_EQ(keyboard.getMetrics().reportsDropped, 16);
+  hostsim::disconnect(central);
+}
+
+// Typing asks every host for the active profile, and idleMs without anything to
+// type for the idle one
+TEST(profileFollowsTheTyping)
+{
+  ConnectionPolicy policy;
+  policy.idleMs = 300;
+  keyboard.setConnectionPolicy(policy);
+  uint16_t central = connectLaptop();
+  hostsim::sleepFor(policy.idleMs * MS + 100 * MS);
+  CHECK(keyboard.getLinkProfile() == LinkProfile::Idle);
+  CHECK_EQ(hostsim::getConnInterval(central), policy.idleMinInterval);
+
+  keyboard.print("azer");
+  hostsim::sleepFor(100 * MS);
+  CHECK(keyboard.getLinkProfile() == LinkProfile::Active);
+  CHECK_EQ(hostsim::getConnInterval(central), policy.activeMinInterval);
+  CHECK_EQ(hostsim::reportCount(central), 8);
+
+  hostsim::sleepFor(policy.idleMs * MS);
+  CHECK(keyboard.getLinkProfile() == LinkProfile::Idle);
+  CHECK_EQ(hostsim::getConnInterval(central), policy.idleMinInterval);
+  hostsim::disconnect(central);
+}
+
+int main()
+{
+  keyboard.begin();
+  RUN(phasesAdvanceOnTimeout);
+  RUN(backlogGoesToTheHostThatLeft);
+  RUN(backlogNeverReachesAnotherHost);
+  RUN(profileFollowsTheTyping);
+  return 0;
+}
@@ -0,0 +1,143 @@
+// The report path against NimBLE's behaviour: NOTIFY_TX arrives within the
+// notify call, and mbufs only come back once the controller has sent them.
+// Also the reportQueued() hook, which every report goes through, and a host
+// that falls behind while another keeps up.
+
+#include <Arduino.h>
+#include <BleKeyboard.h>
+
+#include "check.h"
+
+// Sees every report through the reportQueued() hook
+class HookedKeyboard : public BleKeyboard
+{
+public:
+  HookedKeyboard() : BleKeyboard("Reports") {}
+
+  size_t queued = 0;
+  KeyReport last = {};
+
+protected:
+  void reportQueued(uint16_t connHandle, const KeyReport& report) override
+  {
+    queued++;
+    last = report;
+  }
+};
+
+static HookedKeyboard keyboard;
+static uint16_t central;
+
+// Key of report i, boot layout
+static uint8_t keyOf(size_t i)
+{
+  return hostsim::report(central, i).data[2];
+}
+
+TEST(notifyTxWithinNotify)
+{
+  hostsim::clearReports(central);
+  size_t events = hostsim::notifyTxEvents();
+  keyboard.print("azerty");
+  hostsim::sleepFor(100000);
+  CHECK_EQ(hostsim::reportCount(central), 12);
+  CHECK_EQ(hostsim::notifyTxEvents() - events, 12);
+  CHECK_EQ(hostsim::freeMbufs(), 12);
+  CHECK_EQ(keyOf(0), 0x14); // FR AZERTY 'a'
+  CHECK_EQ(keyOf(1), 0);
+}
+
+// With the link stalled, the pool runs low (below BLE_KEYBOARD_MIN_FREE_MBUFS) and
+// the rest waits in the queue. Nothing is typed afterwards, so the pump timer
+// has to send it once the controller frees the mbufs.
+TEST(resumesWhenMbufsComeBack)
+{
+  hostsim::clearReports(central);
+  keyboard.resetMetrics();
+  hostsim::setStalled(central, true);
+  keyboard.print("qsdfghjklm"); // 20 reports, more than the pool holds
+  CHECK_EQ(hostsim::freeMbufs(), BLE_KEYBOARD_MIN_FREE_MBUFS - 1); // The last one taken with MIN free
+  CHECK_EQ(hostsim::reportCount(central), 0);
+  CHECK(keyboard.getMetrics().reportsFailed > 0);
+  hostsim::setStalled(central, false);
+  hostsim::sleepFor(500000);
+  CHECK_EQ(hostsim::reportCount(central), 20);
+  CHECK_EQ(hostsim::freeMbufs(), 12);
+  CHECK_EQ(keyboard.getMetrics().reportsDropped, 0);
+  CHECK_EQ(keyOf(0), 0x04); // 'q'
+  CHECK_EQ(keyOf(18), 0x33); // 'm'
+}
+
+TEST(hookSeesEveryPath)
+{
+  keyboard.queued = 0;
+  keyboard.setTypingMode(TypingMode::Classic);
+  keyboard.print("A"); // Shift+q, then the release
+  CHECK_EQ(keyboard.queued, 2);
+  keyboard.press(ModifierKey::LeftAlt);
+  CHECK_EQ(keyboard.queued, 3);
+  CHECK_EQ(keyboard.last.modifiers, 0x04);
+  keyboard.releaseAll();
+  keyboard.setTypingMode(TypingMode::Rollover);
+  keyboard.print("A");
+  keyboard.setTypingMode(TypingMode::Classic);
+  CHECK_EQ(keyboard.queued, 6);
+  CHECK_EQ(keyboard.last.modifiers, 0);
+  hostsim::sleepFor(100000);
+}
+
+// A host that does not take its reports (here, not subscribed yet) holds the
+// writer up once, for BLE_KEYBOARD_HOST_STALL_MS, then loses its oldest reports
+// while the other host gets every one. The reports it loses are counted.
+TEST(slowHostDoesNotHoldUpOthers)
+{
+  uint16_t slow = hostsim::connect(NimBLEAddress("11:22:33:44:55:77"));
+  CHECK(slow != BLE_HS_CONN_HANDLE_NONE);
+  hostsim::clearReports(central);
+  keyboard.resetMetrics();
+  keyboard.print("azertyuiopqsdfghjklm"); // 40 reports
+  hostsim::sleepFor(100000);
+  CHECK_EQ(hostsim::reportCount(central), 40);
+  CHECK_EQ(keyboard.getMetrics().reportsDropped, 40 - BLE_KEYBOARD_REPORT_QUEUE_SIZE);
+  CHECK(keyboard.getMetrics().blockedMicros < 2 * BLE_KEYBOARD_HOST_STALL_MS * 1000LL);
+
+  hostsim::subscribe(slow);
+  hostsim::sleepFor(100000);
+  CHECK_EQ(hostsim::reportCount(slow), BLE_KEYBOARD_REPORT_QUEUE_SIZE);
+  CHECK_EQ(hostsim::report(slow, BLE_KEYBOARD_REPORT_QUEUE_SIZE - 1).data[2], 0); // Ends released
+  hostsim::disconnect(slow);
+  hostsim::sleepFor(100000);
+}
+
+// In classic mode each key is held for the delay between its press and its
+// release edges, not released straight away
+TEST(classicHoldsEachKey)
+{
+  hostsim::clearReports(central);
+  keyboard.resetMetrics();
+  keyboard.setTypingMode(TypingMode::Classic);
+  keyboard.setDelay(40);
+  keyboard.print("az");
+  keyboard.setDelay(0);
+  hostsim::sleepFor(100000);
+  CHECK_EQ(hostsim::reportCount(central), 4);
+  for (size_t i = 1; i < 4; i++) {
+    int64_t gap = hostsim::report(central, i).micros - hostsim::report(central, i - 1).micros;
+    CHECK(gap > 40000 - 15000 && gap < 40000 + 15000); // Within a connection interval
+  }
+  CHECK_EQ(keyboard.getMetrics().holds, 3);
+  CHECK(keyboard.getMetrics().holdJitterMaxMicros < 1000);
+}
+
+int main()
+{
+  keyboard.begin();
+  central = hostsim::connect(NimBLEAddress("11:22:33:44:55:66"));
+  hostsim::subscribe(central);
+  RUN(notifyTxWithinNotify);
+  RUN(resumesWhenMbufsComeBack);
+  RUN(hookSeesEveryPath);
+  RUN(slowHostDoesNotHoldUpOthers);
+  RUN(classicHoldsEachKey);
+  return 0;
+}
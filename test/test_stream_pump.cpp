@@ -0,0 +1,196 @@
+// StreamPump against a source that sends faster than the keyboard types and
+// honours XON/XOFF: the source is paused at the high-water mark and resumed
+// once the buffer has drained, through a disconnect too, and every byte it
+// sent is typed once and in order.
+
+#include <Arduino.h>
+#include <BleKeyboard.h>
+#include <StreamPump.h>
+
+#include <string>
+#include <vector>
+
+#include "check.h"
+
+#define MS 1000LL
+
+// Sends its text at one byte per BYTE_MICROS while the pump has not sent XOFF
+class FlowSource : public Stream
+{
+public:
+  static const int64_t BYTE_MICROS = 100;
+
+  struct FlowChange {
+    uint8_t byte;
+    uint32_t buffered; // In the pump when it was sent
+  };
+
+  explicit FlowSource(const std::string& text) : _text(text) {}
+
+  StreamPump* pump = nullptr;
+  std::vector<FlowChange> flow;
+
+  bool paused() const { return _paused; }
+
+  int available() override { return arrived() - _read; }
+
+  int read() override { return available() > 0 ? (uint8_t)_text[_read++] : -1; }
+
+  int peek() override { return available() > 0 ? (uint8_t)_text[_read] : -1; }
+
+  size_t write(uint8_t c) override
+  {
+    CHECK(c == StreamPump::XON || c == StreamPump::XOFF);
+    flow.push_back({c, pump->getProgress().buffered});
+    bool paused = c == StreamPump::XOFF;
+    if (paused != _paused) {
+      _sent = arrived(); // What was on the wire still arrives
+      _since = esp_timer_get_time();
+      _paused = paused;
+    }
+    return 1;
+  }
+
+private:
+  size_t arrived() const
+  {
+    if (_paused) {
+      return _sent;
+    }
+    return std::min(_text.size(), _sent + size_t((esp_timer_get_time() - _since) / BYTE_MICROS));
+  }
+
+  std::string _text;
+  size_t _read = 0;
+  size_t _sent = 0;
+  int64_t _since = 0;
+  bool _paused = true; // Until the pump's first XON
+};
+
+// Keeps what was typed, as UTF-8
+class RecordingKeyboard : public BleKeyboard
+{
+public:
+  RecordingKeyboard() : BleKeyboard("Pump") {}
+
+  std::string typed;
+
+protected:
+  void characterTyped(uint32_t c) override
+  {
+    if (c < 0x80) {
+      typed += char(c);
+    } else if (c < 0x800) {
+      typed += char(0xC0 | c >> 6);
+      typed += char(0x80 | (c & 0x3F));
+    } else {
+      typed += char(0xE0 | c >> 12);
+      typed += char(0x80 | ((c >> 6) & 0x3F));
+      typed += char(0x80 | (c & 0x3F));
+    }
+  }
+};
+
+static RecordingKeyboard keyboard;
+static const NimBLEAddress laptop("11:22:33:44:55:66");
+
+static std::string makeText(size_t lines)
+{
+  std::string text;
+  for (size_t i = 0; i < lines; i++) {
+    text += "ligne " + std::to_string(i) + " : déjà vu, 10 € ou 20 £ ?\n";
+  }
+  return text;
+}
+
+static uint16_t connectLaptop(void)
+{
+  hostsim::CentralOptions bonded;
+  bonded.bonded = true;
+  uint16_t central = hostsim::connect(laptop, bonded);
+  CHECK(central != BLE_HS_CONN_HANDLE_NONE);
+  hostsim::subscribe(central);
+  return central;
+}
+
+static void waitForText(StreamPump& pump, size_t length)
+{
+  for (int i = 0; i < 600 && pump.getProgress().typed < length; i++) {
+    hostsim::sleepFor(100 * MS);
+  }
+  keyboard.flush();
+}
+
+TEST(pausesAtTheWindowAndResumesWhenDrained)
+{
+  uint16_t central = connectLaptop();
+  std::string text = makeText(40);
+  FlowSource source(text);
+  StreamPump pump(keyboard, source);
+  source.pump = &pump;
+  CHECK(pump.begin());
+  waitForText(pump, text.size());
+
+  CHECK(keyboard.typed == text); // Nothing dropped, doubled or reordered
+  PumpProgress progress = pump.getProgress();
+  CHECK_EQ(progress.received, text.size());
+  CHECK_EQ(progress.typed, text.size());
+  CHECK(progress.pauses > 0);
+  CHECK_EQ(keyboard.getMetrics().reportsDropped, 0);
+
+  // XON to start, then XOFF at three quarters of the buffer and XON at a
+  // quarter, in turn
+  CHECK(source.flow.size() >= 3);
+  CHECK_EQ(source.flow[0].byte, StreamPump::XON);
+  for (size_t i = 1; i < source.flow.size(); i++) {
+    const FlowSource::FlowChange& change = source.flow[i];
+    CHECK_EQ(change.byte, i % 2 == 1 ? StreamPump::XOFF : StreamPump::XON);
+    if (change.byte == StreamPump::XOFF) {
+      CHECK(change.buffered >= BLE_KEYBOARD_PUMP_BUFFER_SIZE * 3 / 4);
+    } else {
+      CHECK(change.buffered <= BLE_KEYBOARD_PUMP_BUFFER_SIZE / 4);
+    }
+  }
+  pump.end();
+  hostsim::disconnect(central);
+  hostsim::sleepFor(100 * MS);
+}
+
+TEST(resumesAfterReconnecting)
+{
+  uint16_t central = connectLaptop();
+  std::string text = makeText(40);
+  keyboard.typed.clear();
+  keyboard.resetMetrics();
+  FlowSource source(text);
+  StreamPump pump(keyboard, source);
+  source.pump = &pump;
+  CHECK(pump.begin());
+  hostsim::sleepFor(1000 * MS);
+  CHECK(pump.getState() != PumpState::Offline);
+
+  hostsim::disconnect(central);
+  hostsim::sleepFor(500 * MS);
+  CHECK(pump.getState() == PumpState::Offline);
+  CHECK(source.paused());
+  uint32_t received = pump.getProgress().received;
+  hostsim::sleepFor(500 * MS);
+  CHECK_EQ(pump.getProgress().received, received); // The source held back
+
+  central = connectLaptop();
+  waitForText(pump, text.size());
+  CHECK(pump.getState() == PumpState::Running);
+  CHECK(keyboard.typed == text);
+  CHECK_EQ(pump.getProgress().typed, text.size());
+  CHECK_EQ(keyboard.getMetrics().reportsDropped, 0);
+  CHECK(keyboard.getMetrics().reportsReplayed > 0); // What was typed offline went to the laptop
+  pump.end();
+}
+
+int main()
+{
+  keyboard.begin();
+  RUN(pausesAtTheWindowAndResumesWhenDrained);
+  RUN(resumesAfterReconnecting);
+  return 0;
+}
@@ -0,0 +1,25 @@
+#!/bin/sh
+# Regenerates the layout headers in src/layouts/ from the XKB data of
+# xkeyboard-config. With --check, compares them instead and fails on any
+# difference. FrAzerty.h follows the Windows layout: check it against a KLC
+# export with layoutc.py --klc kbdfr.klc --name FrAzerty --check.
+#
+# The committed tables hold only the characters the layout types exactly;
+# drop --no-substitutes to add approximations for the rest.
+set -e
+cd "$(dirname "$0")"
+
+generate() {
+    if [ "$CHECK" = 1 ]; then
+        python3 layoutc.py --xkb "$1" --name "$2" --check "../src/layouts/$2.h"
+    else
+        python3 layoutc.py --xkb "$1" --name "$2" --no-substitutes -o "../src/layouts/$2.h"
+    fi
+}
+
+CHECK=0
+[ "$1" = "--check" ] && CHECK=1
+
+generate be BeAzerty
+generate ch ChQwertz
+generate fr:bepo Bepo
@@ -0,0 +1,180 @@
+#!/usr/bin/env python3
+"""Virtual HID host: decodes a BleKeyboard KeyReport stream back into text.
+
+The decoder follows the FR AZERTY rules a desktop host applies, including
+dead keys, so report streams captured from the library (or produced by a
+simulation) can be checked against the text that was meant to be typed.
+
+Input is either raw 8-byte KeyReports (--binary) or one report per line
+written as hex bytes, e.g. "02 00 14 00 00 00 00 00".
+
+    hidhost.py reports.txt
+    hidhost.py --binary --expect "Bonjour à tous" reports.bin
+"""
+
+import argparse
+import sys
+
+LCTRL, LSHIFT, LALT, LGUI, RCTRL, RSHIFT, RALT, RGUI = (1 << i for i in range(8))
+
+BACKSPACE = 0x2A
+CAPSLOCK = 0x39
+
+# usage -> (plain, shift, altgr). Dead keys are written as ("dead", accent).
+DEAD_CIRCUMFLEX = ("dead", "^")
+DEAD_DIAERESIS = ("dead", "¨")
+DEAD_GRAVE = ("dead", "`")
+DEAD_TILDE = ("dead", "~")
+
+FR_AZERTY = {
+    0x04: ("q", "Q", None), 0x05: ("b", "B", None), 0x06: ("c", "C", None),
+    0x07: ("d", "D", None), 0x08: ("e", "E", "€"), 0x09: ("f", "F", None),
+    0x0A: ("g", "G", None), 0x0B: ("h", "H", None), 0x0C: ("i", "I", None),
+    0x0D: ("j", "J", None), 0x0E: ("k", "K", None), 0x0F: ("l", "L", None),
+    0x10: (",", "?", None), 0x11: ("n", "N", None), 0x12: ("o", "O", None),
+    0x13: ("p", "P", None), 0x14: ("a", "A", None), 0x15: ("r", "R", None),
+    0x16: ("s", "S", None), 0x17: ("t", "T", None), 0x18: ("u", "U", None),
+    0x19: ("v", "V", None), 0x1A: ("z", "Z", None), 0x1B: ("x", "X", None),
+    0x1C: ("y", "Y", None), 0x1D: ("w", "W", None),
+    0x1E: ("&", "1", None), 0x1F: ("é", "2", DEAD_TILDE),
+    0x20: ('"', "3", "#"), 0x21: ("'", "4", "{"), 0x22: ("(", "5", "["),
+    0x23: ("-", "6", "|"), 0x24: ("è", "7", DEAD_GRAVE), 0x25: ("_", "8", "\\"),
+    0x26: ("ç", "9", "^"), 0x27: ("à", "0", "@"),
+    0x28: ("\n", "\n", None), 0x2B: ("\t", "\t", None), 0x2C: (" ", " ", None),
+    0x2D: (")", "°", "]"), 0x2E: ("=", "+", "}"),
+    0x2F: (DEAD_CIRCUMFLEX, DEAD_DIAERESIS, None), 0x30: ("$", "£", "¤"),
+    0x31: ("*", "µ", None), 0x33: ("m", "M", None), 0x34: ("ù", "%", None),
+    0x35: ("²", None, None), 0x36: (";", ".", None), 0x37: (":", "/", None),
+    0x38: ("!", "§", None), 0x64: ("<", ">", None),
+}
+
+# The digit row, which CapsLock shifts on FR AZERTY like it does the letters
+TOP_ROW = range(0x1E, 0x28)
+
+COMPOSE = {
+    "^": dict(zip("aeiouAEIOU ", "âêîôûÂÊÎÔÛ^")),
+    "¨": dict(zip("aeiouyAEIOUY ", "äëïöüÿÄËÏÖÜŸ¨")),
+    "`": dict(zip("aeiouAEIOU ", "àèìòùÀÈÌÒÙ`")),
+    "~": dict(zip("aonAON ", "ãõñÃÕÑ~")),
+}
+
+
+def caps_lock_keys(layout, top_row):
+    """Keys CapsLock acts on: those typing a lowercase ASCII letter, plus the
+    digit row if top_row, as BleKeyboard::updateCapsLockKeys() sees them."""
+    keys = {key for key, entry in layout.items()
+            if isinstance(entry[0], str) and len(entry[0]) == 1 and "a" <= entry[0] <= "z"}
+    return keys | set(TOP_ROW) if top_row else keys
+
+
+class VirtualHost:
+    """Applies KeyReports the way a host HID stack and FR AZERTY layout would."""
+
+    def __init__(self, layout=None, compose=None, caps_lock=False, caps_top_row=True):
+        self.layout = layout or FR_AZERTY
+        self.compose = compose or COMPOSE
+        self.caps_keys = caps_lock_keys(self.layout, caps_top_row)
+        self.held = set()
+        self.modifiers = 0
+        self.pending_dead = None
+        self.caps_lock = caps_lock
+        self.text = []
+        self.reports = 0
+
+    def feed(self, report):
+        """Applies one report: modifiers byte, reserved byte, then key usages."""
+        self.reports += 1
+        self.modifiers = report[0]
+        keys = [k for k in report[2:] if k != 0]
+        for key in keys:
+            if key not in self.held:
+                self._key_down(key)
+        self.held = set(keys)
+
+    def result(self):
+        return "".join(self.text)
+
+    def _key_down(self, key):
+        if key == CAPSLOCK:
+            self.caps_lock = not self.caps_lock
+            return
+        if key == BACKSPACE:
+            if self.text:
+                self.text.pop()
+            return
+        m = self.modifiers
+        altgr = bool(m & RALT) or (m & (LCTRL | RCTRL) and m & LALT)
+        if not altgr and m & (LCTRL | RCTRL | LALT | LGUI | RGUI):
+            return  # Shortcut, produces no text
+        entry = self.layout.get(key)
+        if entry is None:
+            return
+        shift = bool(m & (LSHIFT | RSHIFT))
+        if self.caps_lock and key in self.caps_keys:
+            shift = not shift
+        out = entry[2] if altgr else entry[1] if shift else entry[0]
+        if out is None:
+            return
+        self._emit(out)
+
+    def _emit(self, out):
+        if isinstance(out, tuple):
+            if self.pending_dead is not None:
+                # Two dead keys in a row: the first one is typed as its accent
+                self.text.append(self.pending_dead)
+            self.pending_dead = out[1]
+            return
+        if self.pending_dead is not None:
+            accent, self.pending_dead = self.pending_dead, None
+            composed = self.compose.get(accent, {}).get(out)
+            if composed is not None:
+                self.text.append(composed)
+                return
+            self.text.append(accent)
+        self.text.append(out)
+
+
+def read_reports(stream, binary, size=8):
+    if binary:
+        data = stream.buffer.read() if hasattr(stream, "buffer") else stream.read()
+        for i in range(0, len(data) - size + 1, size):
+            yield data[i:i + size]
+        return
+    for line in stream:
+        line = line.split("#", 1)[0].strip()
+        if line:
+            yield bytes(int(b, 16) for b in line.replace(",", " ").split())
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("file", nargs="?", help="report stream (default: stdin)")
+    parser.add_argument("--binary", action="store_true", help="input is raw 8-byte reports")
+    parser.add_argument("--expect", help="text the stream should decode to")
+    parser.add_argument("--caps-lock", action="store_true", help="the host has CapsLock on to begin with")
+    args = parser.parse_args(argv)
+
+    mode = "rb" if args.binary else "r"
+    stream = open(args.file, mode) if args.file else sys.stdin
+    host = VirtualHost(caps_lock=args.caps_lock)
+    for report in read_reports(stream, args.binary):
+        host.feed(report)
+    text = host.result()
+    sys.stdout.write(text)
+    if not text.endswith("\n"):
+        sys.stdout.write("\n")
+
+    if args.expect is not None and text != args.expect:
+        for i, (got, want) in enumerate(zip(text, args.expect)):
+            if got != want:
+                break
+        else:
+            i = min(len(text), len(args.expect))
+        print(f"mismatch at character {i}: expected {args.expect[i:i + 20]!r}, got {text[i:i + 20]!r}",
+              file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
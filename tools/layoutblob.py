@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+"""Layout blob writer: packs a keyboard layout into the binary format of src/LayoutBlob.h.
+
+The blob carries the keymap, the dead-key table and the lookup index in the
+in-memory format BleKeyboard uses, so the firmware can use it straight from a
+memory-mapped partition. The input is a layout header from src/layouts/.
+
+    layoutblob.py src/layouts/BeAzerty.h -o BeAzerty.bin
+    parttool.py write_partition --partition-name layout --input BeAzerty.bin
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+import zlib
+
+MAGIC = 0x594C4B42  # "BKLY"
+VERSION = 1
+FLAG_CAPS_TOP_ROW = 0x01
+KEYMAP_NONE = 0xFFFF
+
+HEADER = struct.Struct("<IHHII16sIIIIHBBB3x")
+ENTRY = struct.Struct("<IBBBBB3x")   # KeymapEntry
+DEAD_KEY = struct.Struct("<IBB2x")   # DeadKey
+
+MODIFIERS = {"0": 0, "LSHIFT": 0x02, "ALT_GR": 0x40}
+ENTRY_FLAGS = {"KEYMAP_SUBSTITUTE": 0x01}
+
+CHAR = r"U'(?:\\.|[^'])+'|0x[0-9A-Fa-f]+"
+
+
+def keymap_hash(unicode, hash_bits):
+    """Same Fibonacci hash as keymapHash() in KeyboardLayout.h."""
+    return ((unicode * 2654435761) & 0xFFFFFFFF) >> (32 - hash_bits)
+
+
+def build_index(entries, hash_size):
+    """Same tables as buildKeymapIndex(): direct ASCII table, linear-probed hash."""
+    hash_bits = hash_size.bit_length() - 1
+    ascii = [KEYMAP_NONE] * 128
+    table = [KEYMAP_NONE] * hash_size
+    for i, entry in enumerate(entries):
+        unicode = entry[0]
+        if unicode < 128:
+            ascii[unicode] = i
+            continue
+        slot = keymap_hash(unicode, hash_bits)
+        while table[slot] != KEYMAP_NONE:
+            slot = (slot + 1) & (hash_size - 1)
+        table[slot] = i
+    return ascii, table
+
+
+def build_blob(name, entries, dead_keys, hash_size=None, flags=0):
+    """entries: [(unicode, mods1, key1, mods2, key2, flags)], dead_keys: [(accent, mods, key)]."""
+    if len({e[0] for e in entries}) != len(entries):
+        raise ValueError("keymap contains the same codepoint twice")
+    if hash_size is None:
+        non_ascii = sum(1 for e in entries if e[0] >= 128)
+        hash_size = 16
+        while hash_size < 2 * non_ascii:
+            hash_size *= 2
+    if hash_size & (hash_size - 1) or len(entries) >= hash_size:
+        raise ValueError("hash size must be a power of two larger than the keymap")
+    if any(e[2] >= 0x80 or e[4] >= 0x80 for e in entries):
+        raise ValueError("key usages must be below 0x80")
+    encoded_name = name.encode("utf-8")
+    if len(encoded_name) >= 16:
+        raise ValueError("layout name must be shorter than 16 bytes")
+
+    ascii, table = build_index(entries, hash_size)
+    sections = [
+        b"".join(ENTRY.pack(*e) for e in entries),
+        struct.pack(f"<{len(ascii)}H", *ascii),
+        struct.pack(f"<{len(table)}H", *table),
+        b"".join(DEAD_KEY.pack(*d) for d in dead_keys),
+    ]
+    offsets = []
+    body = b""
+    for section in sections:
+        body += b"\0" * (-len(body) % 4)
+        offsets.append(HEADER.size + len(body))
+        body += section
+
+    header = HEADER.pack(MAGIC, VERSION, HEADER.size, HEADER.size + len(body), zlib.crc32(body),
+                         encoded_name, *offsets, len(entries), hash_size.bit_length() - 1,
+                         len(dead_keys), flags)
+    return header + body
+
+
+def parse_char(token):
+    if token.startswith("0x"):
+        return int(token, 16)
+    text = token[2:-1]
+    escapes = {"\\n": "\n", "\\t": "\t", "\\'": "'", "\\\\": "\\"}
+    return ord(escapes.get(text, text))
+
+
+def parse_expr(expr, names):
+    value = 0
+    for term in expr.split("|"):
+        term = term.strip()
+        value |= names[term] if term in names else int(term, 0)
+    return value
+
+
+def parse_layout_header(path):
+    """Reads a src/layouts/ header: returns (name, entries, dead_keys, hash_size, flags)."""
+    with open(path, encoding="utf-8") as f:
+        text = f.read()
+    with open(os.path.join(os.path.dirname(path), "..", "KeyboardLayout.h"), encoding="utf-8") as f:
+        usages = {m.group(1): int(m.group(2), 16) for m in re.finditer(r"#define (KC_\w+) (0x[0-9A-F]+)", f.read())}
+    names = dict(MODIFIERS, **usages)
+
+    keymap = re.search(r"KeymapEntry \w+\[\] = \{(.*?)\n\};", text, re.S).group(1)
+    entries = []
+    for m in re.finditer(rf"\{{\s*({CHAR})\s*,\s*\{{([^}}]*)\}}\s*(?:,\s*(\w+))?\s*\}}", keymap):
+        sequence = [parse_expr(part, names) for part in m.group(2).split(",")]
+        entries.append((parse_char(m.group(1)), *sequence, ENTRY_FLAGS.get(m.group(3), 0)))
+
+    dead = re.search(r"DeadKey \w+\[\] = \{(.*?)\n\};", text, re.S).group(1)
+    dead_keys = [(parse_char(m.group(1)), parse_expr(m.group(2), names), parse_expr(m.group(3), names))
+                 for m in re.finditer(rf"\{{\s*({CHAR})\s*,\s*([^,]+),\s*(\w+)\s*\}}", dead)]
+
+    hash_size = int(re.search(r"buildKeymapIndex<(\d+)>", text).group(1))
+    layout = re.search(r'makeKeyboardLayout\("([^"]+)"([^;]*)\);', text)
+    flags = FLAG_CAPS_TOP_ROW if re.search(r",\s*true\s*\)?$", layout.group(2)) else 0
+    return layout.group(1), entries, dead_keys, hash_size, flags
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("layout", help="layout header, e.g. src/layouts/BeAzerty.h")
+    parser.add_argument("-o", "--output", required=True, help="blob file to write")
+    args = parser.parse_args(argv)
+
+    name, entries, dead_keys, hash_size, flags = parse_layout_header(args.layout)
+    blob = build_blob(name, entries, dead_keys, hash_size, flags)
+    with open(args.output, "wb") as f:
+        f.write(blob)
+    print(f"{name}: {len(entries)} characters, {len(dead_keys)} dead keys, {len(blob)} bytes")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
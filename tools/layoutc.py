@@ -0,0 +1,475 @@
+#!/usr/bin/env python3
+"""Layout compiler: generates BleKeyboard keymap tables from XKB or KLC layouts.
+
+Reads an XKB symbols file (resolving its includes) or a Windows KLC file
+(from Microsoft Keyboard Layout Creator) and writes a C++ header with the
+constexpr keymap, dead-key table, lookup index and KeyboardLayout object
+used by BleKeyboard. Characters the layout cannot type are approximated
+with one or two other keystrokes and flagged KEYMAP_SUBSTITUTE.
+
+    layoutc.py --xkb fr:bepo --name Bepo -o src/layouts/Bepo.h
+    layoutc.py --klc kbdfr.klc --name FrAzerty --report
+    layoutc.py --klc kbdfr.klc --name FrAzerty --check src/layouts/FrAzerty.h
+"""
+
+import argparse
+import os
+import re
+import sys
+import unicodedata
+
+from layoutblob import parse_layout_header
+
+LSHIFT = 0x02
+ALT_GR = 0x40
+LEVEL_MODIFIERS = [0, LSHIFT, ALT_GR, LSHIFT | ALT_GR]
+
+# XKB key name -> HID keyboard usage ID
+XKB_USAGES = {
+    "TLDE": 0x35, "AE01": 0x1E, "AE02": 0x1F, "AE03": 0x20, "AE04": 0x21,
+    "AE05": 0x22, "AE06": 0x23, "AE07": 0x24, "AE08": 0x25, "AE09": 0x26,
+    "AE10": 0x27, "AE11": 0x2D, "AE12": 0x2E,
+    "AD01": 0x14, "AD02": 0x1A, "AD03": 0x08, "AD04": 0x15, "AD05": 0x17,
+    "AD06": 0x1C, "AD07": 0x18, "AD08": 0x0C, "AD09": 0x12, "AD10": 0x13,
+    "AD11": 0x2F, "AD12": 0x30,
+    "AC01": 0x04, "AC02": 0x16, "AC03": 0x07, "AC04": 0x09, "AC05": 0x0A,
+    "AC06": 0x0B, "AC07": 0x0D, "AC08": 0x0E, "AC09": 0x0F, "AC10": 0x33,
+    "AC11": 0x34, "BKSL": 0x31,
+    "LSGT": 0x64, "AB01": 0x1D, "AB02": 0x1B, "AB03": 0x06, "AB04": 0x19,
+    "AB05": 0x05, "AB06": 0x11, "AB07": 0x10, "AB08": 0x36, "AB09": 0x37,
+    "AB10": 0x38, "SPCE": 0x2C,
+}
+
+# PC scan code (as used in KLC files) -> HID keyboard usage ID
+SCAN_CODE_USAGES = {
+    0x29: 0x35, 0x02: 0x1E, 0x03: 0x1F, 0x04: 0x20, 0x05: 0x21, 0x06: 0x22,
+    0x07: 0x23, 0x08: 0x24, 0x09: 0x25, 0x0A: 0x26, 0x0B: 0x27, 0x0C: 0x2D,
+    0x0D: 0x2E,
+    0x10: 0x14, 0x11: 0x1A, 0x12: 0x08, 0x13: 0x15, 0x14: 0x17, 0x15: 0x1C,
+    0x16: 0x18, 0x17: 0x0C, 0x18: 0x12, 0x19: 0x13, 0x1A: 0x2F, 0x1B: 0x30,
+    0x1E: 0x04, 0x1F: 0x16, 0x20: 0x07, 0x21: 0x09, 0x22: 0x0A, 0x23: 0x0B,
+    0x24: 0x0D, 0x25: 0x0E, 0x26: 0x0F, 0x27: 0x33, 0x28: 0x34, 0x2B: 0x31,
+    0x56: 0x64, 0x2C: 0x1D, 0x2D: 0x1B, 0x2E: 0x06, 0x2F: 0x19, 0x30: 0x05,
+    0x31: 0x11, 0x32: 0x10, 0x33: 0x36, 0x34: 0x37, 0x35: 0x38, 0x39: 0x2C,
+}
+
+# KLC shift state column -> level (Ctrl+Alt is AltGr)
+KLC_LEVELS = {0: 0, 1: 1, 6: 2, 7: 3}
+
+# HID usage ID -> KC_ name used in the generated tables (see KeyboardLayout.h)
+USAGE_NAMES = {0x04 + i: "KC_" + chr(ord("A") + i) for i in range(26)}
+USAGE_NAMES.update({0x1E + i: "KC_" + str((i + 1) % 10) for i in range(10)})
+USAGE_NAMES.update({
+    0x28: "KC_RETURN", 0x2B: "KC_TAB", 0x2C: "KC_SPACE", 0x2D: "KC_MINUS",
+    0x2E: "KC_EQUAL", 0x2F: "KC_LEFT_BRACKET", 0x30: "KC_RIGHT_BRACKET",
+    0x31: "KC_BACKSLASH", 0x32: "KC_NON_US_HASH", 0x33: "KC_SEMICOLON",
+    0x34: "KC_QUOTE", 0x35: "KC_GRAVE", 0x36: "KC_COMMA", 0x37: "KC_PERIOD",
+    0x38: "KC_SLASH", 0x64: "KC_NON_US_BACKSLASH",
+})
+
+# Dead keysym -> (combining mark, spacing accent typed by dead key + space)
+DEAD_KEYS = {
+    "dead_grave": ("̀", "`"), "dead_acute": ("́", "´"),
+    "dead_circumflex": ("̂", "^"), "dead_tilde": ("̃", "~"),
+    "dead_macron": ("̄", "¯"), "dead_breve": ("̆", "˘"),
+    "dead_abovedot": ("̇", "˙"), "dead_diaeresis": ("̈", "¨"),
+    "dead_abovering": ("̊", "˚"), "dead_doubleacute": ("̋", "˝"),
+    "dead_caron": ("̌", "ˇ"), "dead_cedilla": ("̧", "¸"),
+    "dead_ogonek": ("̨", "˛"),
+}
+
+# Approximations for characters a layout cannot type, tried before dropping
+# diacritics. At most two keystrokes each.
+SUBSTITUTES = {
+    "œ": "oe", "Œ": "OE", "æ": "ae", "Æ": "AE", "ß": "ss", "ẞ": "SS",
+    " ": " ", "‘": "'", "’": "'", "‚": ",", "‛": "'", "“": '"', "”": '"',
+    "„": '"', "‟": '"', "«": '"', "»": '"', "‹": "<", "›": ">", "‐": "-",
+    "‑": "-", "‒": "-", "–": "-", "—": "-", "―": "-", "−": "-", "…": "..",
+    "•": "*", "·": ".", "′": "'", "″": '"', "™": "TM", "©": "c", "®": "R",
+    "¢": "ct", "¡": "!", "¿": "?", "×": "x", "÷": ":", "¦": "|", "ð": "d",
+    "Ð": "D", "þ": "th", "Þ": "TH", "ø": "o", "Ø": "O", "ł": "l", "Ł": "L",
+    "đ": "d", "Đ": "D", "ħ": "h", "Ħ": "H", "ı": "i", "ŀ": "l", "Ŀ": "L",
+    "ŋ": "n", "Ŋ": "N", "ŧ": "t", "Ŧ": "T", "ĸ": "k", "ſ": "s", "¥": "Y",
+    "±": "+-",
+}
+
+BLOCKS = [
+    ("Basic Latin", 0x20, 0x7E),
+    ("Latin-1 Supplement", 0xA0, 0xFF),
+    ("Latin Extended-A", 0x100, 0x17F),
+    ("General Punctuation", 0x2010, 0x203A),
+]
+
+
+def in_scope(ch):
+    """Characters worth a table entry: Latin, Latin-1, Latin Extended-A and common typography."""
+    cp = ord(ch)
+    return (0x20 <= cp < 0x7F or 0xA0 <= cp <= 0x17F or 0x2010 <= cp <= 0x203A
+            or cp in (0x20AC, 0x2122, 0x2212, 0x1E9E))
+
+
+class DeadKey:
+    """A dead key: the spacing accent it types before a space, and what it composes."""
+
+    def __init__(self, name, spacing, compose):
+        self.name = name
+        self.spacing = spacing
+        self.compose = compose  # base character -> composed character
+
+    def composed(self, base):
+        return self.spacing if base == " " else self.compose(base)
+
+
+def load_keysyms(path):
+    keysyms = {}
+    pattern = re.compile(r"#define XK_(\w+)\s+0x[0-9a-f]+\s*/\*\s*U\+([0-9A-F]{4,6})")
+    with open(path, encoding="latin-1") as f:
+        for line in f:
+            m = pattern.match(line)
+            if m:
+                keysyms.setdefault(m.group(1), chr(int(m.group(2), 16)))
+    return keysyms
+
+
+def xkb_dead_key(name):
+    combining, spacing = DEAD_KEYS[name]
+    return DeadKey(name, spacing, lambda base: unicodedata.normalize("NFC", base + combining))
+
+
+def keysym_value(name, keysyms):
+    if name in DEAD_KEYS:
+        return xkb_dead_key(name)
+    if re.fullmatch(r"U[0-9A-Fa-f]{4,6}", name):
+        return chr(int(name[1:], 16))
+    if len(name) == 1:
+        return name
+    return keysyms.get(name)
+
+
+class XkbReader:
+    """Minimal XKB symbols reader: key definitions and includes, merged level by level."""
+
+    def __init__(self, root):
+        self.root = root
+        self.order = 0
+
+    def read(self, spec, keys=None, depth=0):
+        """Returns {key name: [(keysym, include depth, definition order) per level]}."""
+        keys = {} if keys is None else keys
+        name, _, variant = spec.partition("(")
+        variant = variant.rstrip(")")
+        if ":" in name:
+            name, variant = name.split(":", 1)
+        path = name if os.path.isabs(name) else os.path.join(self.root, name)
+        if not os.path.exists(path):
+            return keys
+        with open(path, encoding="utf-8") as f:
+            body = self._variant_body(f.read(), variant)
+        body = re.sub(r"//[^\n]*", "", body)
+        for m in re.finditer(r'include\s+"([^"]+)"|key\s+<(\w+)>\s*\{([^;]*?)\}\s*;', body, re.S):
+            if m.group(1):
+                for part in m.group(1).split("+"):
+                    self.read(part, keys, depth + 1)
+                continue
+            levels = re.search(r"\[([^\]]*)\]", m.group(3))
+            if not levels:
+                continue
+            syms = [s.strip() for s in levels.group(1).split(",")]
+            merged = keys.setdefault(m.group(2), [])
+            for i, sym in enumerate(syms):
+                if i >= len(merged):
+                    merged.append(None)
+                if sym and sym != "NoSymbol":
+                    merged[i] = (sym, depth, self.order)
+                    self.order += 1
+        return keys
+
+    @staticmethod
+    def _variant_body(text, variant):
+        blocks = list(re.finditer(r'((?:\w+\s+)*)xkb_symbols\s+"([^"]+)"\s*\{', text))
+        for m in blocks:
+            if m.group(2) == variant or (not variant and "default" in m.group(1)):
+                depth, i = 1, m.end()
+                while depth and i < len(text):
+                    depth += {"{": 1, "}": -1}.get(text[i], 0)
+                    i += 1
+                return text[m.end():i - 1]
+        raise SystemExit(f"variant {variant!r} not found")
+
+
+def read_xkb(spec, root, keysymdef):
+    """Returns (candidates, caps_top_row): candidates are (level, depth, order, usage, value)."""
+    keysyms = load_keysyms(keysymdef)
+    keys = XkbReader(root).read(spec)
+    keys.setdefault("SPCE", [("space", 0, 0)])
+    candidates = []
+    for key, syms in keys.items():
+        if key not in XKB_USAGES:
+            continue
+        for level, sym in enumerate(syms[:4]):
+            if sym is None:
+                continue
+            value = keysym_value(sym[0], keysyms)
+            if value is not None:
+                candidates.append((level, sym[1], sym[2], XKB_USAGES[key], value))
+    return candidates, False
+
+
+def read_klc_text(path):
+    with open(path, "rb") as f:
+        raw = f.read()
+    if raw.startswith(b"\xff\xfe") or raw.startswith(b"\xfe\xff"):
+        return raw.decode("utf-16")
+    try:
+        return raw.decode("utf-8-sig")
+    except UnicodeDecodeError:
+        return raw.decode("cp1252")
+
+
+def klc_char(token):
+    """A KLC character cell: 4-6 hex digits or the character itself, '@' marks a dead key."""
+    dead = token.endswith("@")
+    token = token.rstrip("@")
+    if token in ("-1", "%%"):
+        return None, False
+    if len(token) == 1:
+        return token, dead
+    return chr(int(token, 16)), dead
+
+
+def read_klc(path):
+    """Returns (candidates, caps_top_row) from a Windows KLC file."""
+    lines = [line.split("//")[0].strip() for line in read_klc_text(path).splitlines()]
+    section, states, order = None, [], 0
+    cells, compositions, caps_top_row = [], {}, False
+    current_dead = None
+    for line in lines:
+        if not line or line.startswith(";"):
+            continue
+        words = line.split()
+        keyword = words[0].upper()
+        if keyword in ("SHIFTSTATE", "LAYOUT", "KEYNAME", "KEYNAME_EXT", "KEYNAME_DEAD",
+                       "DESCRIPTIONS", "LANGUAGENAMES", "LIGATURE", "ENDKBD", "KBD",
+                       "COPYRIGHT", "COMPANY", "LOCALENAME", "LOCALEID", "VERSION", "ATTRIBUTES"):
+            section = keyword
+            continue
+        if keyword == "DEADKEY":
+            section = keyword
+            current_dead = chr(int(words[1], 16))
+            compositions[current_dead] = {}
+            continue
+        if section == "SHIFTSTATE":
+            states.append(int(words[0]))
+        elif section == "LAYOUT" and re.fullmatch(r"[0-9a-fA-F]{2}", words[0]):
+            scan_code = int(words[0], 16)
+            if scan_code not in SCAN_CODE_USAGES or len(words) < 3:
+                continue
+            usage = SCAN_CODE_USAGES[scan_code]
+            if 0x1E <= usage <= 0x27 and words[2] == "1":
+                caps_top_row = True  # CapsLock acts as Shift on the digit row
+            for state, token in zip(states, words[3:]):
+                if state not in KLC_LEVELS:
+                    continue
+                ch, dead = klc_char(token)
+                if ch is not None:
+                    cells.append((KLC_LEVELS[state], usage, ch, dead, order))
+                    order += 1
+        elif section == "DEADKEY" and len(words) >= 2:
+            compositions[current_dead][chr(int(words[0], 16))] = chr(int(words[1], 16))
+
+    candidates = []
+    for level, usage, ch, dead, order in cells:
+        if dead:
+            table = compositions.get(ch, {})
+            spacing = table.get(" ", ch)
+            value = DeadKey(f"dead {ch}", spacing, table.get)
+        else:
+            value = ch
+        candidates.append((level, 0, order, usage, value))
+    return candidates, caps_top_row
+
+
+def build_layout(candidates, substitutes=True):
+    """Returns (entries, dead_keys).
+
+    entries maps char -> (mods1, key1, mods2, key2, substitute) and dead_keys
+    maps spacing accent -> (mods, key, name).
+    """
+    entries = {"\n": (0, 0x28, 0, 0, False), "\t": (0, 0x2B, 0, 0, False)}
+    dead = {}
+    dead_order = []
+    # Fewest modifiers first, then keys the layout defines itself over inherited
+    # ones, then the order of definition
+    for level, _, _, usage, value in sorted(candidates, key=lambda c: c[:4]):
+        if isinstance(value, DeadKey):
+            if value.spacing not in dead:
+                dead[value.spacing] = (LEVEL_MODIFIERS[level], usage, value.name)
+                dead_order.append(value)
+        elif in_scope(value) and value not in entries:
+            entries[value] = (LEVEL_MODIFIERS[level], usage, 0, 0, False)
+
+    direct = dict(entries)
+    for dead_key in dead_order:
+        mods, usage, _ = dead[dead_key.spacing]
+        for base, seq in sorted(direct.items()):
+            composed = dead_key.composed(base)
+            if composed and len(composed) == 1 and in_scope(composed) and composed not in entries:
+                entries[composed] = (mods, usage, seq[0], seq[1], False)
+
+    if substitutes:
+        add_substitutes(entries, direct)
+    return entries, dead
+
+
+def add_substitutes(entries, direct):
+    """Approximates in-scope characters the layout cannot type with one or two direct keystrokes."""
+    for cp in range(0x20, 0x2213):
+        ch = chr(cp)
+        if not in_scope(ch) or ch in entries or unicodedata.category(ch)[0] == "C":
+            continue
+        text = SUBSTITUTES.get(ch)
+        if text is None:
+            text = "".join(c for c in unicodedata.normalize("NFKD", ch) if not unicodedata.combining(c))
+        if not 1 <= len(text) <= 2 or text == ch or any(c not in direct for c in text):
+            continue
+        if text.isspace() and not ch.isspace():
+            continue  # Spacing accents such as ¸ decompose to a bare space
+        first = direct[text[0]]
+        second = direct[text[1]] if len(text) == 2 else (0, 0)
+        entries[ch] = (first[0], first[1], second[0], second[1], True)
+
+
+def modifier_name(mods):
+    names = [name for bit, name in ((LSHIFT, "LSHIFT"), (ALT_GR, "ALT_GR")) if mods & bit]
+    return " | ".join(names) if names else "0"
+
+
+def c_char(ch):
+    if ch == "'":
+        return "U'\\''"
+    if ch == "\\":
+        return "U'\\\\'"
+    if ch == "\n":
+        return "U'\\n'"
+    if ch == "\t":
+        return "U'\\t'"
+    if unicodedata.category(ch)[0] in "LNPS" or ch == " ":
+        return f"U'{ch}'"
+    return f"0x{ord(ch):04X}"
+
+
+def emit_header(name, source, entries, dead, caps_top_row):
+    symbol = f"Layout{name}"
+    prefix = name[0].lower() + name[1:]
+    non_ascii = sum(1 for ch in entries if ord(ch) >= 128)
+    hash_size = 16
+    while hash_size < 2 * non_ascii:
+        hash_size *= 2
+
+    out = [f"#ifndef ESP32_BLE_KEYBOARD_LAYOUT_{name.upper()}_H",
+           f"#define ESP32_BLE_KEYBOARD_LAYOUT_{name.upper()}_H",
+           "",
+           '#include "../KeyboardLayout.h"',
+           "",
+           f"// {name} keymap, generated from the {source}",
+           f"inline constexpr KeymapEntry {prefix}Keymap[] = {{"]
+    for ch, (m1, k1, m2, k2, substitute) in sorted(entries.items(), key=lambda e: ord(e[0])):
+        key2 = USAGE_NAMES[k2] if k2 else "0"
+        tail = ", KEYMAP_SUBSTITUTE" if substitute else ""
+        out.append(f"    {{{c_char(ch)}, {{{modifier_name(m1)}, {USAGE_NAMES[k1]}, {modifier_name(m2)}, {key2}}}{tail}}},")
+    out.append("};")
+    out.append("")
+    out.append(f"inline constexpr DeadKey {prefix}DeadKeys[] = {{")
+    for spacing, (mods, usage, dead_name) in dead.items():
+        out.append(f"    {{{c_char(spacing)}, {modifier_name(mods)}, {USAGE_NAMES[usage]}}}, // {dead_name}")
+    out.append("};")
+    out.append("")
+    out.append(f'static_assert(!keymapHasDuplicates({prefix}Keymap), "{prefix}Keymap contains the same codepoint twice");')
+    out.append("")
+    out.append(f"inline constexpr auto {prefix}Index = buildKeymapIndex<{hash_size}>({prefix}Keymap);")
+    caps = ", true" if caps_top_row else ""
+    out.append(f'inline constexpr KeyboardLayout {symbol} = makeKeyboardLayout("{name}", {prefix}Keymap, {prefix}Index, {prefix}DeadKeys{caps});')
+    out.append("")
+    out.append(f"#endif // ESP32_BLE_KEYBOARD_LAYOUT_{name.upper()}_H")
+    return "\n".join(out) + "\n"
+
+
+def coverage_report(name, entries):
+    lines = [f"{name}: {len(entries)} characters"]
+    for block, first, last in BLOCKS:
+        chars = [chr(cp) for cp in range(first, last + 1)
+                 if in_scope(chr(cp)) and unicodedata.category(chr(cp))[0] != "C"]
+        exact = [ch for ch in chars if ch in entries and not entries[ch][4]]
+        substituted = [ch for ch in chars if ch in entries and entries[ch][4]]
+        missing = [ch for ch in chars if ch not in entries]
+        lines.append(f"  {block:20} {len(exact):3} exact, {len(substituted):3} substituted, "
+                     f"{len(missing):3} missing of {len(chars)}")
+        if missing:
+            lines.append("    missing: " + " ".join(missing))
+    return "\n".join(lines)
+
+
+def check_header(path, entries):
+    """Compares a layout header, e.g. a hand-written one, with the generated tables."""
+    _, existing, _, _, _ = parse_layout_header(path)
+    problems = []
+    for unicode, m1, k1, m2, k2, flags in existing:
+        ch = chr(unicode)
+        sequence = (m1, k1, m2, k2)
+        substitute = bool(flags & 0x01)
+        generated = entries.get(ch)
+        if generated is None:
+            if not substitute:
+                problems.append(f"U+{unicode:04X} {ch!r}: not typeable on this layout")
+        elif substitute and not generated[4]:
+            problems.append(f"U+{unicode:04X} {ch!r}: marked as a substitute but the layout types it exactly")
+        elif not substitute and generated[4]:
+            problems.append(f"U+{unicode:04X} {ch!r}: approximated but not marked KEYMAP_SUBSTITUTE")
+        elif not substitute and sequence != generated[:4]:
+            problems.append(f"U+{unicode:04X} {ch!r}: keystrokes differ from the layout")
+    return problems
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--xkb", help="symbols file and variant, e.g. fr:bepo or /path/to/file:variant")
+    source.add_argument("--klc", help="Windows KLC file")
+    parser.add_argument("--xkb-root", default="/usr/share/X11/xkb/symbols")
+    parser.add_argument("--keysymdef", default="/usr/include/X11/keysymdef.h")
+    parser.add_argument("--name", required=True, help="layout name, e.g. BeAzerty")
+    parser.add_argument("--caps-top-row", action="store_true",
+                        help="CapsLock acts as Shift on the digit row (read from the Cap column for KLC)")
+    parser.add_argument("--no-substitutes", action="store_true", help="only emit characters the layout types exactly")
+    parser.add_argument("--report", action="store_true", help="print a coverage report to stderr")
+    parser.add_argument("--check", metavar="HEADER", help="compare an existing layout header with the layout")
+    parser.add_argument("-o", "--output", help="output header (default: stdout)")
+    args = parser.parse_args(argv)
+
+    if args.xkb:
+        candidates, caps_top_row = read_xkb(args.xkb, args.xkb_root, args.keysymdef)
+        description = f'XKB "{args.xkb}" symbols'
+    else:
+        candidates, caps_top_row = read_klc(args.klc)
+        description = f'KLC "{os.path.basename(args.klc)}" layout'
+    entries, dead = build_layout(candidates, substitutes=not args.no_substitutes)
+
+    if args.report:
+        print(coverage_report(args.name, entries), file=sys.stderr)
+    if args.check:
+        problems = check_header(args.check, entries)
+        for problem in problems:
+            print(f"{args.check}: {problem}", file=sys.stderr)
+        return 1 if problems else 0
+
+    header = emit_header(args.name, description, entries, dead, caps_top_row or args.caps_top_row)
+    if args.output:
+        with open(args.output, "w", encoding="utf-8") as f:
+            f.write(header)
+    else:
+        sys.stdout.write(header)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,229 @@
+#!/usr/bin/env python3
+"""Key macro assembler: turns a macro source file into the bytecode of src/KeyMacro.h.
+
+One step per line, '#' starts a comment:
+
+    press ctrl              # modifiers and/or a key, '+'-separated
+    chord ctrl+c            # pressed, then released
+    hold shift+right 500    # pressed, released 500 ms later
+    release ctrl
+    wait 200                # ms
+    type "Bonjour à tous\\n" # typed with the layout the keyboard uses
+    waitled caps on 1000    # until CapsLock is on, stop after 1000 ms
+    releaseall
+
+Keys are named (enter, f5, left, ...) or given as a single character, which is
+looked up in the layout header passed with --layout, the library default if
+omitted: on AZERTY "ctrl+a" is the key that types "a", not the QWERTY A key.
+The macro is checked as it is assembled: unknown keys, characters the layout
+cannot type, keys released without being pressed and keys still held at the
+end are errors.
+
+    macroasm.py copypaste.macro --name copyPaste -o CopyPaste.h
+    macroasm.py copypaste.macro --binary -o copypaste.bin
+"""
+
+import argparse
+import os
+import shlex
+import sys
+
+from layoutblob import parse_layout_header
+
+MAGIC = b"KM"
+VERSION = 1
+
+END, PRESS, RELEASE, CHORD, HOLD, WAIT, TYPE, WAIT_LED, RELEASE_ALL = range(9)
+
+MODIFIERS = {
+    "ctrl": 0x01, "lctrl": 0x01, "shift": 0x02, "lshift": 0x02, "alt": 0x04, "lalt": 0x04,
+    "gui": 0x08, "lgui": 0x08, "win": 0x08, "cmd": 0x08,
+    "rctrl": 0x10, "rshift": 0x20, "ralt": 0x40, "altgr": 0x40, "rgui": 0x80,
+}
+
+KEYS = {
+    "enter": 0x28, "return": 0x28, "esc": 0x29, "escape": 0x29, "backspace": 0x2A, "tab": 0x2B,
+    "space": 0x2C, "capslock": 0x39, "printscreen": 0x46, "scrolllock": 0x47, "pause": 0x48,
+    "insert": 0x49, "home": 0x4A, "pageup": 0x4B, "delete": 0x4C, "end": 0x4D, "pagedown": 0x4E,
+    "right": 0x4F, "left": 0x50, "down": 0x51, "up": 0x52, "numlock": 0x53, "menu": 0x65,
+}
+KEYS.update({f"f{i}": 0x3A + i - 1 for i in range(1, 13)})
+KEYS.update({f"f{i}": 0x68 + i - 13 for i in range(13, 25)})
+
+LEDS = {"num": 0x01, "caps": 0x02, "scroll": 0x04, "compose": 0x08, "kana": 0x10}
+
+DEFAULT_LAYOUT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "src", "layouts", "FrAzerty.h")
+
+
+class MacroError(Exception):
+    pass
+
+
+class Assembler:
+    def __init__(self, layout_path):
+        _, entries, _, _, _ = parse_layout_header(layout_path)
+        self.keymap = {e[0]: e for e in entries}
+        self.code = bytearray()
+        self.held_modifiers = 0
+        self.held_keys = set()
+
+    def key_combo(self, text):
+        """'ctrl+shift+a' -> (modifiers, usage)"""
+        modifiers, usage = 0, 0
+        if text == "+":
+            parts = ["+"]
+        elif text.endswith("++"):
+            parts = text[:-2].split("+") + ["+"]
+        else:
+            parts = text.split("+")
+        for part in parts:
+            name = part.lower()
+            if name in MODIFIERS:
+                modifiers |= MODIFIERS[name]
+            elif usage != 0:
+                raise MacroError(f"more than one key in '{text}'")
+            elif name in KEYS:
+                usage = KEYS[name]
+            elif len(part) == 1:
+                mods, usage = self.character_key(part)
+                modifiers |= mods
+            else:
+                raise MacroError(f"unknown key '{part}'")
+        return modifiers, usage
+
+    def character_key(self, ch):
+        entry = self.keymap.get(ord(ch))
+        if entry is None:
+            raise MacroError(f"'{ch}' is not in the layout")
+        _, mods1, key1, _, key2, _ = entry
+        if key2 != 0:
+            raise MacroError(f"'{ch}' needs a dead key, it cannot be part of a chord")
+        return mods1, key1
+
+    def duration(self, text, what="duration"):
+        try:
+            ms = int(text, 0)
+        except ValueError:
+            raise MacroError(f"invalid {what} '{text}'") from None
+        if not 0 <= ms <= 0xFFFF:
+            raise MacroError(f"{what} must be 0 to 65535 ms")
+        return ms
+
+    def step(self, line):
+        args = shlex.split(line, comments=True, posix=True)
+        if not args:
+            return
+        op, args = args[0].lower(), args[1:]
+        expected = {"press": 1, "release": 1, "chord": 1, "hold": 2, "wait": 1, "type": 1, "waitled": 3,
+                    "releaseall": 0}
+        if op not in expected:
+            raise MacroError(f"unknown step '{op}'")
+        if len(args) != expected[op]:
+            raise MacroError(f"'{op}' takes {expected[op]} argument(s)")
+
+        if op in ("press", "release", "chord", "hold"):
+            modifiers, usage = self.key_combo(args[0])
+            if op == "press":
+                self.held_modifiers |= modifiers
+                if usage:
+                    self.held_keys.add(usage)
+            elif op == "release":
+                if modifiers & ~self.held_modifiers or (usage and usage not in self.held_keys):
+                    raise MacroError(f"'{args[0]}' released without being pressed")
+                self.held_modifiers &= ~modifiers
+                self.held_keys.discard(usage)
+            opcode = {"press": PRESS, "release": RELEASE, "chord": CHORD, "hold": HOLD}[op]
+            self.code += bytes([opcode, modifiers, usage])
+            if op == "hold":
+                self.code += self.duration(args[1]).to_bytes(2, "little")
+        elif op == "wait":
+            self.code += bytes([WAIT]) + self.duration(args[0]).to_bytes(2, "little")
+        elif op == "type":
+            self.type_text(args[0])
+        elif op == "waitled":
+            led, state, timeout = args
+            if led.lower() not in LEDS or state.lower() not in ("on", "off"):
+                raise MacroError("waitled takes an LED (num, caps, scroll, compose, kana), on or off, and a timeout")
+            mask = LEDS[led.lower()]
+            self.code += bytes([WAIT_LED, mask, mask if state.lower() == "on" else 0])
+            self.code += self.duration(timeout, "timeout").to_bytes(2, "little")
+        else:
+            self.code += bytes([RELEASE_ALL])
+            self.held_modifiers = 0
+            self.held_keys.clear()
+
+    def type_text(self, text):
+        text = text.encode("latin-1", "backslashreplace").decode("unicode_escape") if "\\" in text else text
+        missing = sorted({ch for ch in text if ord(ch) not in self.keymap})
+        if missing:
+            raise MacroError("not in the layout: " + " ".join(repr(ch) for ch in missing))
+        # Split into steps of at most 255 bytes, between characters
+        chunk = b""
+        for ch in text:
+            encoded = ch.encode("utf-8")
+            if len(chunk) + len(encoded) > 255:
+                self.code += bytes([TYPE, len(chunk)]) + chunk
+                chunk = b""
+            chunk += encoded
+        if chunk:
+            self.code += bytes([TYPE, len(chunk)]) + chunk
+
+    def finish(self):
+        if self.held_modifiers or self.held_keys:
+            raise MacroError("keys are still held at the end, add release or releaseall")
+        return MAGIC + bytes([VERSION, 0]) + self.code + bytes([END])
+
+
+def assemble(source, layout_path=DEFAULT_LAYOUT, filename="<macro>"):
+    assembler = Assembler(layout_path)
+    for number, line in enumerate(source.splitlines(), 1):
+        try:
+            assembler.step(line)
+        except (MacroError, ValueError) as error:
+            raise MacroError(f"{filename}:{number}: {error}") from None
+    try:
+        return assembler.finish()
+    except MacroError as error:
+        raise MacroError(f"{filename}: {error}") from None
+
+
+def emit_header(name, code, source_name):
+    lines = [f"// Generated by tools/macroasm.py from {source_name}, do not edit", "#pragma once", "",
+             "#include <stdint.h>", "", f"static const uint8_t {name}[] = {{"]
+    for i in range(0, len(code), 12):
+        lines.append("    " + ", ".join(f"0x{b:02X}" for b in code[i:i + 12]) + ",")
+    lines.append("};")
+    return "\n".join(lines) + "\n"
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("source", help="macro source file")
+    parser.add_argument("-o", "--output", help="file to write, nothing is written if omitted")
+    parser.add_argument("--name", help="array name in the C header, from the file name by default")
+    parser.add_argument("--binary", action="store_true", help="write raw bytecode instead of a C header")
+    parser.add_argument("--layout", default=DEFAULT_LAYOUT, help="layout header for character keys and text")
+    args = parser.parse_args(argv)
+
+    with open(args.source, encoding="utf-8") as f:
+        source = f.read()
+    try:
+        code = assemble(source, args.layout, args.source)
+    except MacroError as error:
+        print(f"error: {error}", file=sys.stderr)
+        return 1
+
+    if args.output:
+        if args.binary:
+            with open(args.output, "wb") as f:
+                f.write(code)
+        else:
+            name = args.name or os.path.splitext(os.path.basename(args.source))[0]
+            with open(args.output, "w", encoding="utf-8") as f:
+                f.write(emit_header(name, code, os.path.basename(args.source)))
+    print(f"{args.source}: {len(code)} bytes")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,283 @@
+#!/usr/bin/env python3
+"""Report trace replay: decodes a BleKeyboard trace dump and explains typing errors.
+
+BleKeyboard::dumpTrace() writes the reports it queued, sent, refused and
+dropped (see BLE_KEYBOARD_TRACE_SIZE). This tool finds the dump in a capture,
+which may be a raw Serial log with text around it, replays the reports each
+host was sent through the FR AZERTY decoder of hidhost.py and, given the text
+that was meant to be typed, diffs the two. For each difference it shows the
+reports that produced it, with the inter-report gaps, modifiers held across
+many keys and dropped or refused reports around it that would explain it.
+Keys held across a gap longer than the host's key repeat delay are listed even
+when the text matches, since the real host would have repeated them.
+
+    tracereplay.py serial.log
+    tracereplay.py --expect "Bonjour à tous" serial.log
+    tracereplay.py --expect-file sent.txt --gap-ms 50 --list serial.log
+
+The last dump in the capture is used.
+"""
+
+import argparse
+import difflib
+import struct
+import sys
+
+from hidhost import LCTRL, LSHIFT, LALT, LGUI, RCTRL, RSHIFT, RALT, RGUI, VirtualHost
+
+MAGIC = b"BKTR"
+VERSION = 1
+HEADER = struct.Struct("<4sHHII")
+ENTRY = struct.Struct("<IHBB8s")
+NO_HOST = 0xFFFF
+
+QUEUED, SENT, REFUSED, DROPPED = range(4)
+EVENTS = {QUEUED: "queued", SENT: "sent", REFUSED: "refused", DROPPED: "dropped"}
+
+MODIFIER_NAMES = {LCTRL: "LeftCtrl", LSHIFT: "LeftShift", LALT: "LeftAlt", LGUI: "LeftGUI",
+                  RCTRL: "RightCtrl", RSHIFT: "RightShift", RALT: "AltGr", RGUI: "RightGUI"}
+
+
+class TraceError(Exception):
+    pass
+
+
+class Entry:
+    def __init__(self, index, micros, conn_handle, event, report):
+        self.index = index
+        self.micros = micros  # Unwrapped, from the first entry
+        self.conn_handle = conn_handle
+        self.event = event
+        self.report = report
+
+    @property
+    def modifiers(self):
+        return self.report[0]
+
+    @property
+    def keys(self):
+        return [k for k in self.report[2:] if k != 0]
+
+    def describe(self):
+        host = "-" if self.conn_handle == NO_HOST else str(self.conn_handle)
+        keys = " ".join(f"{k:02X}" for k in self.keys) or "--"
+        return (f"{self.index:5d} {self.micros / 1000:10.3f} ms  host {host:>3}  {EVENTS.get(self.event, '?'):7}  "
+                f"{modifier_names(self.modifiers) or '-':20}  {keys}")
+
+
+def modifier_names(mask):
+    return "+".join(name for bit, name in MODIFIER_NAMES.items() if mask & bit)
+
+
+def parse_trace(data):
+    """Returns (entries, lost) for the last dump in data."""
+    start = data.rfind(MAGIC)
+    if start < 0:
+        raise TraceError("no trace dump found")
+    if len(data) - start < HEADER.size:
+        raise TraceError("trace header is cut short")
+    _, version, entry_size, count, lost = HEADER.unpack_from(data, start)
+    if version != VERSION or entry_size != ENTRY.size:
+        raise TraceError(f"unsupported trace version {version} with {entry_size}-byte entries")
+    offset = start + HEADER.size
+    available = (len(data) - offset) // ENTRY.size
+    if available < count:
+        print(f"warning: dump cut short, {available} of {count} entries", file=sys.stderr)
+        count = available
+
+    entries, first, previous, wraps = [], None, None, 0
+    for i in range(count):
+        micros, conn_handle, event, _, report = ENTRY.unpack_from(data, offset + i * ENTRY.size)
+        if previous is not None and micros < previous:
+            wraps += 1  # The 32-bit microsecond count wraps every 71 minutes
+        previous = micros
+        micros += wraps << 32
+        first = micros if first is None else first
+        entries.append(Entry(i, micros - first, conn_handle, event, report))
+    return entries, lost
+
+
+class Replay:
+    """The reports one host was sent, decoded, with the report behind each character."""
+
+    def __init__(self, conn_handle, entries):
+        self.conn_handle = conn_handle
+        self.events = [e for e in entries if e.conn_handle == conn_handle]
+        self.sent = [e for e in self.events if e.event == SENT]
+        host = VirtualHost()
+        self.origin = []  # Index in self.sent of the report that typed each character
+        for i, entry in enumerate(self.sent):
+            host.feed(entry.report)
+            del self.origin[len(host.text):]  # Backspace
+            self.origin.extend([i] * (len(host.text) - len(self.origin)))
+        self.text = host.result()
+
+    def count(self, event):
+        return sum(1 for e in self.events if e.event == event)
+
+
+def held_since(sent, index, bit):
+    """First report of the run of reports, ending at index, that hold modifier bit."""
+    while index > 0 and sent[index - 1].modifiers & bit:
+        index -= 1
+    return index
+
+
+def key_presses(sent, lo, hi):
+    presses, held = 0, set(sent[lo - 1].keys) if lo > 0 else set()
+    for entry in sent[lo:hi + 1]:
+        presses += len(set(entry.keys) - held)
+        held = set(entry.keys)
+    return presses
+
+
+def explain(replay, lo, hi, args, entries):
+    """Causes worth a look for an error typed by the reports lo to hi."""
+    sent, notes = replay.sent, []
+    gap_us = args.gap_ms * 1000
+    for i in range(max(lo, 1), hi + 1):
+        gap = sent[i].micros - sent[i - 1].micros
+        if gap < gap_us:
+            continue
+        held = sent[i - 1].keys
+        if held:
+            keys = " ".join(f"{k:02X}" for k in held)
+            notes.append(f"{gap / 1000:.1f} ms gap before report {sent[i].index} with key {keys} held: "
+                         "the host may have repeated it")
+        else:
+            notes.append(f"{gap / 1000:.1f} ms gap before report {sent[i].index}")
+
+    for bit, name in MODIFIER_NAMES.items():
+        ends = [i for i in range(lo, hi + 1) if sent[i].modifiers & bit]
+        if not ends:
+            continue
+        end = ends[-1]
+        while end + 1 < len(sent) and sent[end + 1].modifiers & bit:
+            end += 1
+        start = held_since(sent, ends[0], bit)
+        presses = key_presses(sent, start, end)
+        held_ms = (sent[end].micros - sent[start].micros) / 1000
+        if presses >= args.stuck_keys or held_ms >= args.stuck_ms:
+            notes.append(f"{name} held from report {sent[start].index} to {sent[end].index} "
+                         f"({held_ms:.1f} ms, {presses} key presses)")
+
+    since = sent[lo - 1].micros if lo > 0 else -1
+    until = sent[hi].micros
+    for event in (DROPPED, REFUSED):
+        lost = [e for e in entries if e.event == event and since <= e.micros <= until
+                and e.conn_handle in (replay.conn_handle, NO_HOST)]
+        if lost:
+            notes.append(f"{len(lost)} report(s) {EVENTS[event]} meanwhile, first at entry {lost[0].index}")
+    return notes
+
+
+def repeat_risks(replay, repeat_ms):
+    """Sent reports after which a key stayed down for longer than repeat_ms."""
+    risks = []
+    for previous, entry in zip(replay.sent, replay.sent[1:]):
+        gap = entry.micros - previous.micros
+        if previous.keys and gap >= repeat_ms * 1000:
+            risks.append((previous, gap, previous.keys))
+    return risks
+
+
+def report_range(replay, j1, j2):
+    """Sent reports behind the decoded characters j1 to j2, or around j1 if j2 == j1."""
+    origin = replay.origin
+    if j2 > j1:
+        lo, hi = origin[j1], origin[j2 - 1]
+    else:
+        lo = origin[j1 - 1] if j1 > 0 else 0
+        hi = origin[j1] if j1 < len(origin) else len(replay.sent) - 1
+    if j1 > 0:
+        lo = min(lo, origin[j1 - 1] + 1)  # Reports since the last good character
+    return lo, max(lo, hi)
+
+
+def compare(replay, expected, args, entries):
+    matcher = difflib.SequenceMatcher(None, expected, replay.text, autojunk=False)
+    errors = [op for op in matcher.get_opcodes() if op[0] != "equal"]
+    for n, (tag, i1, i2, j1, j2) in enumerate(errors[:args.max_errors], 1):
+        print(f"  error {n} at character {j1}: expected {expected[i1:i2]!r}, got {replay.text[j1:j2]!r}")
+        if not replay.sent:
+            continue
+        lo, hi = report_range(replay, j1, j2)
+        first, last = replay.sent[lo], replay.sent[hi]
+        print(f"    reports {first.index} to {last.index}, "
+              f"{first.micros / 1e6:.3f} s to {last.micros / 1e6:.3f} s")
+        for note in explain(replay, lo, hi, args, entries) or ["nothing unusual in the trace, look at the host"]:
+            print(f"    {note}")
+    if len(errors) > args.max_errors:
+        print(f"  ... {len(errors) - args.max_errors} more")
+    return len(errors)
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("file", nargs="?", help="capture holding a dumpTrace() output (default: stdin)")
+    parser.add_argument("--expect", help="text that was meant to be typed")
+    parser.add_argument("--expect-file", help="file holding the text that was meant to be typed")
+    parser.add_argument("--host", type=lambda v: int(v, 0), help="connection handle to replay, all by default")
+    parser.add_argument("--list", action="store_true", help="print every entry")
+    parser.add_argument("--gap-ms", type=float, default=100, help="inter-report gap worth reporting (default 100)")
+    parser.add_argument("--stuck-keys", type=int, default=4,
+                        help="key presses a modifier must be held across to be reported (default 4)")
+    parser.add_argument("--stuck-ms", type=float, default=500,
+                        help="time a modifier must be held to be reported (default 500)")
+    parser.add_argument("--repeat-ms", type=float, default=500,
+                        help="host key repeat delay, keys held longer are listed (default 500)")
+    parser.add_argument("--max-errors", type=int, default=10, help="differences to explain per host")
+    args = parser.parse_args(argv)
+
+    if args.file:
+        with open(args.file, "rb") as f:
+            data = f.read()
+    else:
+        data = sys.stdin.buffer.read()
+    try:
+        entries, lost = parse_trace(data)
+    except TraceError as error:
+        print(f"error: {error}", file=sys.stderr)
+        return 2
+
+    expected = args.expect
+    if args.expect_file:
+        with open(args.expect_file, encoding="utf-8") as f:
+            expected = f.read()
+
+    span = entries[-1].micros / 1e6 if entries else 0
+    print(f"trace: {len(entries)} entries over {span:.3f} s, {lost} lost")
+    if lost:
+        print("  the oldest reports were overwritten, the start of the text is missing")
+    if args.list:
+        for entry in entries:
+            print(entry.describe())
+
+    handles = sorted({e.conn_handle for e in entries if e.event == SENT})
+    if args.host is not None:
+        handles = [h for h in handles if h == args.host]
+    if not handles:
+        print("no reports were sent")
+        return 1 if expected else 0
+
+    failed = False
+    for handle in handles:
+        replay = Replay(handle, entries)
+        print(f"host {handle}: {len(replay.sent)} sent, {replay.count(REFUSED)} refused, "
+              f"{replay.count(DROPPED)} dropped")
+        print(f"  typed {replay.text!r}")
+        last = replay.sent[-1]
+        if last.modifiers or last.keys:
+            print(f"  still held after the last report: {modifier_names(last.modifiers) or '-'} "
+                  f"{' '.join(f'{k:02X}' for k in last.keys)}")
+        for entry, gap, held in repeat_risks(replay, args.repeat_ms):
+            print(f"  key {' '.join(f'{k:02X}' for k in held)} held {gap / 1000:.1f} ms after report {entry.index}, "
+                  "long enough for the host to repeat it")
+        if expected is not None and replay.text != expected:
+            failed = True
+            compare(replay, expected, args, entries)
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())